@@ -0,0 +1,267 @@
+// Audio channel over loopback UDP (common/audio_stream.h).
+//
+//   ./bin/bench_audio [seconds per scenario]
+//
+// Host side: ToneSource (its "sound card" 200 ppm fast) -> AudioTimestamper on
+// a host media clock that runs 100 ppm fast against ours -> AudioEncoder ->
+// WIRE_AUDIO. A delay line between sender and socket adds the scenario's
+// jitter and loss (FIFO, like a real queue: no reordering). Client side:
+// WireParse -> AudioJitterBuffer, pulled by a simulated device (its clock
+// 50 ppm slow, 30 ms of output buffering). A 60 fps video stream with 45-55 ms
+// capture-to-screen latency reports OnVideoShown().
+//
+// Per scenario: capture-to-ear latency, jitter-buffer depth and target,
+// concealment counters, measured vs injected clock drift, and the A/V offset
+// (audio latency - video latency; > 0 = sound after picture).
+
+#include "../common/audio_stream.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <thread>
+
+#define HOST_CLOCK_PPM 100.0
+#define SOUND_CARD_PPM 200.0
+#define DEVICE_PPM -50.0
+#define OUTPUT_LATENCY_US 30000
+#define VIDEO_LATENCY_US 45000 // + 0..10 ms
+
+struct Scenario
+{
+    const char *name;
+    int baseDelayUs;
+    double spikeChance; // per packet
+    int spikeMaxUs;
+    double loss;
+    bool avSync;
+};
+
+static int64_t g_start;
+
+// Host media clock, HOST_CLOCK_PPM fast, and its inverse.
+static uint64_t HostMediaUs(int64_t localUs)
+{
+    return (uint64_t)((localUs - g_start) * (1.0 + HOST_CLOCK_PPM / 1e6));
+}
+static int64_t HostMediaToLocal(uint64_t mediaUs)
+{
+    return g_start + (int64_t)(mediaUs / (1.0 + HOST_CLOCK_PPM / 1e6));
+}
+
+static void RunScenario(const Scenario &sc, double seconds)
+{
+    g_start = LocalMicros();
+    std::atomic<bool> running{true};
+
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(rx, (sockaddr *)&addr, sizeof(addr));
+    socklen_t addrLen = sizeof(addr);
+    getsockname(rx, (sockaddr *)&addr, &addrLen);
+    timeval tv{0, 20000};
+    setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    AudioJitterBuffer jitter;
+    jitter.SetOutputLatency(OUTPUT_LATENCY_US);
+
+    // Delay line: (release time, datagram), FIFO.
+    std::mutex lineLock;
+    std::deque<std::pair<int64_t, std::vector<uint8_t>>> line;
+
+    std::thread host([&] {
+        ToneSource source(AUDIO_SAMPLE_RATE, AUDIO_CHANNELS, 440.0, true, SOUND_CARD_PPM);
+        AudioEncoder encoder;
+        encoder.Open(source.SampleRate(), source.Channels());
+        AudioTimestamper stamper(source.SampleRate(), encoder.FrameSamples());
+        std::vector<int16_t> pcm((size_t)encoder.FrameSamples() * source.Channels());
+        std::mt19937 rnd(11);
+        std::uniform_real_distribution<double> uni(0.0, 1.0);
+        int64_t lastRelease = 0;
+        uint32_t seq = 0;
+        while (running && source.Read(pcm.data()))
+        {
+            uint64_t ts = stamper.Stamp(HostMediaUs(LocalMicros()));
+            std::vector<uint8_t> pkt(WIRE_AUDIO_OVERHEAD + AUDIO_MAX_PAYLOAD);
+            int n = encoder.Encode(pcm.data(), pkt.data() + WIRE_AUDIO_OVERHEAD, AUDIO_MAX_PAYLOAD);
+            pkt.resize(WireWriteAudio(pkt.data(), seq++, ts, source.SampleRate(), encoder.Codec(), source.Channels(),
+                                      encoder.FrameSamples(), n) + n);
+            if (uni(rnd) < sc.loss) continue;
+            int64_t delay = sc.baseDelayUs + (uni(rnd) < sc.spikeChance ? (int64_t)(uni(rnd) * sc.spikeMaxUs) : 0);
+            int64_t release = std::max(lastRelease, LocalMicros() + delay);
+            lastRelease = release;
+            std::lock_guard<std::mutex> guard(lineLock);
+            line.emplace_back(release, std::move(pkt));
+        }
+    });
+
+    std::thread network([&] {
+        while (running)
+        {
+            std::vector<uint8_t> pkt;
+            {
+                std::lock_guard<std::mutex> guard(lineLock);
+                if (!line.empty() && line.front().first <= LocalMicros())
+                {
+                    pkt.swap(line.front().second);
+                    line.pop_front();
+                }
+            }
+            if (pkt.empty()) std::this_thread::sleep_for(std::chrono::microseconds(200));
+            else sendto(tx, pkt.data(), pkt.size(), 0, (sockaddr *)&addr, sizeof(addr));
+        }
+    });
+
+    std::thread receiver([&] {
+        std::vector<uint8_t> buf(65536);
+        while (running)
+        {
+            int len = (int)recv(rx, buf.data(), buf.size(), 0);
+            WireAudio pkt;
+            if (len > 0 && WireParse(buf.data(), len, &pkt)) jitter.Insert(pkt, LocalMicros());
+        }
+    });
+
+    // Video: captured now, on screen VIDEO_LATENCY_US + 0..10 ms later.
+    std::atomic<int64_t> videoLatencySum{0}, videoFrames{0};
+    std::thread video([&] {
+        std::mt19937 rnd(3);
+        std::deque<std::pair<int64_t, uint64_t>> inFlight; // (show time, media ts)
+        for (int64_t next = LocalMicros(); running; next += 16667)
+        {
+            int64_t now = LocalMicros();
+            inFlight.emplace_back(now + VIDEO_LATENCY_US + (int64_t)(rnd() % 10000), HostMediaUs(now));
+            while (!inFlight.empty() && inFlight.front().first <= now)
+            {
+                uint64_t ts = inFlight.front().second;
+                if (sc.avSync) jitter.OnVideoShown(ts, now);
+                videoLatencySum += now - HostMediaToLocal(ts);
+                videoFrames++;
+                inFlight.pop_front();
+            }
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(next + 16667)));
+        }
+    });
+
+    // Device: pulls one frame per (slightly slow) 10 ms.
+    std::vector<double> latencies;
+    double depthSum = 0, depthMax = 0;
+    int pulls = 0;
+    {
+        int rate, channels, frameSamples;
+        while (!jitter.Format(&rate, &channels, &frameSamples)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        AudioPacer device(frameSamples * 1000000 / rate, DEVICE_PPM);
+        std::vector<int16_t> pcm((size_t)frameSamples * channels);
+        int64_t end = LocalMicros() + (int64_t)(seconds * 1e6);
+        while (LocalMicros() < end)
+        {
+            device.Wait();
+            uint64_t ts;
+            jitter.Pull(pcm.data(), frameSamples, channels, &ts);
+            int64_t now = LocalMicros();
+            // Warm-up: the first 2 s settle the target and the clock fit.
+            if (now - g_start < 2000000) continue;
+            if (ts) latencies.push_back((now + OUTPUT_LATENCY_US - HostMediaToLocal(ts)) / 1000.0);
+            AudioJitterStats s = jitter.Stats();
+            depthSum += s.depthUs / 1000.0;
+            depthMax = std::max(depthMax, s.depthUs / 1000.0);
+            pulls++;
+        }
+    }
+
+    running = false;
+    host.join();
+    network.join();
+    receiver.join();
+    video.join();
+    close(tx);
+    close(rx);
+
+    AudioJitterStats s = jitter.Stats();
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0;
+    for (double l : latencies) mean += l / latencies.size();
+    double p95 = latencies.empty() ? 0 : latencies[latencies.size() * 95 / 100];
+    double videoMs = videoFrames ? videoLatencySum / 1000.0 / videoFrames : 0;
+
+    printf("\n%s\n", sc.name);
+    printf("  latency (capture -> ear)  mean %5.1f ms  p95 %5.1f ms   video %5.1f ms  A/V offset %+5.1f ms\n", mean, p95,
+           videoMs, mean - videoMs);
+    printf("  jitter buffer             depth mean %5.1f ms  max %5.1f ms   target %d ms (jitter p95 %d ms, sync %d ms)\n",
+           pulls ? depthSum / pulls : 0, depthMax, s.targetUs / 1000, s.jitterUs / 1000, s.syncUs / 1000);
+    printf("  frames                    %llu received  %llu played  %llu lost  %llu underruns  %llu late  %llu dropped\n",
+           (unsigned long long)s.received, (unsigned long long)s.played, (unsigned long long)s.lost,
+           (unsigned long long)s.underruns, (unsigned long long)s.late, (unsigned long long)s.dropped);
+    printf("  host clock drift          injected %+.0f ppm  measured %+.0f ppm\n", HOST_CLOCK_PPM, -s.driftPpm);
+}
+
+// Feeds a 1 kHz tone at device rates above the wire's through AudioDownsampler
+// in odd-sized packets, like WASAPI delivers them, and checks the output rate
+// and tone level at AUDIO_SAMPLE_RATE.
+static bool CheckDownsampler()
+{
+    bool ok = true;
+    const int rates[] = {88200, 96000, 176400, 192000};
+    for (int inRate : rates)
+    {
+        AudioDownsampler ds;
+        ds.Open(inRate, AUDIO_SAMPLE_RATE, AUDIO_CHANNELS);
+        std::vector<int16_t> in, out;
+        const int inFrames = inRate; // one second
+        for (int i = 0; i < inFrames; i++)
+        {
+            int16_t v = (int16_t)std::lround(16000.0 * std::sin(2.0 * M_PI * 1000.0 * i / inRate));
+            in.push_back(v);
+            in.push_back((int16_t)-v);
+        }
+        for (int done = 0; done < inFrames;)
+        {
+            int n = std::min(inFrames - done, 441 + done % 97);
+            ds.Push(in.data() + done * AUDIO_CHANNELS, n, out);
+            done += n;
+        }
+
+        // Box filter over 2-4 input samples: a 1 kHz tone loses well under 1%.
+        int outFrames = (int)out.size() / AUDIO_CHANNELS;
+        double err = 0.0;
+        for (int i = 0; i < outFrames; i++)
+        {
+            double t = (i + 0.5) / AUDIO_SAMPLE_RATE - 0.5 / inRate; // centre of the averaged span
+            double want = 16000.0 * std::sin(2.0 * M_PI * 1000.0 * t);
+            err = std::max(err, std::fabs(out[i * 2] - want));
+            err = std::max(err, std::fabs(out[i * 2 + 1] + out[i * 2]));
+        }
+        bool pass = std::abs(outFrames - AUDIO_SAMPLE_RATE) <= 1 && err < 16000.0 * 0.01;
+        printf("  downsample %6d -> %d Hz  %d frames/s  max error %.0f  %s\n", inRate, AUDIO_SAMPLE_RATE, outFrames, err,
+               pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 20;
+    AudioEncoder probe;
+    probe.Open(AUDIO_SAMPLE_RATE, AUDIO_CHANNELS);
+    printf("%d Hz x%d, %d ms frames, codec IMA ADPCM (%d bytes/frame), %.0f s per scenario\n", AUDIO_SAMPLE_RATE, AUDIO_CHANNELS,
+           AUDIO_FRAME_MS, probe.PacketSize(), seconds);
+
+    const Scenario scenarios[] = {
+        {"LAN (0.3 ms, no loss), A/V sync on", 300, 0.0, 0, 0.0, true},
+        {"Wi-Fi (2 ms + 5% spikes to 40 ms, 1% loss), A/V sync on", 2000, 0.05, 40000, 0.01, true},
+        {"Wi-Fi, A/V sync off (jitter only)", 2000, 0.05, 40000, 0.01, false},
+    };
+    if (!CheckDownsampler()) return 1;
+    for (const Scenario &sc : scenarios) RunScenario(sc, seconds);
+    return 0;
+}
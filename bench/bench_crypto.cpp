@@ -0,0 +1,98 @@
+// Seal throughput and added per-frame latency for common/secure_channel.h.
+//
+// Frame sizes default to what host.cpp produces at JPEG_QUALITY 25:
+// ~70 KB at 1280x720 and ~600 KB at 3840x2160. Override with
+//   ./bin/bench_crypto <720p bytes> <4k bytes>
+
+#include "../common/secure_channel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#define MAX_PACKET_SIZE 60000
+#define HEADER_SIZE 20
+
+typedef std::chrono::steady_clock Clock;
+
+// Only the host half is needed to seal; cipherPref forces the suite.
+static void Handshake(SecureChannel &host, uint8_t cipher)
+{
+    SecureChannel client;
+    HandshakeHello hello;
+    HandshakeReply reply;
+    client.BeginClient("TEST_KEY_123", &hello);
+    hello.cipherPref = cipher;
+    host.AcceptHello("TEST_KEY_123", &hello, sizeof(hello), &reply);
+}
+
+static double Run(SecureChannel &host, int frameBytes, int frames, bool batched)
+{
+    const int slotSize = SEAL_OVERHEAD + HEADER_SIZE + MAX_PACKET_SIZE;
+    int chunks = (frameBytes + MAX_PACKET_SIZE - 1) / MAX_PACKET_SIZE;
+    std::vector<uint8_t> arena((size_t)chunks * slotSize, 0x5a);
+    std::vector<int> plainLens(chunks), sealedLens(chunks);
+    for (int i = 0; i < chunks; i++)
+    {
+        int remaining = frameBytes - i * MAX_PACKET_SIZE;
+        plainLens[i] = HEADER_SIZE + (remaining > MAX_PACKET_SIZE ? MAX_PACKET_SIZE : remaining);
+    }
+
+    uint8_t key[32] = {1};
+    uint8_t iv[12] = {2};
+    auto start = Clock::now();
+    for (int f = 0; f < frames; f++)
+    {
+        if (batched)
+        {
+            host.SealBatch(arena.data(), slotSize, plainLens.data(), sealedLens.data(), chunks);
+            continue;
+        }
+        // Naive per-packet setup: new context and key schedule per datagram.
+        for (int i = 0; i < chunks; i++)
+        {
+            uint8_t *body = arena.data() + (size_t)i * slotSize + SEAL_SEQ_SIZE;
+            int outLen = 0;
+            EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+            EVP_EncryptInit_ex(ctx, host.Cipher() == CIPHER_AES_GCM ? EVP_aes_256_gcm() : EVP_chacha20_poly1305(), NULL, key, iv);
+            EVP_EncryptUpdate(ctx, body, &outLen, body, plainLens[i]);
+            EVP_EncryptFinal_ex(ctx, body + outLen, &outLen);
+            EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, SEAL_TAG_SIZE, body + plainLens[i]);
+            EVP_CIPHER_CTX_free(ctx);
+        }
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void Report(const char *name, SecureChannel &host, int frameBytes, int fps)
+{
+    int frames = 4000000 / (frameBytes / 1000 + 1) + 50;
+    Run(host, frameBytes, frames / 10, true); // warm up
+    double batched = Run(host, frameBytes, frames, true);
+    double naive = Run(host, frameBytes, frames, false);
+
+    double perFrameUs = batched / frames * 1e6;
+    double gbps = (double)frameBytes * frames * 8 / batched / 1e9;
+    double budgetPct = perFrameUs / (1e6 / fps) * 100;
+    printf("  %-8s %7d B/frame  %6.2f Gbit/s  %7.1f us/frame (%.2f%% of %d fps budget)  naive setup: %7.1f us/frame\n",
+           name, frameBytes, gbps, perFrameUs, budgetPct, fps, naive / frames * 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    int bytes720 = argc > 1 ? atoi(argv[1]) : 70 * 1024;
+    int bytes4k = argc > 2 ? atoi(argv[2]) : 600 * 1024;
+
+    const uint8_t ciphers[] = {CIPHER_AES_GCM, CIPHER_CHACHA20_POLY1305};
+    printf("CPU prefers: %s\n", PreferredCipher() == CIPHER_AES_GCM ? "AES-256-GCM (AES-NI + PCLMUL)" : "ChaCha20-Poly1305");
+    for (uint8_t cipher : ciphers)
+    {
+        SecureChannel host;
+        Handshake(host, cipher);
+        printf("%s\n", host.Cipher() == CIPHER_AES_GCM ? "AES-256-GCM" : "ChaCha20-Poly1305");
+        Report("720p/60", host, bytes720, 60);
+        Report("4K/30", host, bytes4k, 30);
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+// Idle governor (common/frame_governor.h) on one synthetic 1080p display.
+//
+//   ./bin/bench_governor [reactionMs] [idleAfterMs]
+//
+// A script drives the "screen" through phases and the same script runs twice:
+// once at a fixed rate (reactionMs = 0, the pre-governor behaviour: capture
+// and hash at maxFps forever) and once governed. Capture copies the frame
+// like a GDI BitBlt would; encoding is libjpeg at the host's ROI quality.
+//
+//   active     the screen changes at 60 Hz (video, scrolling)
+//   idle       nothing changes
+//   input      idle, then every second a "click": NotifyInput() and the
+//              application repaints 5 ms later
+//   unprompted idle, then every second the screen changes with no input
+//   mouse      the mouse moves at MOUSE_HZ: NotifyInput() and a cursor
+//              repaint per move. Captures/s must stay within maxFps; the
+//              bench fails if either mode exceeds it.
+//
+// Per phase: worker CPU, captures/s and frames sent/s. For the input and
+// unprompted phases: latency from the change to the first frame sent with it.
+
+#include "../common/stream_scheduler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+
+#include <jpeglib.h>
+
+#define FRAME_W 1920
+#define FRAME_H 1080
+#define JPEG_QUALITY 60
+#define MOUSE_HZ 250
+
+typedef std::chrono::steady_clock Clock;
+
+// What is on the "monitor". The script bumps `version` and repaints a block.
+static std::mutex g_screenLock;
+static std::vector<uint8_t> g_screen;
+static uint32_t g_version = 0;
+static Clock::time_point g_changedAt;
+static bool g_measure = false;
+
+static void Repaint(bool measure)
+{
+    std::lock_guard<std::mutex> guard(g_screenLock);
+    g_version++;
+    int bx = (g_version * 37) % (FRAME_W - 200), by = (g_version * 23) % (FRAME_H - 100);
+    for (int y = by; y < by + 100; y++) memset(&g_screen[((size_t)y * FRAME_W + bx) * 4], (g_version * 7) & 0xff, 200 * 4);
+    g_changedAt = Clock::now();
+    g_measure = measure;
+}
+
+class ScreenPipeline : public StreamPipeline
+{
+public:
+    ScreenPipeline() : m_frame(g_screen.size()) {}
+
+    bool Capture(const uint8_t **pixels, int *width, int *height, int *stride) override
+    {
+        {
+            std::lock_guard<std::mutex> guard(g_screenLock);
+            memcpy(m_frame.data(), g_screen.data(), m_frame.size());
+            m_capturedVersion = g_version;
+            m_changedAt = g_changedAt;
+            m_measure = g_measure;
+        }
+        *pixels = m_frame.data();
+        *width = FRAME_W;
+        *height = FRAME_H;
+        *stride = FRAME_W * 4;
+        return true;
+    }
+
+    void EncodeAndSend(bool) override
+    {
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr jerr;
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+        unsigned char *out = NULL;
+        unsigned long outSize = 0;
+        jpeg_mem_dest(&cinfo, &out, &outSize);
+        cinfo.image_width = FRAME_W;
+        cinfo.image_height = FRAME_H;
+        cinfo.input_components = 4;
+        cinfo.in_color_space = JCS_EXT_BGRX;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+        cinfo.dct_method = JDCT_IFAST;
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height)
+        {
+            JSAMPROW row = &m_frame[(size_t)cinfo.next_scanline * FRAME_W * 4];
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+        free(out);
+
+        // First frame that carries a measured change.
+        if (m_measure && m_capturedVersion != m_sentVersion)
+        {
+            std::lock_guard<std::mutex> guard(m_latencyLock);
+            m_latenciesMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - m_changedAt).count());
+        }
+        m_sentVersion = m_capturedVersion;
+    }
+
+    std::vector<double> TakeLatencies()
+    {
+        std::lock_guard<std::mutex> guard(m_latencyLock);
+        std::vector<double> out;
+        out.swap(m_latenciesMs);
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> m_frame;
+    uint32_t m_capturedVersion = 0, m_sentVersion = 0;
+    Clock::time_point m_changedAt;
+    bool m_measure = false;
+    std::mutex m_latencyLock;
+    std::vector<double> m_latenciesMs;
+};
+
+struct PhaseResult
+{
+    double cpuPct, capturesPerSec, sentPerSec, latAvgMs, latMaxMs;
+    int events;
+    uint64_t captures;
+    double wall;
+};
+
+static PhaseResult RunPhase(StreamScheduler &scheduler, ScreenPipeline *pipeline, const char *phase, double seconds)
+{
+    const StreamStats &s = scheduler.Stats(0);
+    uint64_t cpu0 = s.cpuUs, cap0 = s.captured, sent0 = s.sent;
+    auto start = Clock::now();
+    auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    pipeline->TakeLatencies();
+
+    std::string name = phase;
+    int tick = 0;
+    while (Clock::now() < end)
+    {
+        if (name == "active")
+        {
+            Repaint(false);
+            std::this_thread::sleep_for(std::chrono::microseconds(16667));
+        }
+        else if (name == "mouse")
+        {
+            scheduler.NotifyInput(0);
+            Repaint(false);
+            std::this_thread::sleep_for(std::chrono::microseconds(1000000 / MOUSE_HZ));
+        }
+        else if (name == "idle")
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        else
+        {
+            // One event per second, at a random point so polls are not in phase.
+            std::this_thread::sleep_for(std::chrono::milliseconds(900 + (tick++ * 37) % 100));
+            if (Clock::now() >= end) break;
+            if (name == "input")
+            {
+                auto t = Clock::now();
+                scheduler.NotifyInput(0);
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                Repaint(true);
+                // Latency counts from the click, not the repaint.
+                std::lock_guard<std::mutex> guard(g_screenLock);
+                g_changedAt = t;
+            }
+            else
+            {
+                Repaint(true);
+            }
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150)); // let the last event land
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    PhaseResult r{};
+    r.cpuPct = 100.0 * (s.cpuUs - cpu0) / 1e6 / wall;
+    r.captures = s.captured - cap0;
+    r.wall = wall;
+    r.capturesPerSec = r.captures / wall;
+    r.sentPerSec = (s.sent - sent0) / wall;
+    std::vector<double> lat = pipeline->TakeLatencies();
+    r.events = (int)lat.size();
+    for (double l : lat)
+    {
+        r.latAvgMs += l / lat.size();
+        r.latMaxMs = std::max(r.latMaxMs, l);
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    GovernorConfig governed;
+    if (argc > 1) governed.reactionMs = atoi(argv[1]);
+    if (argc > 2) governed.idleAfterMs = atoi(argv[2]);
+    GovernorConfig fixed = governed;
+    fixed.reactionMs = 0;
+
+    g_screen.resize((size_t)FRAME_W * FRAME_H * 4);
+    std::mt19937 rnd(5);
+    for (size_t i = 0; i < g_screen.size(); i += 4)
+    {
+        uint8_t v = (rnd() % 6 == 0) ? 40 : 215;
+        g_screen[i] = g_screen[i + 1] = v;
+        g_screen[i + 2] = (uint8_t)(v - 15);
+        g_screen[i + 3] = 255;
+    }
+
+    const char *phases[] = {"active", "idle", "input", "unprompted", "mouse"};
+    const double seconds[] = {3, 4, 6, 6, 3};
+    const int phaseCount = 5;
+    printf("%dx%d, maxFps %d, keep-alive %d fps, governed: poll every %d ms after %d ms idle\n", FRAME_W, FRAME_H,
+           governed.maxFps, governed.minFps, governed.reactionMs, governed.idleAfterMs);
+
+    PhaseResult results[2][phaseCount];
+    for (int run = 0; run < 2; run++)
+    {
+        StreamScheduler scheduler;
+        ScreenPipeline *pipeline = new ScreenPipeline();
+        scheduler.Add(pipeline, run == 0 ? fixed : governed);
+        scheduler.Start(true);
+        for (int p = 0; p < phaseCount; p++) results[run][p] = RunPhase(scheduler, pipeline, phases[p], seconds[p]);
+        scheduler.Stop();
+    }
+
+    printf("\n%-11s %-9s %8s %11s %9s %20s\n", "phase", "mode", "CPU", "captures/s", "sent/s", "first frame (avg/max)");
+    bool capped = true;
+    for (int p = 0; p < phaseCount; p++)
+    {
+        for (int run = 0; run < 2; run++)
+        {
+            const PhaseResult &r = results[run][p];
+            printf("%-11s %-9s %7.1f%% %11.1f %9.1f", run == 0 ? phases[p] : "", run == 0 ? "fixed" : "governed",
+                   r.cpuPct, r.capturesPerSec, r.sentPerSec);
+            if (r.events) printf("   %6.1f / %6.1f ms (%d)", r.latAvgMs, r.latMaxMs, r.events);
+            printf("\n");
+            // One capture of slack for where the window happens to start.
+            if (r.captures > governed.maxFps * r.wall + 1) capped = false;
+        }
+    }
+    if (!capped)
+    {
+        printf("\nFAIL: captures/s above maxFps (%d)\n", governed.maxFps);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// Recording overhead on the send loop and seek time on the result.
+//
+//   ./bin/bench_record [file] [fps] [seconds] [frame bytes]
+//
+// 1. Overhead: a stand-in send loop (chunking each frame into 60000-byte
+//    packets like host.cpp) paced at `fps`, with and without
+//    SessionRecorder::RecordFrame() plus interleaved input events.
+// 2. Seek: a synthetic 2-hour, 30 fps recording (small frames, explicit
+//    timestamps), then random seeks through the mmap'd index against a
+//    linear scan of the same file.
+
+#include "../common/session_recorder.h"
+
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+#define MAX_PACKET_SIZE 60000
+
+typedef std::chrono::steady_clock Clock;
+
+static double Micros(Clock::time_point a, Clock::time_point b)
+{
+    return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+// What the host does per frame besides encoding: copy every chunk into the
+// send buffer. Keeps the compiler from dropping the work.
+static unsigned SendLoop(const std::vector<uint8_t> &frame, std::vector<uint8_t> &sendBuffer)
+{
+    unsigned sink = 0;
+    for (size_t off = 0; off < frame.size(); off += MAX_PACKET_SIZE)
+    {
+        size_t len = std::min((size_t)MAX_PACKET_SIZE, frame.size() - off);
+        memcpy(sendBuffer.data(), frame.data() + off, len);
+        sink += sendBuffer[len / 2];
+    }
+    return sink;
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "/tmp/bench_record.rdcrec";
+    int fps = argc > 2 ? atoi(argv[2]) : 120;
+    double seconds = argc > 3 ? atof(argv[3]) : 10;
+    int frameBytes = argc > 4 ? atoi(argv[4]) : 70 * 1024;
+    int frames = (int)(fps * seconds);
+    auto interval = std::chrono::microseconds(1000000 / fps);
+
+    std::mt19937 rnd(1);
+    std::vector<std::vector<uint8_t>> pool(8, std::vector<uint8_t>(frameBytes));
+    for (auto &f : pool)
+        for (auto &b : f) b = (uint8_t)rnd();
+    std::vector<uint8_t> sendBuffer(MAX_PACKET_SIZE);
+    unsigned sink = 0;
+
+    // Baseline: send loop only (busy time per frame, pacing excluded).
+    double baseUs = 0;
+    auto due = Clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        auto t0 = Clock::now();
+        sink += SendLoop(pool[i % pool.size()], sendBuffer);
+        baseUs += Micros(t0, Clock::now());
+        std::this_thread::sleep_until(due += interval);
+    }
+    baseUs /= frames;
+
+    // Same loop while recording.
+    SessionRecorder recorder;
+    if (!recorder.Open(path))
+    {
+        printf("cannot open %s\n", path.c_str());
+        return 1;
+    }
+    std::vector<double> callUs(frames);
+    double recUs = 0;
+    due = Clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        const std::vector<uint8_t> &frame = pool[i % pool.size()];
+        auto t0 = Clock::now();
+        recorder.RecordFrame(frame.data(), (int)frame.size(), 1280, 720);
+        if (i % 4 == 0) recorder.RecordInput(1, i % 1280, i % 720, 0);
+        callUs[i] = Micros(t0, Clock::now());
+        sink += SendLoop(frame, sendBuffer);
+        recUs += Micros(t0, Clock::now());
+        std::this_thread::sleep_until(due += interval);
+    }
+    recUs /= frames;
+    auto c0 = Clock::now();
+    recorder.Close();
+    double drainMs = Micros(c0, Clock::now()) / 1000;
+
+    std::sort(callUs.begin(), callUs.end());
+    printf("%d frames x %d bytes at %d fps (%.1f MB/s to disk)\n", frames, frameBytes, fps, (double)frameBytes * fps / 1e6);
+    printf("  send loop: %.2f us/frame   with recording: %.2f us/frame   (+%.2f us)\n", baseUs, recUs, recUs - baseUs);
+    printf("  RecordFrame(): p50 %.2f us  p99 %.2f us  max %.2f us   dropped %llu   final drain %.1f ms\n",
+           callUs[frames / 2], callUs[frames * 99 / 100], callUs.back(), (unsigned long long)recorder.Dropped(), drainMs);
+
+    // Long synthetic recording for the seek test.
+    std::string seekPath = path + ".seek";
+    {
+        SessionRecorder longRec;
+        longRec.Open(seekPath);
+        std::vector<uint8_t> small(512, 0x11);
+        const uint64_t frameUs = 1000000 / 30;
+        for (uint64_t i = 0; i < 2 * 3600 * 30; i++)
+        {
+            longRec.RecordFrameAt(i * frameUs, small.data(), (int)small.size(), 1280, 720);
+            // Never drop here: give the writer time if the queue fills up.
+            if (i % 4096 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        longRec.Close();
+        if (longRec.Dropped()) printf("  (seek file dropped %llu frames)\n", (unsigned long long)longRec.Dropped());
+    }
+
+    SessionReader reader;
+    if (!reader.Open(seekPath))
+    {
+        printf("cannot read back %s\n", seekPath.c_str());
+        return 1;
+    }
+    RecordView rec;
+    uint64_t lastUs = 0, records = 0;
+    for (uint64_t off = reader.First(); reader.At(off, &rec); off = reader.Next(rec))
+    {
+        lastUs = std::max(lastUs, rec.timestampUs);
+        records++;
+    }
+
+    const int seeks = 20000;
+    std::vector<uint64_t> targets(seeks);
+    for (auto &t : targets) t = lastUs ? rnd() % lastUs : 0;
+
+    auto t0 = Clock::now();
+    for (uint64_t t : targets) sink += (unsigned)reader.Seek(t);
+    double seekUs = Micros(t0, Clock::now()) / seeks;
+
+    // Same lookups without the index: scan from the start.
+    const int scans = 50;
+    t0 = Clock::now();
+    for (int i = 0; i < scans; i++)
+    {
+        uint64_t best = reader.First();
+        for (uint64_t off = reader.First(); reader.At(off, &rec) && rec.timestampUs <= targets[i]; off = reader.Next(rec))
+        {
+            if (SessionReader::IsKeyframe(rec)) best = off;
+        }
+        sink += (unsigned)best;
+    }
+    double scanUs = Micros(t0, Clock::now()) / scans;
+
+    printf("  recording: %llu records, %.2f s, %zu index entries\n", (unsigned long long)records, lastUs / 1e6, reader.IndexEntries());
+    printf("  seek via mmap'd index: %.2f us   linear scan: %.2f us\n", seekUs, scanUs);
+    return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,506 @@
+// Relay (common/relay_server.h) fan-out and join latency over loopback UDP.
+//
+//   ./bin/bench_relay [seconds per run] [max viewers] [senders]
+//
+// One synthetic host publishes a stream to an in-process relay with the same
+// sealing and envelopes as host.exe --relay (common/relay_session.h).
+// Viewers are UDP sockets on this machine; each runs the real handshake
+// through the relay, gets the stream key and joins.
+//
+// Fan-out: the host sends FANOUT_FPS frames/s of FRAME_BYTES, chunked like
+// host.cpp, to 1 ... max viewers. Per run: the host's achieved frame rate
+// and what share of it the relay took in (anything pushing back on the host
+// shows here), datagrams/s and Gbit/s the relay sent, what share of the
+// datagrams each viewer should have got arrived, frames that arrived whole,
+// relay CPU per datagram sent, and capture-to-reassembled latency at the
+// VERIFY_VIEWERS viewers that decrypt and check every chunk. The largest run
+// is repeated with a 16x bigger queue per viewer.
+//
+// Slow viewers: SLOW_VIEWERS of SLOW_RUN_VIEWERS join with a SLOW_KBPS cap,
+// a third of the stream's rate. Whole frames per second and latency for
+// them and, separately, for everyone else, who should not notice.
+//
+// Join: the host idles at 1 fps, like an unchanged desktop under the frame
+// governor, and JOIN_VIEWERS viewers join at random moments. Time from the
+// first HELLO to holding the stream key, and from JOIN to the first whole
+// frame, with and without the relay's keyframe cache.
+
+#include "../common/media_clock.h"
+#include "../common/relay_server.h"
+#include "../common/relay_session.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+#define FRAME_BYTES (96 * 1024) // a 720p desktop at host.cpp's JPEG quality, roughly
+#define CHUNK_BYTES 60000       // host.cpp MAX_PACKET_SIZE
+#define FANOUT_FPS 30
+#define VERIFY_VIEWERS 2 // decrypt and check every chunk; the rest count envelopes
+#define SLOW_RUN_VIEWERS 32
+#define SLOW_VIEWERS 8
+#define SLOW_KBPS 8000
+#define JOIN_VIEWERS 20
+#define JOIN_FPS 1
+#define JOIN_WINDOW_MS 3000
+#define STREAM_NAME "bench"
+#define PSK "bench-key"
+
+typedef std::chrono::steady_clock Clock;
+
+static const int g_chunksPerFrame = (FRAME_BYTES + CHUNK_BYTES - 1) / CHUNK_BYTES;
+
+static int LoopbackSocket(int relayPort)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int buffer = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+    timeval timeout{0, 20000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in relay{};
+    relay.sin_family = AF_INET;
+    relay.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    relay.sin_port = htons((uint16_t)relayPort);
+    connect(fd, (sockaddr *)&relay, sizeof(relay));
+    return fd;
+}
+
+// host.exe --relay, minus the desktop: frames whose bytes encode their id.
+class SynthHost
+{
+public:
+    void Start(int relayPort, int fps)
+    {
+        m_fd = LoopbackSocket(relayPort);
+        m_fps = fps;
+        m_channel.InitBroadcast();
+        m_sessions.Init(PSK, RelayStreamId(STREAM_NAME), &m_channel);
+        m_running = true;
+        m_control = std::thread(&SynthHost::Control, this);
+        m_media = std::thread(&SynthHost::Media, this);
+    }
+
+    void Stop()
+    {
+        m_running = false;
+        m_control.join();
+        m_media.join();
+        close(m_fd);
+    }
+
+    uint32_t NextFrame() const { return m_nextFrame; }
+    uint64_t Sent() const { return m_sent; }
+
+private:
+    // Keep-alive and the viewers' handshakes (host.cpp: RelayKeepAlive, InputListener).
+    void Control()
+    {
+        uint8_t buffer[2048], reply[RELAY_REPLY_MAX], publish[RELAY_UP_HEADER_SIZE];
+        auto lastPublish = Clock::now() - std::chrono::seconds(1);
+        while (m_running)
+        {
+            if (Clock::now() - lastPublish > std::chrono::milliseconds(500))
+            {
+                int publishLen = m_sessions.WritePublish(publish);
+                send(m_fd, publish, publishLen, 0);
+                lastPublish = Clock::now();
+            }
+            int len = (int)recv(m_fd, buffer, sizeof(buffer), 0);
+            const uint8_t *message;
+            int messageLen;
+            int replyLen = len > 0 ? m_sessions.Handle(buffer, len, reply, &message, &messageLen) : -1;
+            if (replyLen > 0) send(m_fd, reply, replyLen, 0);
+        }
+    }
+
+    // host.cpp EncodeAndSend in relay mode, at a steady frame rate.
+    void Media()
+    {
+        std::vector<uint8_t> datagram(RELAY_HEADER_SIZE + SEAL_OVERHEAD + WIRE_FRAME_OVERHEAD + CHUNK_BYTES);
+        uint32_t stream = m_sessions.Stream();
+        auto next = Clock::now();
+        while (m_running)
+        {
+            std::this_thread::sleep_until(next);
+            next += std::chrono::microseconds(1000000 / m_fps);
+            uint32_t id = m_nextFrame;
+            uint64_t captureUs = (uint64_t)LocalMicros();
+            uint8_t fill = (uint8_t)(id * 7);
+            for (int i = 0; i < g_chunksPerFrame; i++)
+            {
+                int offset = i * CHUNK_BYTES;
+                int chunkLen = std::min(CHUNK_BYTES, FRAME_BYTES - offset);
+                uint8_t *plain = datagram.data() + RELAY_HEADER_SIZE + SEAL_SEQ_SIZE;
+                int headerLen = WireWriteFrameChunk(plain, id, captureUs, offset, FRAME_BYTES, 1280, 720, 0, WIRE_FLAG_KEYFRAME, chunkLen);
+                memset(plain + headerLen, fill, chunkLen);
+                int len = m_channel.Seal(datagram.data() + RELAY_HEADER_SIZE, headerLen + chunkLen);
+                len += RelayWriteHeader(datagram.data(), RELAY_MEDIA, stream, 0, RELAY_FLAG_KEYFRAME, id, i, g_chunksPerFrame, 0);
+                if (send(m_fd, datagram.data(), len, 0) == len) m_sent++;
+            }
+            m_nextFrame = id + 1;
+        }
+    }
+
+    int m_fd = -1;
+    int m_fps = FANOUT_FPS;
+    SecureChannel m_channel;
+    RelayHostSessions m_sessions;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint32_t> m_nextFrame{0};
+    std::atomic<uint64_t> m_sent{0};
+    std::thread m_control, m_media;
+};
+
+// Written only by the thread receiving for it; read after that thread ends.
+struct Viewer
+{
+    int fd = -1;
+    RelayViewerSession session;
+    bool verify = false;
+    uint64_t datagrams = 0, frames = 0, started = 0, bad = 0;
+    bool inFrame = false;
+    uint32_t frameId = 0;
+    int chunks = 0;
+    std::vector<int64_t> latencyUs;
+};
+
+// Frames in [g_countFrom, g_countTo) are counted (the measured window).
+// WINDOW_UNSET: not open yet / not closed yet.
+#define WINDOW_UNSET 0xFFFFFFFFu
+static std::atomic<uint32_t> g_countFrom{WINDOW_UNSET};
+static std::atomic<uint32_t> g_countTo{WINDOW_UNSET};
+
+static bool InWindow(uint32_t frameId)
+{
+    uint32_t from = g_countFrom.load(std::memory_order_relaxed);
+    uint32_t to = g_countTo.load(std::memory_order_relaxed);
+    return from != WINDOW_UNSET && (int32_t)(frameId - from) >= 0 && (to == WINDOW_UNSET || (int32_t)(frameId - to) < 0);
+}
+
+static bool Handshake(Viewer &v, int timeoutMs, uint32_t kbps = 0)
+{
+    uint8_t buffer[2048], reply[RELAY_REPLY_MAX];
+    auto start = Clock::now();
+    auto lastHello = start - std::chrono::seconds(1);
+    while (!v.session.Ready())
+    {
+        if (Clock::now() - start > std::chrono::milliseconds(timeoutMs)) return false;
+        if (Clock::now() - lastHello >= std::chrono::seconds(1))
+        {
+            int len = v.session.Begin(PSK, RelayStreamId(STREAM_NAME), reply);
+            send(v.fd, reply, len, 0);
+            lastHello = Clock::now();
+        }
+        int len = (int)recv(v.fd, buffer, sizeof(buffer), 0);
+        const uint8_t *message;
+        int messageLen;
+        int replyLen = len > 0 ? v.session.Handle(buffer, len, reply, &message, &messageLen) : -1;
+        if (replyLen > 0) send(v.fd, reply, replyLen, 0);
+    }
+    uint8_t join[RELAY_UP_HEADER_SIZE];
+    send(v.fd, join, v.session.WriteJoin(join, kbps), 0);
+    return true;
+}
+
+// One datagram from the relay. True when it completed a frame.
+static bool Receive(Viewer &v, uint8_t *data, int len)
+{
+    RelayHeader h;
+    if (!RelayParse(data, len, &h) || h.type != RELAY_MEDIA || h.chunkCount == 0) return false;
+    bool counted = InWindow(h.frameId);
+    if (counted) v.datagrams++;
+
+    uint64_t captureUs = 0;
+    if (v.verify)
+    {
+        uint8_t reply[RELAY_REPLY_MAX];
+        const uint8_t *message;
+        int messageLen;
+        WireFrameChunk chunk;
+        uint8_t fill = (uint8_t)(h.frameId * 7);
+        if (v.session.Handle(data, len, reply, &message, &messageLen) != 0 || !WireParse(message, messageLen, &chunk) ||
+            chunk.FrameId() != h.frameId || chunk.Payload()[0] != fill || chunk.Payload()[chunk.payloadLen - 1] != fill)
+        {
+            v.bad++;
+            return false;
+        }
+        captureUs = chunk.TimestampUs();
+    }
+
+    if (!v.inFrame || h.frameId != v.frameId)
+    {
+        if (counted) v.started++;
+        v.inFrame = true;
+        v.frameId = h.frameId;
+        v.chunks = 0;
+    }
+    if (++v.chunks < h.chunkCount) return false;
+    v.inFrame = false;
+    if (counted)
+    {
+        v.frames++;
+        if (v.verify) v.latencyUs.push_back(LocalMicros() - (int64_t)captureUs);
+    }
+    return true;
+}
+
+// Drains a share of the viewers with recvmmsg(), like the relay's own workers.
+static void ReceiveLoop(std::vector<Viewer *> viewers, std::atomic<bool> *running)
+{
+    std::vector<pollfd> fds;
+    for (Viewer *v : viewers) fds.push_back({v->fd, POLLIN, 0});
+    std::vector<uint8_t> arena((size_t)RECV_BATCH * RECV_MAX_DATAGRAM);
+    mmsghdr msgs[RECV_BATCH];
+    iovec iov[RECV_BATCH];
+    while (*running)
+    {
+        if (poll(fds.data(), fds.size(), 50) <= 0) continue;
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (!(fds[i].revents & POLLIN)) continue;
+            int n;
+            do
+            {
+                for (int k = 0; k < RECV_BATCH; k++)
+                {
+                    iov[k].iov_base = &arena[(size_t)k * RECV_MAX_DATAGRAM];
+                    iov[k].iov_len = RECV_MAX_DATAGRAM;
+                    memset(&msgs[k].msg_hdr, 0, sizeof(msghdr));
+                    msgs[k].msg_hdr.msg_iov = &iov[k];
+                    msgs[k].msg_hdr.msg_iovlen = 1;
+                }
+                n = recvmmsg(fds[i].fd, msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+                for (int k = 0; k < n; k++) Receive(*viewers[i], (uint8_t *)iov[k].iov_base, (int)msgs[k].msg_len);
+            } while (n == RECV_BATCH);
+        }
+    }
+}
+
+static double Percentile(std::vector<int64_t> v, double p)
+{
+    if (v.empty()) return 0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k] / 1000.0;
+}
+
+struct Group
+{
+    int viewers = 0;
+    double delivered = 0; // of the datagrams sent to each
+    double whole = 0;     // of the frames that began to arrive
+    double fps = 0;       // whole frames per viewer
+    std::vector<int64_t> latencyUs;
+};
+
+struct FanoutResult
+{
+    double hostFps, ingested, packetsPerSec, gbps, nsPerPacket;
+    Group fast, slow;
+};
+
+// The last `slowCount` viewers join capped at slowKbps.
+static FanoutResult RunFanout(int viewerCount, size_t queueBytes, int senders, double seconds, int slowCount = 0, uint32_t slowKbps = 0)
+{
+    RelayConfig config;
+    config.port = 0;
+    config.senders = senders;
+    config.queueBytes = queueBytes;
+    RelayServer relay;
+    if (!relay.Start(config))
+    {
+        fprintf(stderr, "bench_relay: cannot start the relay\n");
+        exit(1);
+    }
+    SynthHost host;
+    host.Start(relay.Port(), FANOUT_FPS);
+
+    int firstSlow = viewerCount - slowCount;
+    std::vector<Viewer> viewers(viewerCount);
+    for (int i = 0; i < viewerCount; i++)
+    {
+        viewers[i].fd = LoopbackSocket(relay.Port());
+        viewers[i].verify = i < VERIFY_VIEWERS || (i >= firstSlow && i < firstSlow + VERIFY_VIEWERS);
+        if (!Handshake(viewers[i], 5000, i >= firstSlow ? slowKbps : 0))
+        {
+            fprintf(stderr, "bench_relay: viewer %d could not join\n", i);
+            exit(1);
+        }
+    }
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    int receivers = (int)std::min<unsigned>(std::min(4u, cores), (unsigned)viewerCount);
+    std::vector<std::vector<Viewer *>> shares(receivers);
+    for (int i = 0; i < viewerCount; i++) shares[i % receivers].push_back(&viewers[i]);
+    std::atomic<bool> receiving{true};
+    std::vector<std::thread> threads;
+    for (auto &share : shares) threads.emplace_back(ReceiveLoop, share, &receiving);
+
+    // Measure after a warm-up, from a frame boundary.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    RelayCounters c0 = relay.Counters();
+    uint64_t sent0 = host.Sent();
+    uint32_t from = host.NextFrame();
+    g_countFrom = from;
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    RelayCounters c1 = relay.Counters();
+    uint32_t to = host.NextFrame();
+    g_countTo = to;
+    uint64_t sent1 = host.Sent();
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    host.Stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // let queues drain
+    receiving = false;
+    for (auto &t : threads) t.join();
+    relay.Stop();
+    g_countFrom = WINDOW_UNSET;
+    g_countTo = WINDOW_UNSET;
+
+    // Every frame sent in the window, to every viewer (the host keeps sending
+    // while the last frames drain, so anything beyond `to` is not counted).
+    double expectedFrames = (double)(to - from);
+    FanoutResult r;
+    uint64_t outPackets = c1.packetsOut - c0.packetsOut;
+    r.hostFps = (to - from) / wall;
+    r.ingested = 100.0 * (c1.packetsIn - c0.packetsIn) / std::max<uint64_t>(1, sent1 - sent0);
+    r.packetsPerSec = outPackets / wall;
+    r.gbps = (c1.bytesOut - c0.bytesOut) * 8.0 / 1e9 / wall;
+    r.nsPerPacket = outPackets ? 1000.0 * (c1.cpuUs - c0.cpuUs) / outPackets : 0;
+    uint64_t started[2] = {0, 0}, frames[2] = {0, 0}, datagrams[2] = {0, 0};
+    for (int i = 0; i < viewerCount; i++)
+    {
+        Viewer &v = viewers[i];
+        if (v.bad)
+        {
+            fprintf(stderr, "bench_relay: %llu chunks failed to open or check\n", (unsigned long long)v.bad);
+            exit(1);
+        }
+        int slow = i >= firstSlow;
+        Group &g = slow ? r.slow : r.fast;
+        g.viewers++;
+        started[slow] += v.started;
+        frames[slow] += v.frames;
+        datagrams[slow] += v.datagrams;
+        g.latencyUs.insert(g.latencyUs.end(), v.latencyUs.begin(), v.latencyUs.end());
+        close(v.fd);
+    }
+    for (int slow = 0; slow < 2; slow++)
+    {
+        Group &g = slow ? r.slow : r.fast;
+        if (!g.viewers) continue;
+        g.delivered = 100.0 * datagrams[slow] / (expectedFrames * g_chunksPerFrame * g.viewers);
+        g.whole = started[slow] ? 100.0 * frames[slow] / started[slow] : 0;
+        g.fps = frames[slow] / wall / g.viewers;
+    }
+    return r;
+}
+
+static void PrintFanout(int viewers, size_t queueBytes, const FanoutResult &r)
+{
+    printf("%7d %8zu %8.1f %8.1f%% %12.0f %9.2f %9.1f%% %9.1f%% %12.0f %8.1f %8.1f\n", viewers, queueBytes / 1024, r.hostFps,
+           r.ingested, r.packetsPerSec, r.gbps, r.fast.delivered, r.fast.whole, r.nsPerPacket, Percentile(r.fast.latencyUs, 0.5),
+           Percentile(r.fast.latencyUs, 0.99));
+}
+
+static void PrintGroup(const char *name, const Group &g)
+{
+    printf("%-28s %7d %9.1f%% %9.1f%% %11.1f %8.1f %8.1f\n", name, g.viewers, g.delivered, g.whole, g.fps, Percentile(g.latencyUs, 0.5),
+           Percentile(g.latencyUs, 0.99));
+}
+
+static void RunJoin(bool cache)
+{
+    RelayConfig config;
+    config.port = 0;
+    config.cache = cache;
+    RelayServer relay;
+    relay.Start(config);
+    SynthHost host;
+    host.Start(relay.Port(), JOIN_FPS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500)); // a frame to cache
+
+    std::vector<int64_t> handshakeUs(JOIN_VIEWERS, -1), firstFrameUs(JOIN_VIEWERS, -1);
+    std::vector<std::thread> joiners;
+    std::mt19937 rng(cache ? 1 : 2);
+    for (int i = 0; i < JOIN_VIEWERS; i++)
+    {
+        int delayMs = (int)(rng() % JOIN_WINDOW_MS);
+        joiners.emplace_back([&, i, delayMs] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            Viewer v;
+            v.fd = LoopbackSocket(relay.Port());
+            v.verify = true;
+            int64_t t0 = LocalMicros();
+            if (Handshake(v, 5000))
+            {
+                int64_t t1 = LocalMicros();
+                handshakeUs[i] = t1 - t0;
+                uint8_t buffer[RECV_MAX_DATAGRAM];
+                while (LocalMicros() - t1 < 5000000)
+                {
+                    int len = (int)recv(v.fd, buffer, sizeof(buffer), 0);
+                    if (len > 0 && Receive(v, buffer, len))
+                    {
+                        firstFrameUs[i] = LocalMicros() - t1;
+                        break;
+                    }
+                }
+            }
+            close(v.fd);
+        });
+    }
+    for (auto &t : joiners) t.join();
+    RelayCounters c = relay.Counters();
+    host.Stop();
+    relay.Stop();
+
+    std::vector<int64_t> hs, ff;
+    for (int i = 0; i < JOIN_VIEWERS; i++)
+    {
+        if (handshakeUs[i] >= 0) hs.push_back(handshakeUs[i]);
+        if (firstFrameUs[i] >= 0) ff.push_back(firstFrameUs[i]);
+    }
+    printf("%-16s %6zu/%d %10.2f %10.2f %10.1f %10.1f %10.1f %10llu\n", cache ? "keyframe cache" : "no cache", ff.size(), JOIN_VIEWERS,
+           Percentile(hs, 0.5), Percentile(hs, 0.95), Percentile(ff, 0.5), Percentile(ff, 0.95), Percentile(ff, 1.0),
+           (unsigned long long)c.cachedJoins);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double seconds = argc > 1 ? atof(argv[1]) : 3;
+    int maxViewers = argc > 2 ? atoi(argv[2]) : 128;
+    int senders = argc > 3 ? atoi(argv[3]) : (int)std::min(4u, cores);
+
+    printf("%u cores, %d relay sender(s); host: %d fps of %d KB in %d chunk(s), sealed; %d of the viewers decrypt and check\n\n", cores,
+           senders, FANOUT_FPS, FRAME_BYTES / 1024, g_chunksPerFrame, VERIFY_VIEWERS);
+    printf("%7s %8s %8s %9s %12s %9s %10s %10s %12s %8s %8s\n", "viewers", "queue KB", "host fps", "ingested", "datagrams/s",
+           "Gbit/s", "delivered", "whole", "ns/datagram", "p50 ms", "p99 ms");
+    int last = 0;
+    for (int n = 1; n <= maxViewers; n *= 4)
+    {
+        PrintFanout(n, RELAY_QUEUE_BYTES, RunFanout(n, RELAY_QUEUE_BYTES, senders, seconds));
+        last = n;
+    }
+    if (last != maxViewers) PrintFanout(maxViewers, RELAY_QUEUE_BYTES, RunFanout(maxViewers, RELAY_QUEUE_BYTES, senders, seconds));
+    PrintFanout(maxViewers, 16 * RELAY_QUEUE_BYTES, RunFanout(maxViewers, 16 * RELAY_QUEUE_BYTES, senders, seconds));
+
+    FanoutResult r = RunFanout(SLOW_RUN_VIEWERS, RELAY_QUEUE_BYTES, senders, seconds, SLOW_VIEWERS, SLOW_KBPS);
+    printf("\n%d viewers, %d of them capped at %d kbit/s (the stream is %.0f kbit/s); host %.1f fps, %.1f%% ingested\n",
+           SLOW_RUN_VIEWERS, SLOW_VIEWERS, SLOW_KBPS, FANOUT_FPS * (FRAME_BYTES + g_chunksPerFrame * 100) * 8 / 1000.0, r.hostFps,
+           r.ingested);
+    printf("%-28s %7s %10s %10s %11s %8s %8s\n", "", "viewers", "delivered", "whole", "fps/viewer", "p50 ms", "p99 ms");
+    PrintGroup("uncapped", r.fast);
+    PrintGroup("capped", r.slow);
+
+    printf("\n%d viewers joining a %d fps stream at random over %d s\n", JOIN_VIEWERS, JOIN_FPS, JOIN_WINDOW_MS / 1000);
+    printf("%-16s %8s %10s %10s %10s %10s %10s %10s\n", "relay", "joined", "key p50", "key p95", "frame p50", "frame p95", "frame max",
+           "from cache");
+    RunJoin(true);
+    RunJoin(false);
+    return 0;
+}
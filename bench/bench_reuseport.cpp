@@ -0,0 +1,216 @@
+// Receive engine (common/recv_engine.h) scaling over loopback UDP.
+//
+//   ./bin/bench_reuseport [seconds per run] [max workers] [flows] [sender threads]
+//
+// `flows` synthetic senders (one socket each, so one kernel flow each) send
+// frames of CHUNKS_PER_FRAME chunks of CHUNK_BYTES, as fast as they can, from
+// a few sender threads with sendmmsg(). Every frame's bytes encode its flow
+// and frame id, so the handler checks reassembly of every frame it gets.
+// Every DUPLICATE_EVERY-th frame sends its first chunk again in place of its
+// last (a duplicated datagram and a lost one): it must never be delivered.
+//
+// Runs: one thread with plain recvfrom() (client.cpp's loop), then the
+// engine with 1, 2, 4 ... workers on flow-hash steering, then CPU steering.
+// Per run: datagrams/s and frames/s received, share of sent datagrams that
+// arrived (the rest overflowed a socket buffer), frames abandoned half-way,
+// CPU per worker, and receive CPU per datagram (what a worker costs per
+// packet, so what one core can take).
+
+#include "../common/recv_engine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define CHUNK_BYTES 1200 // under a typical MTU, like relayed traffic
+#define CHUNKS_PER_FRAME 8
+#define DUPLICATE_EVERY 16
+
+typedef std::chrono::steady_clock Clock;
+
+// Checks and counts frames; one slot per worker so workers share nothing.
+class CheckingHandler : public RecvHandler
+{
+public:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> good{0};
+        std::atomic<uint64_t> bad{0};
+    };
+
+    void OnFrame(int worker, const RecvFrame &frame) override
+    {
+        uint8_t expect = (uint8_t)(frame.frameId * 31 + ntohs(frame.from.sin_port));
+        bool ok = frame.size == CHUNK_BYTES * CHUNKS_PER_FRAME && frame.data[0] == expect &&
+                  frame.data[frame.size - 1] == expect && frame.data[frame.size / 2] == expect;
+        Slot &s = m_slots[worker];
+        if (ok) s.good.store(s.good.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        else s.bad.store(s.bad.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    uint64_t Bad() const
+    {
+        uint64_t n = 0;
+        for (auto &s : m_slots) n += s.bad;
+        return n;
+    }
+
+private:
+    Slot m_slots[64];
+};
+
+struct Flow
+{
+    int fd;
+    uint16_t port;
+    uint32_t frameId = 0;
+};
+
+struct RunResult
+{
+    double packetsPerSec, framesPerSec, delivered, cpuPerWorker, nsPerPacket;
+    uint64_t incomplete, bad;
+};
+
+static RunResult Run(int workers, int steer, int batch, double seconds, int flowCount, int senderThreads, int *steerUsed)
+{
+    RecvEngine engine;
+    if (!engine.Open(0, workers, steer, batch))
+    {
+        fprintf(stderr, "bench_reuseport: cannot bind %d SO_REUSEPORT sockets\n", workers);
+        exit(1);
+    }
+    *steerUsed = engine.Steering();
+    CheckingHandler handler;
+    engine.Start(&handler);
+
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    dst.sin_port = htons((uint16_t)engine.Port());
+    std::vector<Flow> flows(flowCount);
+    for (auto &f : flows)
+    {
+        f.fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int buffer = 1 << 20;
+        setsockopt(f.fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+        connect(f.fd, (sockaddr *)&dst, sizeof(dst));
+        sockaddr_in self{};
+        socklen_t len = sizeof(self);
+        getsockname(f.fd, (sockaddr *)&self, &len);
+        f.port = ntohs(self.sin_port);
+    }
+
+    std::atomic<bool> sending{true};
+    std::atomic<uint64_t> sent{0};
+    std::vector<std::thread> senders;
+    for (int t = 0; t < senderThreads; t++)
+    {
+        senders.emplace_back([&, t] {
+            std::vector<uint8_t> chunks((size_t)CHUNKS_PER_FRAME * (WIRE_FRAME_OVERHEAD + CHUNK_BYTES));
+            mmsghdr msgs[CHUNKS_PER_FRAME];
+            iovec iov[CHUNKS_PER_FRAME];
+            uint64_t count = 0;
+            while (sending)
+            {
+                for (int i = t; i < flowCount && sending; i += senderThreads)
+                {
+                    Flow &f = flows[i];
+                    uint32_t id = f.frameId++;
+                    uint8_t fill = (uint8_t)(id * 31 + f.port);
+                    memset(msgs, 0, sizeof(msgs));
+                    for (int c = 0; c < CHUNKS_PER_FRAME; c++)
+                    {
+                        uint8_t *p = &chunks[(size_t)c * (WIRE_FRAME_OVERHEAD + CHUNK_BYTES)];
+                        int chunk = (c == CHUNKS_PER_FRAME - 1 && id % DUPLICATE_EVERY == 0) ? 0 : c;
+                        int header = WireWriteFrameChunk(p, id, 0, chunk * CHUNK_BYTES, CHUNK_BYTES * CHUNKS_PER_FRAME, 1280, 720, 0,
+                                                         WIRE_FLAG_KEYFRAME, CHUNK_BYTES);
+                        memset(p + header, fill, CHUNK_BYTES);
+                        iov[c].iov_base = p;
+                        iov[c].iov_len = header + CHUNK_BYTES;
+                        msgs[c].msg_hdr.msg_iov = &iov[c];
+                        msgs[c].msg_hdr.msg_iovlen = 1;
+                    }
+                    int n = sendmmsg(f.fd, msgs, CHUNKS_PER_FRAME, 0);
+                    if (n > 0) count += n;
+                }
+            }
+            sent += count;
+        });
+    }
+
+    // Measure after a short warm-up.
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    uint64_t packets0 = 0, frames0 = 0, cpu0 = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        packets0 += engine.Stats(i).packets;
+        frames0 += engine.Stats(i).frames;
+        cpu0 += engine.Stats(i).cpuUs;
+    }
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t packets = 0, frames = 0, cpu = 0, incomplete = 0;
+    for (int i = 0; i < workers; i++)
+    {
+        packets += engine.Stats(i).packets;
+        frames += engine.Stats(i).frames;
+        cpu += engine.Stats(i).cpuUs;
+        incomplete += engine.Stats(i).incomplete;
+    }
+
+    sending = false;
+    for (auto &t : senders) t.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    engine.Stop();
+    uint64_t received = 0;
+    for (int i = 0; i < workers; i++) received += engine.Stats(i).packets;
+    for (auto &f : flows) close(f.fd);
+
+    RunResult r;
+    r.packetsPerSec = (packets - packets0) / wall;
+    r.framesPerSec = (frames - frames0) / wall;
+    r.delivered = sent ? 100.0 * received / sent : 0;
+    r.cpuPerWorker = 100.0 * (cpu - cpu0) / 1e6 / wall / workers;
+    r.nsPerPacket = packets > packets0 ? 1000.0 * (cpu - cpu0) / (packets - packets0) : 0;
+    r.incomplete = incomplete;
+    r.bad = handler.Bad();
+    return r;
+}
+
+static void Print(const char *name, int workers, const RunResult &r)
+{
+    printf("%-24s %7d %12.0f %10.0f %9.1f%% %11llu %9.1f%% %12.0f\n", name, workers, r.packetsPerSec, r.framesPerSec,
+           r.delivered, (unsigned long long)r.incomplete, r.cpuPerWorker, r.nsPerPacket);
+    if (r.bad)
+    {
+        fprintf(stderr, "bench_reuseport: %llu frames reassembled wrong\n", (unsigned long long)r.bad);
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double seconds = argc > 1 ? atof(argv[1]) : 3;
+    int maxWorkers = argc > 2 ? atoi(argv[2]) : (int)std::max(4u, cores);
+    int flows = argc > 3 ? atoi(argv[3]) : 64;
+    int senderThreads = argc > 4 ? atoi(argv[4]) : (int)std::max(2u, cores / 2);
+    maxWorkers = std::min(maxWorkers, 64);
+
+    printf("%u cores, %d flows from %d sender threads, %d x %d-byte chunks per frame, %.0f s per run\n\n", cores, flows,
+           senderThreads, CHUNKS_PER_FRAME, CHUNK_BYTES, seconds);
+    printf("%-24s %7s %12s %10s %10s %11s %10s %12s\n", "receiver", "workers", "datagrams/s", "frames/s", "delivered",
+           "incomplete", "CPU/worker", "ns/datagram");
+
+    int steer;
+    Print("recvfrom, one thread", 1, Run(1, RECV_STEER_FLOW, 1, seconds, flows, senderThreads, &steer));
+    for (int w = 1; w <= maxWorkers; w *= 2)
+    {
+        Print("recvmmsg, flow hash", w, Run(w, RECV_STEER_FLOW, RECV_BATCH, seconds, flows, senderThreads, &steer));
+    }
+    RunResult r = Run(maxWorkers, RECV_STEER_CPU, RECV_BATCH, seconds, flows, senderThreads, &steer);
+    Print(steer == RECV_STEER_CPU ? "recvmmsg, CPU steering" : "(CPU steering refused)", maxWorkers, r);
+    return 0;
+}
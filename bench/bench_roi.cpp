@@ -0,0 +1,299 @@
+// Quality inside the ROI at a fixed byte budget (libjpeg stands in for GDI+).
+//
+// Baseline: the whole synthetic desktop frame at JPEG_QUALITY 25, as host.cpp
+// sends without ROI. ROI: RoiPrefilter() on the background, then the JPEG
+// quality RoiQuality settles on to stay within the baseline's byte count,
+// with a focused window and with a maximised one. Reports bytes, PSNR and
+// SSIM (luma) inside the ROI and on the background, plus the per-frame cost of
+// RoiMap::Update() + RoiPrefilter(), and how long a tile takes to fade when
+// the cursor leaves at 60 and at 1 fps (the governor runs anywhere between).
+
+#include "../common/roi_map.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <jpeglib.h>
+
+#define FRAME_W 1280
+#define FRAME_H 720
+#define BASE_QUALITY 25    // host.cpp JPEG_QUALITY
+#define ROI_MAX_QUALITY 75 // host.cpp ROI_MAX_QUALITY
+
+typedef std::chrono::steady_clock Clock;
+
+// Desktop-ish content: flat panels, window chrome and lots of small "text"
+// strokes, which is what makes screen content expensive for JPEG.
+static std::vector<uint8_t> MakeDesktop()
+{
+    std::vector<uint8_t> px((size_t)FRAME_W * FRAME_H * 4);
+    std::mt19937 rnd(7);
+    for (int y = 0; y < FRAME_H; y++)
+    {
+        for (int x = 0; x < FRAME_W; x++)
+        {
+            uint8_t *p = &px[((size_t)y * FRAME_W + x) * 4];
+            p[0] = (uint8_t)(120 + x / 20);
+            p[1] = (uint8_t)(80 + y / 12);
+            p[2] = 60;
+            p[3] = 255;
+        }
+    }
+    for (int w = 0; w < 6; w++)
+    {
+        int wx = rnd() % (FRAME_W - 400), wy = rnd() % (FRAME_H - 300);
+        for (int y = wy; y < wy + 300; y++)
+        {
+            for (int x = wx; x < wx + 400; x++)
+            {
+                uint8_t *p = &px[((size_t)y * FRAME_W + x) * 4];
+                bool titleBar = y < wy + 24;
+                bool glyph = !titleBar && ((y - wy) % 14) < 9 && (rnd() % 3 == 0);
+                uint8_t v = titleBar ? 70 : glyph ? 20 : 245;
+                p[0] = p[1] = p[2] = v;
+            }
+        }
+    }
+    return px;
+}
+
+static std::vector<uint8_t> Encode(const std::vector<uint8_t> &bgrx, int quality)
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char *out = NULL;
+    unsigned long outSize = 0;
+    jpeg_mem_dest(&cinfo, &out, &outSize);
+    cinfo.image_width = FRAME_W;
+    cinfo.image_height = FRAME_H;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    std::vector<uint8_t> row(FRAME_W * 3);
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        const uint8_t *src = &bgrx[(size_t)cinfo.next_scanline * FRAME_W * 4];
+        for (int x = 0; x < FRAME_W; x++)
+        {
+            row[x * 3 + 0] = src[x * 4 + 2];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 0];
+        }
+        JSAMPROW rows[1] = {row.data()};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> result(out, out + outSize);
+    free(out);
+    jpeg_destroy_compress(&cinfo);
+    return result;
+}
+
+static std::vector<uint8_t> DecodeLuma(const std::vector<uint8_t> &jpeg)
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+    std::vector<uint8_t> luma((size_t)FRAME_W * FRAME_H);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW rows[1] = {&luma[(size_t)cinfo.output_scanline * FRAME_W]};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return luma;
+}
+
+static std::vector<uint8_t> Luma(const std::vector<uint8_t> &bgrx)
+{
+    std::vector<uint8_t> luma((size_t)FRAME_W * FRAME_H);
+    for (size_t i = 0; i < luma.size(); i++)
+    {
+        const uint8_t *p = &bgrx[i * 4];
+        luma[i] = (uint8_t)((29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8);
+    }
+    return luma;
+}
+
+struct Quality
+{
+    double psnr;
+    double ssim;
+};
+
+// PSNR and mean 8x8 SSIM over the tiles where inRoi(tx, ty) matches `roi`.
+template <typename F>
+static Quality Measure(const std::vector<uint8_t> &ref, const std::vector<uint8_t> &img, F inRoi, bool roi)
+{
+    double se = 0, ssimSum = 0;
+    long count = 0, windows = 0;
+    const double c1 = 6.5025, c2 = 58.5225;
+    for (int by = 0; by + 8 <= FRAME_H; by += 8)
+    {
+        for (int bx = 0; bx + 8 <= FRAME_W; bx += 8)
+        {
+            if (inRoi(bx / ROI_TILE, by / ROI_TILE) != roi) continue;
+            double ma = 0, mb = 0, va = 0, vb = 0, cov = 0;
+            for (int y = by; y < by + 8; y++)
+            {
+                for (int x = bx; x < bx + 8; x++)
+                {
+                    double a = ref[(size_t)y * FRAME_W + x], b = img[(size_t)y * FRAME_W + x];
+                    se += (a - b) * (a - b);
+                    ma += a;
+                    mb += b;
+                }
+            }
+            ma /= 64;
+            mb /= 64;
+            for (int y = by; y < by + 8; y++)
+            {
+                for (int x = bx; x < bx + 8; x++)
+                {
+                    double a = ref[(size_t)y * FRAME_W + x] - ma, b = img[(size_t)y * FRAME_W + x] - mb;
+                    va += a * a;
+                    vb += b * b;
+                    cov += a * b;
+                }
+            }
+            va /= 63;
+            vb /= 63;
+            cov /= 63;
+            ssimSum += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+            count += 64;
+            windows++;
+        }
+    }
+    double mse = se / (count ? count : 1);
+    return {mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99.0, windows ? ssimSum / windows : 1.0};
+}
+
+// Time for the tile under the cursor to fade back to the background level
+// once the cursor leaves, with the map updated at `fps`.
+static int FadeMs(int fps)
+{
+    RoiMap map(FRAME_W, FRAME_H);
+    map.SetCursor(100, 100);
+    uint64_t now = 1000;
+    for (int i = 0; i < 60; i++) map.Update(now += 16);
+    map.SetCursor(FRAME_W - 100, FRAME_H - 100);
+    uint64_t left = now;
+    while (map.Level(100 / ROI_TILE, 100 / ROI_TILE) < 2 && now - left < 60000) map.Update(now += 1000 / fps);
+    return (int)(now - left);
+}
+
+// One set of cues: the map settled on them, then frames encoded the way
+// host.cpp does (RoiQuality on a budget re-measured every
+// ROI_BUDGET_FRAMES). Prints bytes against uniform BASE_QUALITY and quality
+// inside / outside the ROI; fails if the settled frames go over budget.
+template <typename Setup>
+static void RunCase(const char *name, const std::vector<uint8_t> &frame, const std::vector<uint8_t> &ref, Setup setup)
+{
+    RoiMap map(FRAME_W, FRAME_H);
+    setup(map);
+    for (int i = 0; i < 60; i++) map.Update(1000 + i * 16); // let smoothing settle
+    auto inRoi = [&](int tx, int ty) { return map.Level(tx, ty) == 0; };
+
+    std::vector<uint8_t> base = Encode(frame, BASE_QUALITY);
+    RoiQuality quality(BASE_QUALITY, ROI_MAX_QUALITY);
+    std::vector<uint8_t> filtered, roiJpeg;
+    size_t settledBytes = 0, worst = 0;
+    const int frames = 2 * ROI_BUDGET_FRAMES, settled = ROI_BUDGET_FRAMES / 2;
+    for (int i = 0; i < frames; i++)
+    {
+        if (quality.NeedsBudget()) quality.SetBudget(Encode(frame, BASE_QUALITY).size());
+        filtered = frame;
+        map.Update(1000 + (60 + i) * 16);
+        RoiPrefilter(filtered.data(), FRAME_W, FRAME_H, FRAME_W * 4, map);
+        roiJpeg = Encode(filtered, quality.Quality());
+        if (i >= frames - settled)
+        {
+            settledBytes += roiJpeg.size();
+            worst = std::max(worst, roiJpeg.size());
+        }
+        if (i < frames - 1) quality.Observe(roiJpeg.size());
+    }
+    settledBytes /= settled;
+
+    std::vector<uint8_t> baseLuma = DecodeLuma(base);
+    std::vector<uint8_t> roiLuma = DecodeLuma(roiJpeg);
+    Quality baseIn = Measure(ref, baseLuma, inRoi, true), baseOut = Measure(ref, baseLuma, inRoi, false);
+    Quality roiIn = Measure(ref, roiLuma, inRoi, true), roiOut = Measure(ref, roiLuma, inRoi, false);
+
+    int roiTiles = 0;
+    for (int ty = 0; ty < map.TilesY(); ty++)
+        for (int tx = 0; tx < map.TilesX(); tx++) roiTiles += inRoi(tx, ty);
+
+    printf("%s: ROI = %d of %d tiles\n", name, roiTiles, map.TilesX() * map.TilesY());
+    printf("  uniform q%-2d  %7zu B                 ROI: PSNR %5.2f dB  SSIM %.4f   background: PSNR %5.2f dB  SSIM %.4f\n",
+           BASE_QUALITY, base.size(), baseIn.psnr, baseIn.ssim, baseOut.psnr, baseOut.ssim);
+    printf("  ROI q%-2d      %7zu B (max %7zu) ROI: PSNR %5.2f dB  SSIM %.4f   background: PSNR %5.2f dB  SSIM %.4f\n",
+           quality.Quality(), settledBytes, worst, roiIn.psnr, roiIn.ssim, roiOut.psnr, roiOut.ssim);
+    if (settledBytes > base.size() * 102 / 100)
+    {
+        fprintf(stderr, "bench_roi: %s: %zu bytes per frame against a budget of %zu\n", name, settledBytes, base.size());
+        exit(1);
+    }
+}
+
+int main()
+{
+    std::vector<uint8_t> frame = MakeDesktop();
+    std::vector<uint8_t> ref = Luma(frame);
+    printf("%dx%d, budget: uniform q%d of the same frame; ROI bytes are the mean of the last %d frames\n\n", FRAME_W, FRAME_H,
+           BASE_QUALITY, ROI_BUDGET_FRAMES / 2);
+
+    // Cursor in the middle-left, focused window around it, user typing.
+    RunCase("focused window", frame, ref, [](RoiMap &map) {
+        map.SetCursor(420, 330);
+        map.SetFocus({260, 200, 420, 300});
+        map.NoteInput(1000);
+    });
+    // The same, maximised: the focus cue covers the whole display.
+    RunCase("maximised window", frame, ref, [](RoiMap &map) {
+        map.SetCursor(420, 330);
+        map.SetFocus({0, 0, FRAME_W, FRAME_H});
+        map.NoteInput(1000);
+    });
+
+    // Cost per frame, excluding the copy that gives each rep fresh pixels.
+    RoiMap map(FRAME_W, FRAME_H);
+    map.SetCursor(420, 330);
+    map.SetFocus({260, 200, 420, 300});
+    std::vector<uint8_t> filtered = frame;
+    double costUs = 0, copyUs = 0;
+    const int reps = 200;
+    for (int i = 0; i < reps; i++)
+    {
+        auto t0 = Clock::now();
+        filtered = frame;
+        copyUs += std::chrono::duration<double>(Clock::now() - t0).count() * 1e6;
+        t0 = Clock::now();
+        map.Update(1000 + i * 16);
+        RoiPrefilter(filtered.data(), FRAME_W, FRAME_H, FRAME_W * 4, map);
+        costUs += std::chrono::duration<double>(Clock::now() - t0).count() * 1e6;
+    }
+    costUs /= reps;
+    copyUs /= reps;
+
+    printf("\nmap update + prefilter: %.1f us/frame (one plain frame copy: %.1f us)\n", costUs, copyUs);
+    printf("fade to background after the cursor leaves: %d ms at 60 fps, %d ms at 1 fps\n", FadeMs(60), FadeMs(1));
+    return 0;
+}
@@ -0,0 +1,252 @@
+// Per-display streams on StreamScheduler (common/stream_scheduler.h) with
+// synthetic sources standing in for GDI capture and libjpeg for GDI+.
+//
+//   ./bin/bench_streams [displays] [seconds] [width] [height]
+//
+// 1. Sequential: one thread captures + encodes every display in turn, which
+//    is what a single host loop does.
+// 2. Parallel: one pinned worker per display. Reports aggregate FPS and the
+//    CPU each worker (= each core) used.
+// 3. Dirty tracking: the same displays with a static desktop; workers only
+//    encode the REFRESH_INTERVAL_MS keep-alive frames, and once idle the
+//    governor drops capture to polls (bench_governor.cpp has the details).
+//
+// Every encoded frame is chunked and sent over loopback UDP under one lock,
+// like host.cpp does with the shared SecureChannel.
+
+#include "../common/media_clock.h"
+#include "../common/stream_scheduler.h"
+#include "../common/wire_format.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include <jpeglib.h>
+
+#define MAX_PACKET_SIZE 60000
+#define JPEG_QUALITY 60
+
+typedef std::chrono::steady_clock Clock;
+
+static int g_sock = -1;
+static sockaddr_in g_sink{};
+static std::mutex g_sendLock;
+static MediaClock g_mediaClock;
+
+// Desktop-ish frame plus a moving "window" so every frame has dirty tiles.
+class SyntheticPipeline : public StreamPipeline
+{
+public:
+    SyntheticPipeline(int index, int width, int height, bool animate)
+        : m_index(index), m_width(width), m_height(height), m_animate(animate),
+          m_desktop((size_t)width * height * 4), m_frame(m_desktop.size())
+    {
+        std::mt19937 rnd(index + 1);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                uint8_t *p = &m_desktop[((size_t)y * width + x) * 4];
+                bool glyph = (y % 14) < 9 && (rnd() % 5 == 0);
+                uint8_t v = glyph ? 30 : (uint8_t)(200 + (x + index * 40) % 40);
+                p[0] = v;
+                p[1] = v;
+                p[2] = (uint8_t)(v - 20);
+                p[3] = 255;
+            }
+        }
+        m_frame = m_desktop;
+        m_packet.resize(WIRE_FRAME_OVERHEAD + MAX_PACKET_SIZE);
+    }
+
+    bool Capture(const uint8_t **pixels, int *width, int *height, int *stride) override
+    {
+        if (m_animate)
+        {
+            // Restore last position, draw the block at the next one.
+            const int bw = 320, bh = 200;
+            int range = std::max(1, m_width - bw);
+            for (int pass = 0; pass < 2; pass++)
+            {
+                int bx = m_tick % range, by = (m_tick * 3) % std::max(1, m_height - bh);
+                for (int y = by; y < by + bh; y++)
+                {
+                    uint8_t *dst = &m_frame[((size_t)y * m_width + bx) * 4];
+                    if (pass == 0) memcpy(dst, &m_desktop[((size_t)y * m_width + bx) * 4], bw * 4);
+                    else memset(dst, (m_tick * 7) & 0xff, bw * 4);
+                }
+                if (pass == 0) m_tick += 4;
+            }
+        }
+        m_captureUs = g_mediaClock.NowUs();
+        *pixels = m_frame.data();
+        *width = m_width;
+        *height = m_height;
+        *stride = m_width * 4;
+        return true;
+    }
+
+    void EncodeAndSend(bool refresh) override
+    {
+        (void)refresh;
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr jerr;
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+        unsigned char *out = NULL;
+        unsigned long outSize = 0;
+        jpeg_mem_dest(&cinfo, &out, &outSize);
+        cinfo.image_width = m_width;
+        cinfo.image_height = m_height;
+        cinfo.input_components = 4;
+        cinfo.in_color_space = JCS_EXT_BGRX;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+        cinfo.dct_method = JDCT_IFAST;
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height)
+        {
+            JSAMPROW row = &m_frame[(size_t)cinfo.next_scanline * m_width * 4];
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+
+        {
+            std::lock_guard<std::mutex> guard(g_sendLock);
+            uint32_t id = m_frameId++;
+            for (unsigned long off = 0; off < outSize; off += MAX_PACKET_SIZE)
+            {
+                int len = (int)std::min((unsigned long)MAX_PACKET_SIZE, outSize - off);
+                int headerLen = WireWriteFrameChunk(m_packet.data(), id, m_captureUs, off, outSize, m_width, m_height, m_index, WIRE_FLAG_KEYFRAME, len);
+                memcpy(m_packet.data() + headerLen, out + off, len);
+                sendto(g_sock, m_packet.data(), headerLen + len, MSG_DONTWAIT, (sockaddr *)&g_sink, sizeof(g_sink));
+            }
+        }
+        free(out);
+    }
+
+private:
+    int m_index, m_width, m_height;
+    bool m_animate;
+    int m_tick = 0;
+    uint32_t m_frameId = 0;
+    uint64_t m_captureUs = 0;
+    std::vector<uint8_t> m_desktop, m_frame;
+    std::vector<uint8_t> m_packet;
+};
+
+// The old single host loop: every display, one after the other, one thread.
+class SequentialPipeline : public StreamPipeline
+{
+public:
+    explicit SequentialPipeline(std::vector<SyntheticPipeline *> displays) : m_displays(displays) {}
+    ~SequentialPipeline()
+    {
+        for (auto *d : m_displays) delete d;
+    }
+
+    bool Capture(const uint8_t **pixels, int *width, int *height, int *stride) override
+    {
+        // Always dirty: the display pipelines hash nothing here.
+        for (auto *d : m_displays) d->Capture(pixels, width, height, stride);
+        return true;
+    }
+
+    void EncodeAndSend(bool refresh) override
+    {
+        for (auto *d : m_displays) d->EncodeAndSend(refresh);
+    }
+
+private:
+    std::vector<SyntheticPipeline *> m_displays;
+};
+
+static double Run(StreamScheduler &scheduler, double seconds, int framesPerPass, const char *title, bool perStream)
+{
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    auto start = Clock::now();
+    scheduler.Start(true);
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    scheduler.Stop();
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+    uint64_t sent = 0;
+    std::vector<double> coreCpu(cores, 0.0);
+    for (size_t i = 0; i < scheduler.Count(); i++)
+    {
+        const StreamStats &s = scheduler.Stats((int)i);
+        sent += s.sent * framesPerPass;
+        if (s.core >= 0) coreCpu[s.core] += s.cpuUs / 1e6;
+    }
+    printf("%s: %.1f fps aggregate\n", title, sent / wall);
+    if (perStream)
+    {
+        for (size_t i = 0; i < scheduler.Count(); i++)
+        {
+            const StreamStats &s = scheduler.Stats((int)i);
+            printf("  display %zu: core %d  %6.1f fps sent  %6.1f skipped/s  %5.1f%% CPU  %.2f ms CPU/frame\n", i, s.core,
+                   s.sent / wall, s.skipped / wall, 100.0 * s.cpuUs / 1e6 / wall,
+                   s.captured ? s.cpuUs / 1000.0 / s.captured : 0.0);
+        }
+    }
+    printf("  CPU per core:");
+    for (unsigned c = 0; c < cores; c++) printf(" [%u] %.0f%%", c, 100.0 * coreCpu[c] / wall);
+    printf("\n");
+    return sent / wall;
+}
+
+int main(int argc, char **argv)
+{
+    int displays = argc > 1 ? atoi(argv[1]) : 3;
+    double seconds = argc > 2 ? atof(argv[2]) : 5;
+    int width = argc > 3 ? atoi(argv[3]) : 1920;
+    int height = argc > 4 ? atoi(argv[4]) : 1080;
+    // Throughput runs are unpaced; the host uses STREAM_MAX_FPS.
+    const int unpaced = 100000;
+
+    g_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int sink = socket(AF_INET, SOCK_DGRAM, 0);
+    g_sink.sin_family = AF_INET;
+    g_sink.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sink, (sockaddr *)&g_sink, sizeof(g_sink));
+    socklen_t sinkLen = sizeof(g_sink);
+    getsockname(sink, (sockaddr *)&g_sink, &sinkLen);
+    // Nobody reads the sink: a receiver is not what is being measured, the
+    // kernel just drops what does not fit.
+
+    printf("%d displays %dx%d, %u cores, JPEG q%d\n", displays, width, height,
+           std::max(1u, std::thread::hardware_concurrency()), JPEG_QUALITY);
+
+    double sequentialFps, parallelFps;
+    {
+        std::vector<SyntheticPipeline *> all;
+        for (int i = 0; i < displays; i++) all.push_back(new SyntheticPipeline(i, width, height, true));
+        StreamScheduler scheduler;
+        scheduler.Add(new SequentialPipeline(all), unpaced);
+        sequentialFps = Run(scheduler, seconds, displays, "sequential (one loop)", false);
+    }
+    {
+        StreamScheduler scheduler;
+        for (int i = 0; i < displays; i++) scheduler.Add(new SyntheticPipeline(i, width, height, true), unpaced);
+        parallelFps = Run(scheduler, seconds, 1, "parallel (worker per display)", true);
+    }
+    printf("  speedup: %.2fx\n", parallelFps / std::max(sequentialFps, 1e-9));
+    {
+        StreamScheduler scheduler;
+        for (int i = 0; i < displays; i++) scheduler.Add(new SyntheticPipeline(i, width, height, false), 60);
+        Run(scheduler, seconds, 1, "static desktop at 60 fps cap (dirty tracking + idle governor)", true);
+    }
+
+    close(sink);
+    close(g_sock);
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Parse throughput of common/wire_format.h, in packets/sec.
+//
+//   ./bin/bench_wire [packets]
+//
+// A mix of frame chunks (60000-byte payload, like host.cpp), input and
+// subscribe messages, plus ~10% corrupted datagrams. Compared against the old
+// receive path: casting a packed struct over the buffer with no validation.
+
+#include "../common/wire_format.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define MAX_PACKET_SIZE 60000
+
+typedef std::chrono::steady_clock Clock;
+
+#pragma pack(push, 1)
+struct LegacyHeader
+{
+    int offset;
+    int dataLen;
+    int totalSize;
+    int width;
+    int height;
+    int display;
+};
+#pragma pack(pop)
+
+int main(int argc, char **argv)
+{
+    long packets = argc > 1 ? atol(argv[1]) : 20000000;
+    std::mt19937 rnd(3);
+
+    // Datagrams live in one arena, like a batch of recvmmsg() buffers.
+    const int count = 256;
+    const int slot = WIRE_FRAME_OVERHEAD + MAX_PACKET_SIZE;
+    std::vector<uint8_t> arena((size_t)count * slot);
+    std::vector<int> lens(count);
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t *p = &arena[(size_t)i * slot];
+        int kind = rnd() % 10;
+        if (kind < 6)
+            lens[i] = WireWriteFrameChunk(p, i, i * 16667, (i % 4) * MAX_PACKET_SIZE, 4 * MAX_PACKET_SIZE, 1920, 1080, i % 3, 1, MAX_PACKET_SIZE) + MAX_PACKET_SIZE;
+        else if (kind < 8)
+            lens[i] = WireWriteInput(p, 1 + rnd() % 7, 0, rnd() % 1920, rnd() % 1080, rnd() % 256);
+        else if (kind < 9)
+            lens[i] = WireWriteSubscribe(p, WIRE_ALL_DISPLAYS, 0, 0, 0, 0);
+        else
+        {
+            lens[i] = WireWriteFrameChunk(p, i, 0, 0, 100, 1920, 1080, 0, 1, MAX_PACKET_SIZE) + MAX_PACKET_SIZE; // payload > totalSize
+            p[rnd() % WIRE_FRAME_OVERHEAD] ^= 0x40;
+        }
+    }
+
+    // Wire format: dispatch on type, parse, touch the fields a receiver uses.
+    uint64_t sink = 0, frames = 0, inputs = 0, subs = 0, rejected = 0;
+    auto t0 = Clock::now();
+    for (long n = 0; n < packets; n++)
+    {
+        int i = n & (count - 1);
+        const uint8_t *p = &arena[(size_t)i * slot];
+        WireFrameChunk f;
+        WireInput in;
+        WireSubscribe sub;
+        switch (WireType(p, lens[i]))
+        {
+        case WIRE_FRAME:
+            if (WireParse(p, lens[i], &f)) { sink += f.Offset() + f.TotalSize() + f.Width() + f.payloadLen; frames++; continue; }
+            break;
+        case WIRE_INPUT:
+            if (WireParse(p, lens[i], &in)) { sink += in.X() + in.Y() + in.Key(); inputs++; continue; }
+            break;
+        case WIRE_SUBSCRIBE:
+            if (WireParse(p, lens[i], &sub)) { sink += sub.Display(); subs++; continue; }
+            break;
+        }
+        rejected++;
+    }
+    double wireSec = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    // Old path: reinterpret the first bytes, trust everything.
+    t0 = Clock::now();
+    for (long n = 0; n < packets; n++)
+    {
+        int i = n & (count - 1);
+        const LegacyHeader *h = (const LegacyHeader *)&arena[(size_t)i * slot];
+        sink += h->offset + h->totalSize + h->width + h->dataLen;
+    }
+    double rawSec = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    printf("%ld packets (%llu frame, %llu input, %llu subscribe, %llu rejected)\n", packets,
+           (unsigned long long)frames, (unsigned long long)inputs, (unsigned long long)subs, (unsigned long long)rejected);
+    printf("  validated parse: %7.1f M packets/s  (%.2f ns/packet)\n", packets / wireSec / 1e6, wireSec * 1e9 / packets);
+    printf("  raw struct cast: %7.1f M packets/s  (%.2f ns/packet)\n", packets / rawSec / 1e6, rawSec * 1e9 / packets);
+    return sink == 42 ? 1 : 0;
+}
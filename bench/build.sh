@@ -0,0 +1,16 @@
+#!/bin/sh
+# Linux benchmarks for the portable pieces. Binaries go to bench/bin/.
+cd "$(dirname "$0")"
+mkdir -p bin
+g++ -O2 -std=c++17 bench_crypto.cpp -o bin/bench_crypto -lcrypto
+g++ -O2 -std=c++17 bench_roi.cpp -o bin/bench_roi -ljpeg
+g++ -O2 -std=c++17 bench_record.cpp -o bin/bench_record -lpthread
+g++ -O2 -std=c++17 ../tools/rdc_player.cpp -o bin/rdc_player -lpthread
+g++ -O2 -std=c++17 bench_streams.cpp -o bin/bench_streams -ljpeg -lpthread
+g++ -O2 -std=c++17 bench_wire.cpp -o bin/bench_wire
+g++ -O1 -g -std=c++17 -fsanitize=address,undefined fuzz_wire.cpp -o bin/fuzz_wire
+g++ -O2 -std=c++17 bench_governor.cpp -o bin/bench_governor -ljpeg -lpthread
+g++ -O2 -std=c++17 bench_audio.cpp -o bin/bench_audio -lpthread
+g++ -O2 -std=c++17 bench_reuseport.cpp -o bin/bench_reuseport -lpthread
+g++ -O2 -std=c++17 bench_relay.cpp -o bin/bench_relay -lcrypto -lpthread
+g++ -O2 -std=c++17 ../relay/relay.cpp -o bin/relay -lcrypto -lpthread
@@ -0,0 +1,263 @@
+// Fuzzer for common/wire_format.h.
+//
+// Every input is fed to all four parsers. Accepted messages are checked
+// against a straightforward reference decoder (field by field, plain ifs)
+// and against the invariants receivers rely on: payload inside the datagram,
+// offset + payload within totalSize, sizes, dimensions and audio formats
+// within limits. Any disagreement aborts.
+//
+// Standalone (mutates valid packets and random bytes, runs under ASan/UBSan):
+//   ./bin/fuzz_wire [iterations] [seed]
+// libFuzzer:
+//   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -DWIRE_LIBFUZZER fuzz_wire.cpp -o fuzz_wire
+
+#include "../common/wire_format.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        if (!(cond))                                                       \
+        {                                                                  \
+            fprintf(stderr, "fuzz_wire: %s (line %d)\n", #cond, __LINE__); \
+            abort();                                                       \
+        }                                                                  \
+    } while (0)
+
+static uint32_t Le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint32_t Le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+// Reference: what each parser must accept, written for clarity not speed.
+static bool RefHeader(const uint8_t *d, int len, int type, int fixed, bool variable)
+{
+    if (len < WIRE_HEADER_SIZE + fixed) return false;
+    if (Le16(d) != WIRE_MAGIC) return false;
+    if (d[2] != WIRE_VERSION) return false;
+    if (d[3] != type) return false;
+    int bodyLen = len - WIRE_HEADER_SIZE;
+    if (bodyLen > WIRE_MAX_BODY) return false;
+    if ((int)Le16(d + 4) != bodyLen) return false;
+    if (!variable && bodyLen != fixed) return false;
+    return true;
+}
+
+static bool RefFrame(const uint8_t *d, int len)
+{
+    if (!RefHeader(d, len, WIRE_FRAME, WIRE_FRAME_BODY, true)) return false;
+    const uint8_t *b = d + WIRE_HEADER_SIZE;
+    uint64_t offset = Le32(b + 4), total = Le32(b + 8);
+    uint64_t payload = len - WIRE_FRAME_OVERHEAD;
+    if (total == 0 || total > WIRE_MAX_FRAME_BYTES) return false;
+    if (offset >= total) return false;
+    if (payload == 0 || offset + payload > total) return false;
+    int w = Le16(b + 12), h = Le16(b + 14);
+    if (w == 0 || w > WIRE_MAX_DIM || h == 0 || h > WIRE_MAX_DIM) return false;
+    if (b[16] >= WIRE_MAX_DISPLAYS) return false;
+    return true;
+}
+
+static bool RefInput(const uint8_t *d, int len)
+{
+    if (!RefHeader(d, len, WIRE_INPUT, WIRE_INPUT_BODY, false)) return false;
+    const uint8_t *b = d + WIRE_HEADER_SIZE;
+    if (b[0] < INPUT_MOUSE_MOVE || b[0] > INPUT_KEY_UP) return false;
+    if (b[1] >= WIRE_MAX_DISPLAYS) return false;
+    if (Le32(b + 4) >= WIRE_MAX_DIM || Le32(b + 8) >= WIRE_MAX_DIM) return false;
+    if (Le32(b + 12) > 255) return false;
+    return true;
+}
+
+static bool RefSubscribe(const uint8_t *d, int len)
+{
+    if (!RefHeader(d, len, WIRE_SUBSCRIBE, WIRE_SUBSCRIBE_BODY, false)) return false;
+    const uint8_t *b = d + WIRE_HEADER_SIZE;
+    if (b[0] >= WIRE_MAX_DISPLAYS && b[0] != WIRE_ALL_DISPLAYS) return false;
+    uint32_t x = Le16(b + 2), y = Le16(b + 4), w = Le16(b + 6), h = Le16(b + 8);
+    if (w == 0 && h == 0) return true;
+    if (w == 0 || h == 0 || w > WIRE_MAX_DIM || h > WIRE_MAX_DIM) return false;
+    return x + w <= WIRE_MAX_DIM && y + h <= WIRE_MAX_DIM;
+}
+
+static bool RefAudio(const uint8_t *d, int len)
+{
+    if (!RefHeader(d, len, WIRE_AUDIO, WIRE_AUDIO_BODY, true)) return false;
+    const uint8_t *b = d + WIRE_HEADER_SIZE;
+    uint32_t rate = Le32(b + 12), samples = Le16(b + 18);
+    if (rate < 8000 || rate > 48000) return false;
+    if (b[16] != AUDIO_CODEC_ADPCM && b[16] != AUDIO_CODEC_OPUS) return false;
+    if (b[17] < 1 || b[17] > 2) return false;
+    if (samples == 0 || samples > WIRE_MAX_AUDIO_SAMPLES) return false;
+    return len > WIRE_AUDIO_OVERHEAD;
+}
+
+static void CheckOne(const uint8_t *data, int len)
+{
+    WireFrameChunk frame;
+    bool ok = WireParse(data, len, &frame);
+    CHECK(ok == RefFrame(data, len));
+    if (ok)
+    {
+        CHECK(frame.Payload() > data && frame.Payload() + frame.payloadLen == data + len);
+        CHECK(frame.payloadLen > 0);
+        CHECK((uint64_t)frame.Offset() + frame.payloadLen <= frame.TotalSize());
+        CHECK(frame.TotalSize() <= WIRE_MAX_FRAME_BYTES);
+        CHECK(frame.Width() >= 1 && frame.Width() <= WIRE_MAX_DIM && frame.Height() >= 1 && frame.Height() <= WIRE_MAX_DIM);
+        CHECK(frame.Display() < WIRE_MAX_DISPLAYS);
+    }
+
+    WireInput input;
+    ok = WireParse(data, len, &input);
+    CHECK(ok == RefInput(data, len));
+    if (ok)
+    {
+        CHECK(input.payloadLen == 0);
+        CHECK(input.X() >= 0 && input.X() < WIRE_MAX_DIM && input.Y() >= 0 && input.Y() < WIRE_MAX_DIM);
+        CHECK(input.Key() >= 0 && input.Key() < 256 && input.Display() < WIRE_MAX_DISPLAYS);
+    }
+
+    WireSubscribe sub;
+    ok = WireParse(data, len, &sub);
+    CHECK(ok == RefSubscribe(data, len));
+    if (ok) CHECK(sub.AllDisplays() || sub.Display() < WIRE_MAX_DISPLAYS);
+
+    WireAudio audio;
+    ok = WireParse(data, len, &audio);
+    CHECK(ok == RefAudio(data, len));
+    if (ok)
+    {
+        CHECK(audio.Payload() > data && audio.Payload() + audio.payloadLen == data + len && audio.payloadLen > 0);
+        CHECK(audio.SampleRate() >= 8000 && audio.SampleRate() <= 48000);
+        CHECK(audio.Channels() >= 1 && audio.Channels() <= 2);
+        CHECK(audio.FrameSamples() >= 1 && audio.FrameSamples() <= WIRE_MAX_AUDIO_SAMPLES);
+    }
+
+    // At most one type can match.
+    int matches = RefFrame(data, len) + RefInput(data, len) + RefSubscribe(data, len) + RefAudio(data, len);
+    CHECK(matches <= 1);
+    if (matches) CHECK(WireType(data, len) != 0);
+}
+
+#ifdef WIRE_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size <= (size_t)WIRE_HEADER_SIZE + WIRE_MAX_BODY) CheckOne(data, (int)size);
+    return 0;
+}
+#else
+// Valid packets of every type, so mutations land near the accept boundary.
+static std::vector<std::vector<uint8_t>> Seeds(std::mt19937 &rnd)
+{
+    std::vector<std::vector<uint8_t>> seeds;
+    for (int i = 0; i < 32; i++)
+    {
+        int payload = 1 + rnd() % 2000;
+        std::vector<uint8_t> p(WIRE_FRAME_OVERHEAD + payload);
+        uint32_t total = payload + rnd() % 100000;
+        WireWriteFrameChunk(p.data(), rnd(), rnd(), total - payload - rnd() % (total - payload + 1), total,
+                            1 + rnd() % 4000, 1 + rnd() % 3000, rnd() % WIRE_MAX_DISPLAYS, rnd() & 1, payload);
+        seeds.push_back(p);
+
+        std::vector<uint8_t> in(WIRE_HEADER_SIZE + WIRE_INPUT_BODY);
+        WireWriteInput(in.data(), 1 + rnd() % 7, rnd() % WIRE_MAX_DISPLAYS, rnd() % 4000, rnd() % 3000, rnd() % 256);
+        seeds.push_back(in);
+
+        std::vector<uint8_t> sub(WIRE_HEADER_SIZE + WIRE_SUBSCRIBE_BODY);
+        bool crop = rnd() & 1;
+        WireWriteSubscribe(sub.data(), (rnd() & 3) ? (int)(rnd() % WIRE_MAX_DISPLAYS) : WIRE_ALL_DISPLAYS,
+                           crop ? rnd() % 2000 : 0, crop ? rnd() % 2000 : 0, crop ? 1 + rnd() % 2000 : 0, crop ? 1 + rnd() % 2000 : 0);
+        seeds.push_back(sub);
+
+        static const int rates[] = {8000, 16000, 44100, 48000};
+        int rate = rates[rnd() % 4], audioPayload = 1 + rnd() % 1000;
+        std::vector<uint8_t> au(WIRE_AUDIO_OVERHEAD + audioPayload);
+        WireWriteAudio(au.data(), rnd(), (uint64_t)rnd() << 8, rate, 1 + rnd() % 2, 1 + rnd() % 2, rate / 100, audioPayload);
+        seeds.push_back(au);
+    }
+    return seeds;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+    std::mt19937 rnd(argc > 2 ? atoi(argv[2]) : 1);
+    std::vector<std::vector<uint8_t>> seeds = Seeds(rnd);
+    std::vector<uint8_t> buf;
+    long accepted = 0;
+
+    for (auto &s : seeds)
+    {
+        CHECK(RefFrame(s.data(), (int)s.size()) || RefInput(s.data(), (int)s.size()) || RefSubscribe(s.data(), (int)s.size()) ||
+              RefAudio(s.data(), (int)s.size()));
+    }
+
+    for (long i = 0; i < iterations; i++)
+    {
+        buf = seeds[rnd() % seeds.size()];
+        switch (rnd() % 6)
+        {
+        case 0: // flip bits
+            for (int n = 1 + rnd() % 4; n > 0; n--) buf[rnd() % buf.size()] ^= (uint8_t)(1 << (rnd() % 8));
+            break;
+        case 1: // interesting values into a header/body field
+        {
+            static const uint32_t values[] = {0, 1, 0x7f, 0x80, 0xff, 0xffff, 0x10000, WIRE_MAX_DIM, WIRE_MAX_DIM + 1u,
+                                              WIRE_MAX_FRAME_BYTES, WIRE_MAX_FRAME_BYTES + 1u, 0x7fffffff, 0x80000000, 0xffffffff};
+            size_t at = rnd() % std::min(buf.size(), (size_t)WIRE_FRAME_OVERHEAD);
+            uint32_t v = values[rnd() % (sizeof(values) / sizeof(values[0]))];
+            for (size_t k = 0; k < 4 && at + k < buf.size(); k++) buf[at + k] = (uint8_t)(v >> (8 * k));
+            break;
+        }
+        case 2: // truncate
+            buf.resize(rnd() % (buf.size() + 1));
+            break;
+        case 3: // extend
+            buf.resize(buf.size() + 1 + rnd() % 64, (uint8_t)rnd());
+            break;
+        case 4: // fix up bodyLen after a size change, so deeper checks are reached
+            buf.resize(WIRE_HEADER_SIZE + rnd() % 64 + (buf.size() > WIRE_HEADER_SIZE ? buf.size() - WIRE_HEADER_SIZE : 0));
+            if (buf.size() >= 6) WireStore16(buf.data() + 4, (uint16_t)(buf.size() - WIRE_HEADER_SIZE));
+            break;
+        default: // pure noise
+            buf.resize(rnd() % 128);
+            for (auto &b : buf) b = (uint8_t)rnd();
+            break;
+        }
+        CheckOne(buf.data(), (int)buf.size());
+        WireFrameChunk f;
+        WireInput in;
+        WireSubscribe sub;
+        WireAudio au;
+        accepted += WireParse(buf.data(), (int)buf.size(), &f) || WireParse(buf.data(), (int)buf.size(), &in) ||
+                    WireParse(buf.data(), (int)buf.size(), &sub) || WireParse(buf.data(), (int)buf.size(), &au);
+    }
+
+    // Round trip: writers produce exactly what the views read back.
+    for (int i = 0; i < 10000; i++)
+    {
+        std::vector<uint8_t> p(WIRE_FRAME_OVERHEAD + 100);
+        uint32_t id = rnd(), total = 100 + rnd() % 1000, offset = rnd() % (total - 99);
+        int w = 1 + rnd() % WIRE_MAX_DIM, h = 1 + rnd() % WIRE_MAX_DIM, d = rnd() % WIRE_MAX_DISPLAYS;
+        WireWriteFrameChunk(p.data(), id, (uint64_t)id << 20, offset, total, w, h, d, WIRE_FLAG_KEYFRAME, 100);
+        WireFrameChunk f;
+        CHECK(WireParse(p.data(), (int)p.size(), &f));
+        CHECK(f.FrameId() == id && f.Offset() == offset && f.TotalSize() == total && f.Width() == w && f.Height() == h &&
+              f.Display() == d && f.Flags() == WIRE_FLAG_KEYFRAME && f.payloadLen == 100 && f.TimestampUs() == (uint64_t)id << 20);
+
+        std::vector<uint8_t> a(WIRE_AUDIO_OVERHEAD + 50);
+        uint64_t ts = ((uint64_t)rnd() << 32) | rnd();
+        int rate = 8000 + rnd() % 40001, channels = 1 + rnd() % 2, samples = 1 + rnd() % WIRE_MAX_AUDIO_SAMPLES;
+        WireWriteAudio(a.data(), id, ts, rate, AUDIO_CODEC_OPUS, channels, samples, 50);
+        WireAudio au;
+        CHECK(WireParse(a.data(), (int)a.size(), &au));
+        CHECK(au.Seq() == id && au.TimestampUs() == ts && au.SampleRate() == rate && au.Codec() == AUDIO_CODEC_OPUS &&
+              au.Channels() == channels && au.FrameSamples() == samples && au.payloadLen == 50);
+    }
+
+    printf("fuzz_wire: %ld inputs, %ld accepted, no mismatches\n", iterations, accepted);
+    return 0;
+}
+#endif
@@ -2,74 +2,254 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <gdiplus.h>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "common/audio_stream.h"
+#include "common/frame_assembly.h"
+#include "common/relay_session.h"
+#include "common/secure_channel.h"
+#include "common/wire_format.h"
+
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "gdi32.lib")
 #pragma comment(lib, "gdiplus.lib")
+#pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "libcrypto.lib")
 
 using namespace Gdiplus;
 
 #define HOST_PORT 50005
 #define CLIENT_PORT 50006
 #define MAX_PACKET_SIZE 65535
-
+#define SUBSCRIBE_RESEND_MS 2000
+// Through a relay on a thin link: kbit/s the relay may send us, so it drops
+// whole frames for us instead of the link dropping random chunks. 0 = no cap.
+#define RELAY_DOWNLINK_KBPS 0
+// waveOut buffers of one audio frame each: the output latency the jitter
+// buffer adds to the picture's lag when it lines sound up with video.
+#define AUDIO_OUTPUT_BUFFERS 3
+
+// Pre-shared secret. Only used to authenticate the key exchange, never sent.
 std::string deviceKey = "TEST_KEY_123";
 
-#pragma pack(push, 1)
-struct PacketHeader
+// What to ask the host for: one display, all (WIRE_ALL_DISPLAYS), or a crop of one.
+struct Subscription
 {
-    int offset;
-    int dataLen;
-    int totalSize;
-    int width;
-    int height;
+    int display;
+    int x;
+    int y;
+    int w;
+    int h;
 };
-#pragma pack(pop)
 
-struct InputPacket
+// One remote display's stream and where it is drawn in our window.
+struct RemoteDisplay
 {
-    int type;
-    int x;
-    int y;
-    int key;
+    int w = 0, h = 0;
+    // Reassembly of the frame currently arriving
+    std::vector<char> frameBuffer;
+    uint32_t frameId = 0;
+    uint32_t frameTotal = 0;
+    uint32_t frameReceived = 0;
+    ChunkRanges frameRanges; // repeated chunks are not counted twice
+    uint32_t lastFrameId = 0; // last drawn, once `frameDrawn`
+    bool frameDrawn = false;
+    uint64_t frameUs = 0; // host media clock at capture
+    RECT dest{};
 };
 
 // Globals
 HWND hwnd;
-int currentW = 0, currentH = 0;
 SOCKET sock;
 sockaddr_in hostAddrGlobal;
-std::vector<char> frameBuffer;
-std::vector<char> displayBuffer;
+RemoteDisplay displays[WIRE_MAX_DISPLAYS];
+Subscription subscription{0, 0, 0, 0, 0};
+SecureChannel g_channel;
+HandshakeConfirm g_confirm; // re-sent until the host's first datagram opens
+// Host address "relay-ip[:port]/stream": everything goes through a relay
+// (relay/relay.cpp) and hostAddrGlobal is the relay.
+bool g_relayMode = false;
+uint32_t g_relayStream = 0;
+RelayViewerSession g_relay;
+// Filled by the receive loop, drained by AudioPlayback (common/audio_stream.h).
+AudioJitterBuffer g_audio;
 
 // Optimization: Reuse Graphics object logic where possible or keep it simple
 // GDI+ Graphics creation is relatively cheap compared to network, but we'll optimize drawing.
 
+// Streams side by side, each getting a share of the window width
+// proportional to its own width. With one display it simply fills the window.
+void layoutDisplays()
+{
+    int totalW = 0;
+    for (auto &d : displays) totalW += d.w;
+    RECT rect;
+    if (totalW == 0 || !GetClientRect(hwnd, &rect)) return;
+
+    int x = 0;
+    for (auto &d : displays)
+    {
+        int destW = (int)((long long)d.w * rect.right / totalW);
+        SetRect(&d.dest, x, 0, d.w ? x + destW : x, rect.bottom);
+        x += destW;
+    }
+}
+
+bool Connected()
+{
+    return g_relayMode ? g_relay.Ready() : g_channel.Ready();
+}
+
+// `datagram` holds RELAY_UP_HEADER_SIZE + SEAL_SEQ_SIZE spare bytes, the
+// message, then SEAL_TAG_SIZE spare. Through a relay it is sealed under our
+// own session with the host and goes out in an envelope; direct, without.
+void SendToHost(uint8_t *datagram, int plainLen)
+{
+    if (g_relayMode)
+    {
+        int len = g_relay.SealToHost(datagram, plainLen);
+        sendto(sock, (char *)datagram, len, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+    }
+    else
+    {
+        int len = g_channel.Seal(datagram + RELAY_UP_HEADER_SIZE, plainLen);
+        sendto(sock, (char *)datagram + RELAY_UP_HEADER_SIZE, len, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+    }
+}
+
 void SendInputPacket(int type, int x, int y, int key)
 {
-    if (currentW == 0 || currentH == 0) return;
+    if (!Connected()) return;
 
-    InputPacket pkt;
-    pkt.type = type;
-    pkt.x = x;
-    pkt.y = y;
-    pkt.key = key;
+    int display = subscription.display == WIRE_ALL_DISPLAYS ? 0 : subscription.display;
 
-    RECT rect;
-    if (GetClientRect(hwnd, &rect))
+    // Mouse events go to whichever display is drawn under the pointer
+    if (type <= INPUT_RIGHT_UP)
+    {
+        POINT pt{x, y};
+        bool found = false;
+        for (int i = 0; i < WIRE_MAX_DISPLAYS && !found; i++)
+        {
+            RemoteDisplay &d = displays[i];
+            int destW = d.dest.right - d.dest.left;
+            int destH = d.dest.bottom - d.dest.top;
+            if (d.w == 0 || destW <= 0 || destH <= 0 || !PtInRect(&d.dest, pt)) continue;
+            display = i;
+            x = ((x - d.dest.left) * d.w) / destW;
+            y = ((y - d.dest.top) * d.h) / destH;
+            found = true;
+        }
+        if (!found) return;
+    }
+
+    // Called from the UI thread only, so sealing here does not race.
+    uint8_t datagram[RELAY_UP_HEADER_SIZE + SEAL_OVERHEAD + WIRE_HEADER_SIZE + WIRE_INPUT_BODY];
+    int plainLen = WireWriteInput(datagram + RELAY_UP_HEADER_SIZE + SEAL_SEQ_SIZE, type, display, x, y, key);
+    SendToHost(datagram, plainLen);
+}
+
+// Re-sent every SUBSCRIBE_RESEND_MS; it is a single datagram and may be lost.
+void SendSubscription()
+{
+    uint8_t datagram[RELAY_UP_HEADER_SIZE + SEAL_OVERHEAD + WIRE_HEADER_SIZE + WIRE_SUBSCRIBE_BODY];
+    int plainLen = WireWriteSubscribe(datagram + RELAY_UP_HEADER_SIZE + SEAL_SEQ_SIZE, subscription.display,
+                                      subscription.x, subscription.y, subscription.w, subscription.h);
+    SendToHost(datagram, plainLen);
+}
+
+// Relay mode: asks for the stream, and as keep-alive holds our NAT mapping open.
+void SendJoin()
+{
+    uint8_t join[RELAY_UP_HEADER_SIZE];
+    int len = g_relay.WriteJoin(join, RELAY_DOWNLINK_KBPS);
+    sendto(sock, (char *)join, len, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+}
+
+// HELLO -> REPLY -> CONFIRM (see common/secure_channel.h). Re-sends HELLO
+// every second until the host answers, and gives up only when replies keep
+// failing to verify for HANDSHAKE_TIMEOUT_MS. CONFIRM goes out here once;
+// the receive loop repeats it until media opens.
+bool Handshake()
+{
+    HandshakeHello hello;
+    if (!g_channel.BeginClient(deviceKey, &hello)) return false;
+
+    char buffer[1024];
+    sockaddr_in senderAddr;
+    int senderSize = sizeof(senderAddr);
+    DWORD lastHello = 0;
+    DWORD firstRejected = 0;
+    bool rejected = false;
+
+    while (true)
+    {
+        if (GetTickCount() - lastHello > 1000)
+        {
+            sendto(sock, (char *)&hello, sizeof(hello), 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+            lastHello = GetTickCount();
+        }
+
+        int len = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
+        if (len == sizeof(HandshakeReply) && senderAddr.sin_addr.s_addr == hostAddrGlobal.sin_addr.s_addr)
+        {
+            if (g_channel.FinishClient(buffer, len, &g_confirm))
+            {
+                sendto(sock, (char *)&g_confirm, sizeof(g_confirm), 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+                return true;
+            }
+            // Stale or forged: one proves nothing.
+            if (!rejected) firstRejected = GetTickCount();
+            rejected = true;
+            if (GetTickCount() - firstRejected > HANDSHAKE_TIMEOUT_MS)
+            {
+                std::cout << "[ERROR] Host failed authentication (wrong device key?).\n";
+                return false;
+            }
+        }
+    }
+}
+
+// The same handshake with the host, relayed, then the stream key
+// (common/relay_session.h) and JOIN. Starts over every second until the key
+// arrives, e.g. while the host has not published yet. Gives up only when
+// replies arrive and none of them verifies for RELAY_HANDSHAKE_TIMEOUT_MS.
+bool RelayHandshake()
+{
+    uint8_t buffer[2048];
+    uint8_t reply[RELAY_REPLY_MAX];
+    sockaddr_in senderAddr;
+    int senderSize = sizeof(senderAddr);
+    DWORD lastHello = 0;
+    DWORD lastGood = GetTickCount();
+
+    while (!g_relay.Ready())
     {
-        int winW = rect.right - rect.left;
-        int winH = rect.bottom - rect.top;
-        if (winW > 0 && winH > 0)
+        if (GetTickCount() - lastHello > 1000)
+        {
+            int len = g_relay.Begin(deviceKey, g_relayStream, reply);
+            if (len == 0) return false;
+            sendto(sock, (char *)reply, len, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+            lastHello = GetTickCount();
+        }
+
+        int len = recvfrom(sock, (char *)buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
+        if (len <= 0 || senderAddr.sin_addr.s_addr != hostAddrGlobal.sin_addr.s_addr || senderAddr.sin_port != hostAddrGlobal.sin_port) continue;
+        const uint8_t *message;
+        int messageLen;
+        int replyLen = g_relay.Handle(buffer, len, reply, &message, &messageLen);
+        if (replyLen > 0) sendto(sock, (char *)reply, replyLen, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+        if (g_relay.Rejected() == 0) lastGood = GetTickCount();
+        else if (GetTickCount() - lastGood > RELAY_HANDSHAKE_TIMEOUT_MS)
         {
-            pkt.x = (x * currentW) / winW;
-            pkt.y = (y * currentH) / winH;
+            std::cout << "[ERROR] Host failed authentication (wrong device key?).\n";
+            return false;
         }
     }
-    sendto(sock, (char *)&pkt, sizeof(pkt), 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+    SendJoin();
+    return true;
 }
 
 LRESULT CALLBACK WindowProc(HWND h, UINT msg, WPARAM wp, LPARAM lp)
@@ -77,15 +257,16 @@ LRESULT CALLBACK WindowProc(HWND h, UINT msg, WPARAM wp, LPARAM lp)
     switch (msg)
     {
     case WM_DESTROY: PostQuitMessage(0); return 0;
+    case WM_SIZE: layoutDisplays(); break;
     // Mouse input
-    case WM_MOUSEMOVE: SendInputPacket(1, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_LBUTTONDOWN: SendInputPacket(2, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_LBUTTONUP: SendInputPacket(3, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_RBUTTONDOWN: SendInputPacket(4, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_RBUTTONUP: SendInputPacket(5, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_MOUSEMOVE: SendInputPacket(INPUT_MOUSE_MOVE, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_LBUTTONDOWN: SendInputPacket(INPUT_LEFT_DOWN, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_LBUTTONUP: SendInputPacket(INPUT_LEFT_UP, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_RBUTTONDOWN: SendInputPacket(INPUT_RIGHT_DOWN, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_RBUTTONUP: SendInputPacket(INPUT_RIGHT_UP, LOWORD(lp), HIWORD(lp), 0); break;
     // Keyboard input
-    case WM_KEYDOWN: SendInputPacket(6, 0, 0, (int)wp); break;
-    case WM_KEYUP: SendInputPacket(7, 0, 0, (int)wp); break;
+    case WM_KEYDOWN: SendInputPacket(INPUT_KEY_DOWN, 0, 0, (int)wp); break;
+    case WM_KEYUP: SendInputPacket(INPUT_KEY_UP, 0, 0, (int)wp); break;
     }
     return DefWindowProcW(h, msg, wp, lp);
 }
@@ -101,31 +282,28 @@ void initWindow()
     hwnd = CreateWindowW(L"RemoteDisplay", L"Waiting for Stream...", WS_OVERLAPPEDWINDOW | WS_VISIBLE, 100, 100, 1280, 720, NULL, NULL, wc.hInstance, NULL);
 }
 
-void updateWindowSize(int w, int h)
+// w/h come from a validated frame chunk (1..WIRE_MAX_DIM).
+void updateWindowSize(RemoteDisplay &d, int w, int h)
 {
-    if (w <= 0 || h <= 0) return;
-    if (w != currentW || h != currentH)
+    if (w != d.w || h != d.h)
     {
-        currentW = w;
-        currentH = h;
-        try {
-            frameBuffer.resize(w * h * 4);
-            displayBuffer.resize(w * h * 4);
-        } catch (...) { return; }
+        d.w = w;
+        d.h = h;
+        layoutDisplays();
         
         SetWindowTextW(hwnd, L"Remote Stream (High Performance)");
     }
 }
 
-void drawFrame(int dataSize)
+void drawFrame(RemoteDisplay &d, int dataSize)
 {
-    if (currentW == 0 || dataSize <= 0) return;
+    if (d.w == 0 || dataSize <= 0) return;
 
     HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, dataSize);
     if (!hMem) return;
 
     void *pData = GlobalLock(hMem);
-    memcpy(pData, displayBuffer.data(), dataSize);
+    memcpy(pData, d.frameBuffer.data(), dataSize);
     GlobalUnlock(hMem);
 
     IStream *pStream = NULL;
@@ -145,9 +323,7 @@ void drawFrame(int dataSize)
             graphics.SetInterpolationMode(InterpolationModeLowQuality); 
             graphics.SetSmoothingMode(SmoothingModeHighSpeed);
 
-            RECT rect;
-            GetClientRect(hwnd, &rect);
-            graphics.DrawImage(bmp, 0, 0, rect.right, rect.bottom);
+            graphics.DrawImage(bmp, (INT)d.dest.left, (INT)d.dest.top, (INT)(d.dest.right - d.dest.left), (INT)(d.dest.bottom - d.dest.top));
 
             ReleaseDC(hwnd, hdc);
             delete bmp;
@@ -156,11 +332,110 @@ void drawFrame(int dataSize)
     }
 }
 
+// Plays g_audio through waveOut. The device is (re)opened whenever the
+// stream's format changes; one frame per buffer, refilled as each one is done.
+DWORD WINAPI AudioPlayback(LPVOID)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+    HANDLE bufferDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+    HWAVEOUT device = NULL;
+    WAVEHDR headers[AUDIO_OUTPUT_BUFFERS];
+    std::vector<int16_t> buffers[AUDIO_OUTPUT_BUFFERS];
+    int rate = 0, channels = 0, frameSamples = 0;
+
+    while (true)
+    {
+        int r, c, f;
+        if (!g_audio.Format(&r, &c, &f))
+        {
+            Sleep(AUDIO_FRAME_MS);
+            continue;
+        }
+        if (r != rate || c != channels || f != frameSamples)
+        {
+            if (device)
+            {
+                waveOutReset(device);
+                for (int i = 0; i < AUDIO_OUTPUT_BUFFERS; i++) waveOutUnprepareHeader(device, &headers[i], sizeof(WAVEHDR));
+                waveOutClose(device);
+                device = NULL;
+            }
+            rate = r;
+            channels = c;
+            frameSamples = f;
+
+            WAVEFORMATEX format{};
+            format.wFormatTag = WAVE_FORMAT_PCM;
+            format.nChannels = (WORD)c;
+            format.nSamplesPerSec = r;
+            format.wBitsPerSample = 16;
+            format.nBlockAlign = (WORD)(c * 2);
+            format.nAvgBytesPerSec = r * c * 2;
+            if (waveOutOpen(&device, WAVE_MAPPER, &format, (DWORD_PTR)bufferDone, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR)
+            {
+                std::cout << "[ERROR] Cannot open audio output (" << r << " Hz x" << c << ").\n";
+                device = NULL;
+                Sleep(1000);
+                continue;
+            }
+            std::cout << "[INFO] Audio: " << r << " Hz x" << c << ".\n";
+            g_audio.SetOutputLatency((int64_t)AUDIO_OUTPUT_BUFFERS * f * 1000000 / r);
+
+            for (int i = 0; i < AUDIO_OUTPUT_BUFFERS; i++)
+            {
+                buffers[i].assign((size_t)f * c, 0);
+                headers[i] = WAVEHDR{};
+                headers[i].lpData = (LPSTR)buffers[i].data();
+                headers[i].dwBufferLength = (DWORD)(buffers[i].size() * sizeof(int16_t));
+                waveOutPrepareHeader(device, &headers[i], sizeof(WAVEHDR));
+                headers[i].dwFlags |= WHDR_DONE; // free: filled below
+            }
+        }
+        if (!device) continue;
+
+        // Refill every buffer the device has finished with.
+        for (int i = 0; i < AUDIO_OUTPUT_BUFFERS; i++)
+        {
+            if (!(headers[i].dwFlags & WHDR_DONE)) continue;
+            g_audio.Pull(buffers[i].data(), frameSamples, channels);
+            waveOutWrite(device, &headers[i], sizeof(WAVEHDR));
+        }
+        WaitForSingleObject(bufferDone, 2 * AUDIO_FRAME_MS);
+    }
+    return 0;
+}
+
+// "", "N", "all" or "N x y w h" (crop of display N, in its pixels)
+void parseSubscription(const std::string &line)
+{
+    if (line == "all" || line == "ALL")
+    {
+        subscription.display = WIRE_ALL_DISPLAYS;
+        return;
+    }
+    int display = 0, x = 0, y = 0, w = 0, h = 0;
+    int n = sscanf(line.c_str(), "%d %d %d %d %d", &display, &x, &y, &w, &h);
+    if (n >= 1 && display >= 0 && display < WIRE_MAX_DISPLAYS) subscription.display = display;
+    if (n == 5 && x >= 0 && y >= 0 && w > 0 && h > 0 && x + w <= WIRE_MAX_DIM && y + h <= WIRE_MAX_DIM)
+    {
+        subscription.x = x;
+        subscription.y = y;
+        subscription.w = w;
+        subscription.h = h;
+    }
+}
+
 int main()
 {
     std::string targetIP;
-    std::cout << "Enter Host IP: ";
+    std::cout << "Enter Host IP (or relay-ip[:port]/stream): ";
     std::cin >> targetIP;
+    std::cin.ignore(1024, '\n');
+
+    std::string displayChoice;
+    std::cout << "Display (Enter = primary, N, 'all', or 'N x y w h' to crop): ";
+    std::getline(std::cin, displayChoice);
+    parseSubscription(displayChoice);
 
     GdiplusStartupInput gdiplusStartupInput;
     ULONG_PTR gdiplusToken;
@@ -195,16 +470,69 @@ int main()
     hostAddrGlobal.sin_port = htons(HOST_PORT);
     hostAddrGlobal.sin_addr.s_addr = inet_addr(targetIP.c_str());
 
-    sendto(sock, deviceKey.c_str(), deviceKey.size(), 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
-    std::cout << "[INFO] Connected.\n";
+    if (targetIP.find('/') != std::string::npos)
+    {
+        char relayIP[64], stream[64];
+        int relayPort;
+        if (!RelaySplitAddress(targetIP.c_str(), relayIP, sizeof(relayIP), &relayPort, stream, sizeof(stream)))
+        {
+            std::cout << "[ERROR] Bad relay address (relay-ip[:port]/stream).\n";
+            return 1;
+        }
+        g_relayMode = true;
+        g_relayStream = RelayStreamId(stream);
+        hostAddrGlobal.sin_port = htons((u_short)relayPort);
+        hostAddrGlobal.sin_addr.s_addr = inet_addr(relayIP);
+        std::cout << "[INFO] Joining stream '" << stream << "' on relay " << relayIP << ":" << relayPort << "...\n";
+        if (!RelayHandshake()) return 1;
+        std::cout << "[INFO] Joined.\n";
+    }
+    else
+    {
+        if (!Handshake()) return 1;
+        std::cout << "[INFO] Connected ("
+                  << (g_channel.Cipher() == CIPHER_AES_GCM ? "AES-256-GCM" : "ChaCha20-Poly1305") << ").\n";
+    }
+
+    CreateThread(NULL, 0, AudioPlayback, NULL, 0, NULL);
 
-    std::vector<char> recvBuffer(MAX_PACKET_SIZE);
+    std::vector<uint8_t> recvBuffer(MAX_PACKET_SIZE);
     sockaddr_in senderAddr;
     int senderSize = sizeof(senderAddr);
+    DWORD lastSubscribe = 0;
+    DWORD lastMedia = GetTickCount();
+    // Direct: the host streams nothing until our CONFIRM arrives, and it may be lost.
+    bool hostConfirmed = g_relayMode;
+    DWORD lastConfirm = GetTickCount();
 
     MSG msg;
     while (true)
     {
+        if (GetTickCount() - lastSubscribe > SUBSCRIBE_RESEND_MS)
+        {
+            SendSubscription();
+            if (g_relayMode) SendJoin();
+            lastSubscribe = GetTickCount();
+        }
+        if (!hostConfirmed && GetTickCount() - lastConfirm > HANDSHAKE_CONFIRM_RESEND_MS)
+        {
+            sendto(sock, (char *)&g_confirm, sizeof(g_confirm), 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+            lastConfirm = GetTickCount();
+        }
+        // Nothing opens any more: the host restarted under a new stream key.
+        if (g_relayMode && GetTickCount() - lastMedia > RELAY_TIMEOUT_MS)
+        {
+            std::cout << "[INFO] Stream silent, joining again...\n";
+            if (!RelayHandshake()) return 1;
+            lastMedia = GetTickCount();
+            // A restarted host numbers its frames from 0 again.
+            for (RemoteDisplay &d : displays)
+            {
+                d.frameTotal = 0;
+                d.frameDrawn = false;
+            }
+        }
+
         // Process Windows events
         while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
@@ -214,24 +542,66 @@ int main()
         }
 
         // Receive Data
-        int len = recvfrom(sock, recvBuffer.data(), MAX_PACKET_SIZE, 0, (sockaddr *)&senderAddr, &senderSize);
+        int len = recvfrom(sock, (char *)recvBuffer.data(), MAX_PACKET_SIZE, 0, (sockaddr *)&senderAddr, &senderSize);
+        // Decrypt in place; forged, replayed or stray datagrams come back as -1.
+        // Through a relay only its envelope is in the clear; media opens under the stream key.
+        const uint8_t *plain = recvBuffer.data() + SEAL_SEQ_SIZE;
+        if (len > 0 && g_relayMode)
+        {
+            uint8_t reply[RELAY_REPLY_MAX];
+            bool fromRelay = senderAddr.sin_addr.s_addr == hostAddrGlobal.sin_addr.s_addr && senderAddr.sin_port == hostAddrGlobal.sin_port;
+            int replyLen = fromRelay ? g_relay.Handle(recvBuffer.data(), len, reply, &plain, &len) : -1;
+            // The relay forgot us (it restarted, or we were silent): its cookie, answered.
+            if (replyLen > 0) sendto(sock, (char *)reply, replyLen, 0, (sockaddr *)&hostAddrGlobal, sizeof(hostAddrGlobal));
+            if (replyLen != 0) len = -1;
+            else lastMedia = GetTickCount();
+        }
+        else if (len > 0)
+        {
+            len = g_channel.Open(recvBuffer.data(), len);
+            if (len > 0) hostConfirmed = true;
+        }
 
-        if (len > sizeof(PacketHeader))
+        // Validated in place: nothing below is sized from an unchecked field.
+        WireFrameChunk chunk;
+        WireAudio audio;
+        if (len > 0 && WireParse(plain, len, &audio))
         {
-            PacketHeader *header = (PacketHeader *)recvBuffer.data();
-            updateWindowSize(header->width, header->height);
+            g_audio.Insert(audio, LocalMicros());
+        }
+        else if (len > 0 && WireParse(plain, len, &chunk))
+        {
+            if (subscription.display != WIRE_ALL_DISPLAYS && chunk.Display() != subscription.display) continue;
+
+            RemoteDisplay &d = displays[chunk.Display()];
+            updateWindowSize(d, chunk.Width(), chunk.Height());
 
-            if (header->offset + header->dataLen <= frameBuffer.size())
+            // A new frame id starts a new frame; chunks of an older one, or
+            // of anything up to the frame on screen, are stale.
+            if (d.frameDrawn && (int32_t)(chunk.FrameId() - d.lastFrameId) <= 0) continue;
+            if (chunk.FrameId() != d.frameId || d.frameTotal == 0)
             {
-                memcpy(frameBuffer.data() + header->offset,
-                       recvBuffer.data() + sizeof(PacketHeader),
-                       header->dataLen);
+                if (d.frameTotal != 0 && (int32_t)(chunk.FrameId() - d.frameId) < 0) continue;
+                d.frameId = chunk.FrameId();
+                d.frameTotal = chunk.TotalSize();
+                d.frameReceived = 0;
+                d.frameRanges.Clear();
+                d.frameUs = chunk.TimestampUs();
+                if (d.frameBuffer.size() < d.frameTotal) d.frameBuffer.resize(d.frameTotal);
             }
+            if (chunk.TotalSize() != d.frameTotal || !d.frameRanges.Add(chunk.Offset(), chunk.payloadLen)) continue;
+
+            memcpy(d.frameBuffer.data() + chunk.Offset(), chunk.Payload(), chunk.payloadLen);
+            d.frameReceived += chunk.payloadLen;
 
-            if (header->offset + header->dataLen >= header->totalSize)
+            if (d.frameReceived >= d.frameTotal)
             {
-                displayBuffer = frameBuffer;
-                drawFrame(header->totalSize);
+                drawFrame(d, d.frameTotal);
+                d.frameTotal = 0;
+                d.lastFrameId = d.frameId;
+                d.frameDrawn = true;
+                // On screen now: the audio jitter buffer holds sound back to match.
+                g_audio.OnVideoShown(d.frameUs, LocalMicros());
             }
         }
     }
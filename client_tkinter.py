@@ -1,12 +1,27 @@
 import socket
-import struct
 import sys
 import threading
 import tkinter as tk
 import io
+import os
 from tkinter import simpledialog, messagebox
 from PIL import Image, ImageTk
 
+# Native receive/decode core (native/rdc_native.cpp). Falls back to the
+# pure-Python loop below when the library has not been built.
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "native"))
+try:
+    from rdc_native import NativeReceiver
+except (ImportError, OSError):
+    NativeReceiver = None
+
+import wire_format
+
+try:
+    from secure_channel import SecureChannel
+except ImportError:
+    SecureChannel = None  # pure-Python loop needs: pip install cryptography
+
 # Configuration
 HOST_PORT = 50005
 CLIENT_PORT = 50006
@@ -25,9 +40,10 @@ frame_lock = threading.Lock()
 # Socket for sending input (shared)
 client_sock = None
 host_address = None
+channel = None
 
 def udp_listener(host_ip):
-    global current_frame, is_running, client_sock, host_address, HOST_WIDTH, HOST_HEIGHT
+    global current_frame, is_running, client_sock, host_address, channel, HOST_WIDTH, HOST_HEIGHT
     
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     try:
@@ -46,37 +62,48 @@ def udp_listener(host_ip):
     client_sock = sock
     host_address = (host_ip, HOST_PORT)
 
+    # Key exchange (see common/secure_channel.h); the device key is never sent.
+    channel = SecureChannel(DEVICE_KEY)
     try:
-        sock.sendto(DEVICE_KEY.encode(), host_address)
+        sock.sendto(channel.hello, host_address)
     except: pass
 
     frame_buffer = None
+    current_frame_id = None
     current_frame_size = 0
     bytes_received = 0
     
     while is_running:
         try:
             data, addr = sock.recvfrom(MAX_PACKET_SIZE)
-            if len(data) < 20: continue 
+            if not channel.ready:
+                confirm = channel.finish(data)
+                if confirm: sock.sendto(confirm, host_address)
+                continue
+
+            data = channel.open(data)
+            if data is None: continue
 
-            offset, data_len, total_size, width, height = struct.unpack('iiiii', data[:20])
+            # Validated before anything is allocated from it
+            chunk = wire_format.parse_frame_chunk(data)
+            if chunk is None: continue
+            frame_id, offset, total_size, width, height, display, flags, img_data = chunk
+            if display != 0: continue  # primary display only
             HOST_WIDTH, HOST_HEIGHT = width, height
             
-            # --- TEARING FIX ---
-            if offset == 0:
+            # --- TEARING FIX --- a new frame id starts a new frame
+            if frame_id != current_frame_id:
                 frame_buffer = bytearray(total_size)
+                current_frame_id = frame_id
                 current_frame_size = total_size
                 bytes_received = 0
             
             if frame_buffer is None or total_size != current_frame_size:
                 continue
 
-            img_data = data[20:] 
             data_len_actual = len(img_data)
-            
-            if offset + data_len_actual <= current_frame_size:
-                frame_buffer[offset : offset + data_len_actual] = img_data
-                bytes_received += data_len_actual
+            frame_buffer[offset : offset + data_len_actual] = img_data
+            bytes_received += data_len_actual
 
             if bytes_received >= current_frame_size:
                 try:
@@ -92,8 +119,8 @@ def udp_listener(host_ip):
                 except: pass
                     
         except socket.timeout:
-            if client_sock and host_address:
-                sock.sendto(DEVICE_KEY.encode(), host_address)
+            if client_sock and host_address and not channel.ready:
+                sock.sendto(channel.hello, host_address)
         except OSError:
             break
     sock.close()
@@ -119,23 +146,35 @@ class RemoteScreenApp:
         self.root.bind('<KeyPress>', self.on_key_down)
         self.root.bind('<KeyRelease>', self.on_key_up)
 
-        self.thread = threading.Thread(target=udp_listener, args=(host_ip,))
-        self.thread.daemon = True
-        self.thread.start()
+        self.native = None
+        if NativeReceiver:
+            try: self.native = NativeReceiver(host_ip, HOST_PORT, CLIENT_PORT, DEVICE_KEY)
+            except OSError: self.native = None
+
+        if not self.native:
+            if SecureChannel is None:
+                messagebox.showerror("Error", "Build native/ or run: pip install cryptography")
+                return
+            self.thread = threading.Thread(target=udp_listener, args=(host_ip,))
+            self.thread.daemon = True
+            self.thread.start()
         
         # INCREASED REFRESH RATE: 10ms instead of 30ms for ~100FPS potential
         self.update_ui_loop()
 
     def send_input(self, type_id, x, y, key):
-        if not client_sock or not host_address: return
+        if not self.native and (not client_sock or not host_address or not channel or not channel.ready): return
         win_w = self.label.winfo_width()
         win_h = self.label.winfo_height()
         if win_w == 0 or win_h == 0: return
 
         scaled_x = int((x / win_w) * HOST_WIDTH)
         scaled_y = int((y / win_h) * HOST_HEIGHT)
-        packet = struct.pack('iiii', type_id, scaled_x, scaled_y, key)
-        try: client_sock.sendto(packet, host_address)
+        if self.native:
+            self.native.send_input(type_id, scaled_x, scaled_y, key)
+            return
+        packet = wire_format.pack_input(type_id, scaled_x, scaled_y, key)
+        try: client_sock.sendto(channel.seal(packet), host_address)
         except: pass
 
     def on_mouse_move(self, event): self.send_input(1, event.x, event.y, 0)
@@ -156,6 +195,11 @@ class RemoteScreenApp:
     def update_ui_loop(self):
         global current_frame
         img = None
+
+        if self.native:
+            self.update_native_frame()
+            self.root.after(5, self.update_ui_loop)
+            return
         
         with frame_lock:
             if current_frame:
@@ -176,9 +220,32 @@ class RemoteScreenApp:
         # Check for new frames aggressively (every 5ms)
         self.root.after(5, self.update_ui_loop)
 
+    def update_native_frame(self):
+        global HOST_WIDTH, HOST_HEIGHT
+        frame = self.native.acquire(0)
+        if not frame: return
+
+        # frombuffer reads the library's RGBA buffer in place. The resize and
+        # PhotoImage below take their own copy, so release right after.
+        view, width, height, mode = frame
+        HOST_WIDTH, HOST_HEIGHT = width, height
+        img = Image.frombuffer(mode, (width, height), view, "raw", mode, 0, 1)
+
+        win_w = self.root.winfo_width()
+        win_h = self.root.winfo_height()
+        if win_w > 1 and win_h > 1:
+            img = img.resize((win_w, win_h), Image.NEAREST)
+
+        photo = ImageTk.PhotoImage(img)
+        del img, view
+        self.native.release()
+        self.label.config(image=photo, text="")
+        self.label.image = photo
+
     def on_close(self):
         global is_running
         is_running = False
+        if self.native: self.native.close()
         self.root.destroy()
         sys.exit(0)
 
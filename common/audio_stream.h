@@ -0,0 +1,666 @@
+// Audio channel: capture sources, codec, timestamps and the client's jitter
+// buffer. Carried as WIRE_AUDIO messages (common/wire_format.h), one per
+// AUDIO_FRAME_MS frame, sealed like video.
+//
+// Host:   AudioSource::Read() -> AudioTimestamper::Stamp() -> AudioEncoder
+// Client: WireParse<WireAudio> -> AudioJitterBuffer::Insert(), and the audio
+//         device pulls decoded frames with AudioJitterBuffer::Pull().
+//
+// Codec: IMA ADPCM, 4 bits/sample (384 kbit/s at 48 kHz stereo). It has no
+// lookahead, every packet decodes on its own, and there is no library to
+// ship. Opus in 10 ms frames would take a quarter of the bits but adds 2.5 ms
+// of codec delay and a dependency none of the builds carry, and next to
+// the video stream the bits do not matter. The codec id travels in every
+// packet (AUDIO_CODEC_OPUS stays reserved on the wire); a client that cannot
+// decode it plays silence.
+//
+// Portable except for the sources in host.cpp (WASAPI loopback).
+
+#pragma once
+
+#include "media_clock.h"
+#include "wire_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_CHANNELS 2
+#define AUDIO_FRAME_MS 10
+#define AUDIO_MAX_PAYLOAD 4096
+// Capture timestamps further than this from the sample count re-anchor it
+// (source restarted, or a gap in capture).
+#define AUDIO_RESYNC_US 20000
+
+// Jitter buffer
+#define JITTER_SLOTS 64             // frames held at most (640 ms at 10 ms)
+#define JITTER_HISTORY 200          // arrival lags behind the target (2 s of frames)
+#define JITTER_MAX_DELAY_US 200000  // cap for the jitter part of the target
+#define AV_SYNC_MAX_US 250000       // never hold audio back more than this to meet video
+#define JITTER_SHRINK_PULLS 5       // too deep this many pulls in a row: drop one frame
+#define JITTER_GIVE_UP_PULLS 50     // this many pulls with nothing to play: prebuffer again
+
+inline int AudioFrameSamples(int sampleRate)
+{
+    return sampleRate * AUDIO_FRAME_MS / 1000;
+}
+
+// --- Sources ---
+
+// One capture device or file. Frames are AudioFrameSamples(SampleRate())
+// samples per channel, interleaved 16-bit.
+class AudioSource
+{
+public:
+    virtual ~AudioSource() {}
+    virtual int SampleRate() const = 0;
+    virtual int Channels() const = 0;
+    // Blocks until the next frame is captured. false = ended or failed.
+    virtual bool Read(int16_t *pcm) = 0;
+};
+
+// Paces a source in real time. `clockPpm` makes the "sound card" run fast or
+// slow against the system clock, like a real one does (benchmarks only).
+class AudioPacer
+{
+public:
+    AudioPacer(int frameUs, double clockPpm) : m_frameUs(frameUs / (1.0 + clockPpm / 1e6)) {}
+
+    void Wait()
+    {
+        typedef std::chrono::steady_clock Clock;
+        if (!m_started)
+        {
+            m_start = Clock::now();
+            m_started = true;
+        }
+        m_frames++;
+        std::this_thread::sleep_until(m_start + std::chrono::microseconds((int64_t)(m_frames * m_frameUs)));
+    }
+
+private:
+    double m_frameUs;
+    bool m_started = false;
+    uint64_t m_frames = 0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Sine tone. Synthetic source for tests and bench/bench_audio.cpp.
+class ToneSource : public AudioSource
+{
+public:
+    ToneSource(int sampleRate = AUDIO_SAMPLE_RATE, int channels = AUDIO_CHANNELS, double hz = 440.0,
+               bool realtime = true, double clockPpm = 0.0)
+        : m_rate(sampleRate), m_channels(channels), m_hz(hz), m_realtime(realtime),
+          m_pacer(AudioFrameSamples(sampleRate) * 1000000 / sampleRate, clockPpm)
+    {
+    }
+
+    int SampleRate() const override { return m_rate; }
+    int Channels() const override { return m_channels; }
+
+    bool Read(int16_t *pcm) override
+    {
+        if (m_realtime) m_pacer.Wait();
+        int n = AudioFrameSamples(m_rate);
+        for (int i = 0; i < n; i++, m_phase++)
+        {
+            int16_t v = (int16_t)(8000 * sin(2 * 3.14159265358979 * m_hz * m_phase / m_rate));
+            for (int c = 0; c < m_channels; c++) pcm[i * m_channels + c] = v;
+        }
+        return true;
+    }
+
+private:
+    int m_rate, m_channels;
+    double m_hz;
+    bool m_realtime;
+    AudioPacer m_pacer;
+    uint64_t m_phase = 0;
+};
+
+// 16-bit PCM WAV, looped, paced in real time (host.exe --audio-file).
+class WavFileSource : public AudioSource
+{
+public:
+    bool Open(const char *path)
+    {
+        FILE *f = fopen(path, "rb");
+        if (!f) return false;
+        uint8_t riff[12];
+        bool ok = fread(riff, 1, 12, f) == 12 && memcmp(riff, "RIFF", 4) == 0 && memcmp(riff + 8, "WAVE", 4) == 0;
+        int format = 0, bits = 0;
+        while (ok)
+        {
+            uint8_t chunk[8];
+            if (fread(chunk, 1, 8, f) != 8) break;
+            uint32_t size = WireLoad32(chunk + 4);
+            if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+            {
+                uint8_t fmt[16];
+                if (fread(fmt, 1, 16, f) != 16) break;
+                format = WireLoad16(fmt);
+                m_channels = WireLoad16(fmt + 2);
+                m_rate = (int)WireLoad32(fmt + 4);
+                bits = WireLoad16(fmt + 14);
+                fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+            }
+            else if (memcmp(chunk, "data", 4) == 0)
+            {
+                m_samples.resize(size / 2);
+                m_samples.resize(fread(m_samples.data(), 2, m_samples.size(), f));
+                break;
+            }
+            else
+            {
+                fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+            }
+        }
+        fclose(f);
+        int frame = AudioFrameSamples(m_rate) * m_channels;
+        ok = ok && format == 1 && bits == 16 && m_channels >= 1 && m_channels <= 2 && m_rate >= 8000 && m_rate <= 48000 &&
+             (int)m_samples.size() >= frame;
+        if (ok) m_pacer.reset(new AudioPacer(AudioFrameSamples(m_rate) * 1000000 / m_rate, 0.0));
+        return ok;
+    }
+
+    int SampleRate() const override { return m_rate; }
+    int Channels() const override { return m_channels; }
+
+    bool Read(int16_t *pcm) override
+    {
+        m_pacer->Wait();
+        int need = AudioFrameSamples(m_rate) * m_channels;
+        for (int i = 0; i < need; i++)
+        {
+            if (m_pos >= m_samples.size()) m_pos = 0;
+            pcm[i] = m_samples[m_pos++];
+        }
+        return true;
+    }
+
+private:
+    int m_rate = 0, m_channels = 0;
+    std::vector<int16_t> m_samples;
+    size_t m_pos = 0;
+    std::unique_ptr<AudioPacer> m_pacer;
+};
+
+// Down to AUDIO_SAMPLE_RATE for devices that mix above what the wire takes
+// (96 / 192 kHz USB DACs). Box filter: each output sample is the mean of the
+// input span it covers, fractions included, which also keeps most of what
+// would fold back into the audible band. Streaming; channels <= 2.
+class AudioDownsampler
+{
+public:
+    void Open(int inRate, int outRate, int channels)
+    {
+        m_step = (double)inRate / outRate;
+        m_channels = channels;
+        m_filled = 0.0;
+        m_sum[0] = m_sum[1] = 0.0;
+    }
+
+    // Appends what `frames` interleaved input frames make to `out`.
+    void Push(const int16_t *in, int frames, std::vector<int16_t> &out)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            double left = 1.0;
+            while (left > 0.0)
+            {
+                double take = std::min(left, m_step - m_filled);
+                for (int c = 0; c < m_channels; c++) m_sum[c] += take * in[i * m_channels + c];
+                m_filled += take;
+                left -= take;
+                if (m_filled >= m_step - 1e-9)
+                {
+                    for (int c = 0; c < m_channels; c++)
+                    {
+                        out.push_back((int16_t)std::max(-32768.0, std::min(32767.0, std::round(m_sum[c] / m_step))));
+                        m_sum[c] = 0.0;
+                    }
+                    m_filled = 0.0;
+                }
+            }
+        }
+    }
+
+private:
+    double m_step = 1.0, m_filled = 0.0;
+    double m_sum[2] = {0.0, 0.0};
+    int m_channels = 1;
+};
+
+// --- Timestamps ---
+
+// Media timestamps for consecutive frames: the sample count (smooth, no
+// scheduling jitter), slewed onto the media clock so audio cannot drift away
+// from video when the sound card's clock differs from the system clock.
+class AudioTimestamper
+{
+public:
+    AudioTimestamper(int sampleRate, int frameSamples) : m_frameUs((int64_t)frameSamples * 1000000 / sampleRate) {}
+
+    // `nowUs`: media clock when the frame finished capturing.
+    uint64_t Stamp(uint64_t nowUs)
+    {
+        int64_t first = (int64_t)nowUs - m_frameUs;
+        int64_t error = first - m_nextUs;
+        if (!m_started || error > AUDIO_RESYNC_US || error < -AUDIO_RESYNC_US)
+        {
+            m_nextUs = first;
+            m_started = true;
+        }
+        else
+        {
+            m_nextUs += error / 64;
+        }
+        uint64_t ts = (uint64_t)std::max<int64_t>(0, m_nextUs);
+        m_nextUs += m_frameUs;
+        return ts;
+    }
+
+private:
+    int64_t m_frameUs;
+    int64_t m_nextUs = 0;
+    bool m_started = false;
+};
+
+// --- Codec ---
+
+// IMA ADPCM. Packet: per channel { s16 predictor, u8 step index, u8 0 },
+// then 4-bit codes for the interleaved samples, low nibble first.
+static const int16_t kAdpcmSteps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060,
+    1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+static const int8_t kAdpcmIndex[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+struct AdpcmState
+{
+    int predictor = 0;
+    int index = 0;
+};
+
+inline int AdpcmStep(AdpcmState &s, int code)
+{
+    int step = kAdpcmSteps[s.index];
+    int delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+    s.predictor = std::min(32767, std::max(-32768, s.predictor + ((code & 8) ? -delta : delta)));
+    s.index = std::min(88, std::max(0, s.index + kAdpcmIndex[code]));
+    return s.predictor;
+}
+
+inline int AdpcmPacketSize(int frameSamples, int channels)
+{
+    return 4 * channels + (frameSamples * channels + 1) / 2;
+}
+
+inline int AdpcmEncode(AdpcmState *state, const int16_t *pcm, int frameSamples, int channels, uint8_t *out, int maxOut)
+{
+    int size = AdpcmPacketSize(frameSamples, channels);
+    if (size > maxOut) return -1;
+    for (int c = 0; c < channels; c++)
+    {
+        WireStore16(out + 4 * c, (uint16_t)(int16_t)state[c].predictor);
+        out[4 * c + 2] = (uint8_t)state[c].index;
+        out[4 * c + 3] = 0;
+    }
+    uint8_t *codes = out + 4 * channels;
+    memset(codes, 0, size - 4 * channels);
+    for (int i = 0; i < frameSamples * channels; i++)
+    {
+        AdpcmState &s = state[i % channels];
+        int diff = pcm[i] - s.predictor;
+        int code = diff < 0 ? 8 : 0;
+        diff = abs(diff);
+        int step = kAdpcmSteps[s.index];
+        // Same rounding as the decoder: pick bits from the largest down.
+        if (diff >= step) { code |= 4; diff -= step; }
+        if (diff >= step >> 1) { code |= 2; diff -= step >> 1; }
+        if (diff >= step >> 2) code |= 1;
+        AdpcmStep(s, code);
+        codes[i >> 1] |= (uint8_t)(code << ((i & 1) * 4));
+    }
+    return size;
+}
+
+inline int AdpcmDecode(const uint8_t *data, int len, int frameSamples, int channels, int16_t *pcm)
+{
+    if (len != AdpcmPacketSize(frameSamples, channels)) return -1;
+    AdpcmState state[2];
+    for (int c = 0; c < channels; c++)
+    {
+        state[c].predictor = (int16_t)WireLoad16(data + 4 * c);
+        state[c].index = data[4 * c + 2];
+        if (state[c].index > 88) return -1;
+    }
+    const uint8_t *codes = data + 4 * channels;
+    for (int i = 0; i < frameSamples * channels; i++)
+    {
+        pcm[i] = (int16_t)AdpcmStep(state[i % channels], (codes[i >> 1] >> ((i & 1) * 4)) & 15);
+    }
+    return frameSamples;
+}
+
+class AudioEncoder
+{
+public:
+    bool Open(int sampleRate, int channels)
+    {
+        m_channels = channels;
+        m_frameSamples = AudioFrameSamples(sampleRate);
+        m_adpcm[0] = m_adpcm[1] = AdpcmState();
+        return channels >= 1 && channels <= 2 && m_frameSamples > 0 && m_frameSamples <= WIRE_MAX_AUDIO_SAMPLES;
+    }
+
+    int Codec() const { return AUDIO_CODEC_ADPCM; }
+    int FrameSamples() const { return m_frameSamples; }
+    int PacketSize() const { return AdpcmPacketSize(m_frameSamples, m_channels); }
+
+    // One frame in, payload bytes out (< 0 on error).
+    int Encode(const int16_t *pcm, uint8_t *out, int maxOut)
+    {
+        return AdpcmEncode(m_adpcm, pcm, m_frameSamples, m_channels, out, maxOut);
+    }
+
+private:
+    int m_channels = 0, m_frameSamples = 0;
+    AdpcmState m_adpcm[2];
+};
+
+class AudioDecoder
+{
+public:
+    // false for a codec this build does not decode.
+    bool Open(int codec, int channels, int frameSamples)
+    {
+        m_codec = codec;
+        m_channels = channels;
+        m_frameSamples = frameSamples;
+        m_last.assign((size_t)frameSamples * channels, 0);
+        return codec == AUDIO_CODEC_ADPCM;
+    }
+
+    // Returns false for a packet that does not decode (conceal instead).
+    bool Decode(const uint8_t *data, int len, int16_t *pcm)
+    {
+        if (m_codec != AUDIO_CODEC_ADPCM || AdpcmDecode(data, len, m_frameSamples, m_channels, pcm) != m_frameSamples) return false;
+        memcpy(m_last.data(), pcm, m_last.size() * 2);
+        return true;
+    }
+
+    // A frame for a lost or late packet: the last frame again, at half the
+    // level each time.
+    void Conceal(int16_t *pcm)
+    {
+        for (size_t i = 0; i < m_last.size(); i++) pcm[i] = m_last[i] = (int16_t)(m_last[i] / 2);
+    }
+
+private:
+    int m_codec = 0, m_channels = 0, m_frameSamples = 0;
+    std::vector<int16_t> m_last;
+};
+
+// --- Client jitter buffer ---
+
+struct AudioJitterStats
+{
+    uint64_t received = 0;
+    uint64_t played = 0;
+    uint64_t lost = 0;      // concealed: never arrived in time
+    uint64_t underruns = 0; // concealed: buffer ran dry, playout stretched a frame
+    uint64_t late = 0;      // arrived after its slot was played
+    uint64_t dropped = 0;   // skipped to shrink the buffer
+    int depthUs = 0;
+    int targetUs = 0;
+    int jitterUs = 0; // 95th percentile arrival lag
+    int syncUs = 0;   // extra delay to line up with video
+    double driftPpm = 0.0;
+};
+
+// Reorders and delays audio frames by just enough to ride out the measured
+// jitter (95th percentile of arrival lag over the last 2 s), or more if video
+// is running later than that, so sound lines up with the picture without
+// holding video back. Depth is corrected a frame at a time: a dry buffer
+// stretches playout by one concealed frame, a buffer that stays too deep
+// drops one, which also absorbs drift between the two sound cards.
+//
+// Insert() and OnVideoShown() from the receive thread, Pull() from the audio
+// device thread.
+class AudioJitterBuffer
+{
+public:
+    void Insert(const WireAudio &pkt, int64_t localUs)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stats.received++;
+
+        if (pkt.Codec() != m_codec || pkt.SampleRate() != m_rate || pkt.Channels() != m_channels ||
+            pkt.FrameSamples() != m_frameSamples)
+        {
+            m_codec = pkt.Codec();
+            m_rate = pkt.SampleRate();
+            m_channels = pkt.Channels();
+            m_frameSamples = pkt.FrameSamples();
+            m_frameUs = (int64_t)m_frameSamples * 1000000 / m_rate;
+            m_decoderOk = m_decoder.Open(m_codec, m_channels, m_frameSamples);
+            Restart();
+        }
+        if (pkt.payloadLen > AUDIO_MAX_PAYLOAD) return;
+
+        m_clock.OnPacket(pkt.TimestampUs(), localUs);
+        m_lags[m_lagCount++ % JITTER_HISTORY] = (int)std::min<int64_t>(m_clock.LagUs(pkt.TimestampUs(), localUs), INT32_MAX);
+        UpdateTarget();
+
+        uint32_t seq = pkt.Seq();
+        if (m_hasPackets)
+        {
+            int32_t ahead = (int32_t)(seq - m_nextSeq);
+            if (ahead < 0 && m_playing)
+            {
+                m_stats.late++;
+                return;
+            }
+            if (ahead >= JITTER_SLOTS || ahead <= -JITTER_SLOTS) Restart(); // sender restarted or long outage
+        }
+        if (!m_hasPackets)
+        {
+            m_hasPackets = true;
+            m_nextSeq = m_newestSeq = seq;
+        }
+        else if (!m_playing && (int32_t)(seq - m_nextSeq) < 0)
+        {
+            m_nextSeq = seq; // reordered while prebuffering
+        }
+        if ((int32_t)(seq - m_newestSeq) > 0) m_newestSeq = seq;
+
+        Slot &slot = m_slots[seq % JITTER_SLOTS];
+        slot.used = true;
+        slot.seq = seq;
+        slot.timestampUs = pkt.TimestampUs();
+        slot.len = pkt.payloadLen;
+        memcpy(slot.data, pkt.Payload(), pkt.payloadLen);
+    }
+
+    // A video frame stamped `mediaUs` was put on screen at `localUs`.
+    void OnVideoShown(uint64_t mediaUs, int64_t localUs)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_clock.Valid()) return;
+        int64_t lag = m_clock.LagUs(mediaUs, localUs);
+        m_videoLagUs = m_videoSeen ? m_videoLagUs + (lag - m_videoLagUs) / 16 : lag;
+        m_videoSeen = true;
+        UpdateTarget();
+    }
+
+    // Latency of the audio device after Pull() (its queued buffers).
+    void SetOutputLatency(int64_t us)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_outputLatencyUs = us;
+        UpdateTarget();
+    }
+
+    // Format of the stream, once a packet arrived.
+    bool Format(int *sampleRate, int *channels, int *frameSamples) const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_decoderOk) return false;
+        *sampleRate = m_rate;
+        *channels = m_channels;
+        *frameSamples = m_frameSamples;
+        return true;
+    }
+
+    // Next frame for the device, in the format it was opened with (Format()).
+    // Silence (returns false) while prebuffering, without a stream, or if the
+    // stream's format has changed since. `mediaUs` gets the played frame's
+    // timestamp, 0 for silence and concealment.
+    bool Pull(int16_t *pcm, int frameSamples, int channels, uint64_t *mediaUs = NULL)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        size_t samples = (size_t)frameSamples * channels;
+        if (mediaUs) *mediaUs = 0;
+        if (frameSamples != m_frameSamples || channels != m_channels)
+        {
+            memset(pcm, 0, samples * 2);
+            return false;
+        }
+        int depth = m_hasPackets ? (int32_t)(m_newestSeq - m_nextSeq) + 1 : 0;
+        m_stats.depthUs = (int)(std::max(0, depth) * m_frameUs);
+
+        if (!m_playing)
+        {
+            if (!m_decoderOk || !m_hasPackets || m_stats.depthUs < m_targetUs)
+            {
+                memset(pcm, 0, samples * 2);
+                return false;
+            }
+            m_playing = true;
+            m_dryPulls = 0;
+        }
+
+        // OPTIMIZATION: shrink only when depth stayed high for a while, so a
+        // burst after one late packet does not cost a dropped frame.
+        m_deepPulls = m_stats.depthUs > m_targetUs + 2 * m_frameUs ? m_deepPulls + 1 : 0;
+        if (m_deepPulls >= JITTER_SHRINK_PULLS && depth > 1)
+        {
+            m_slots[m_nextSeq % JITTER_SLOTS].used = false;
+            m_nextSeq++;
+            m_stats.dropped++;
+            m_deepPulls = 0;
+        }
+
+        Slot &slot = m_slots[m_nextSeq % JITTER_SLOTS];
+        if (slot.used && slot.seq == m_nextSeq)
+        {
+            slot.used = false;
+            m_nextSeq++;
+            m_dryPulls = 0;
+            if (m_decoder.Decode(slot.data, slot.len, pcm))
+            {
+                m_stats.played++;
+                if (mediaUs) *mediaUs = slot.timestampUs;
+                return true;
+            }
+            m_decoder.Conceal(pcm);
+            m_stats.lost++;
+            return true;
+        }
+
+        m_decoder.Conceal(pcm);
+        if ((int32_t)(m_newestSeq - m_nextSeq) > 0)
+        {
+            // Later frames are here, this one is not: lost.
+            m_nextSeq++;
+            m_stats.lost++;
+        }
+        else
+        {
+            // Nothing buffered: hold the position, the frame may still come.
+            m_stats.underruns++;
+            if (++m_dryPulls >= JITTER_GIVE_UP_PULLS) Restart();
+        }
+        return true;
+    }
+
+    AudioJitterStats Stats() const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        AudioJitterStats s = m_stats;
+        s.targetUs = m_targetUs;
+        s.jitterUs = m_jitterUs;
+        s.syncUs = m_syncUs;
+        s.driftPpm = m_clock.DriftPpm();
+        return s;
+    }
+
+private:
+    struct Slot
+    {
+        bool used;
+        uint32_t seq;
+        uint64_t timestampUs;
+        int len;
+        uint8_t data[AUDIO_MAX_PAYLOAD];
+    };
+
+    void Restart()
+    {
+        for (Slot &s : m_slots) s.used = false;
+        m_hasPackets = false;
+        m_playing = false;
+        m_deepPulls = m_dryPulls = 0;
+    }
+
+    void UpdateTarget()
+    {
+        int n = (int)std::min<uint64_t>(m_lagCount, JITTER_HISTORY);
+        if (n > 0)
+        {
+            int sorted[JITTER_HISTORY];
+            std::copy(m_lags, m_lags + n, sorted);
+            std::nth_element(sorted, sorted + n * 95 / 100, sorted + n);
+            m_jitterUs = std::max(0, sorted[n * 95 / 100]);
+        }
+        int64_t jitterTarget = std::min<int64_t>(m_jitterUs, JITTER_MAX_DELAY_US) + m_frameUs;
+        m_syncUs = m_videoSeen ? (int)std::max<int64_t>(0, std::min<int64_t>(m_videoLagUs - m_outputLatencyUs, AV_SYNC_MAX_US)) : 0;
+        int64_t target = std::max<int64_t>(jitterTarget, m_syncUs);
+        m_targetUs = (int)std::min<int64_t>(target, (JITTER_SLOTS - 2) * m_frameUs);
+    }
+
+    mutable std::mutex m_lock;
+    Slot m_slots[JITTER_SLOTS] = {};
+    AudioDecoder m_decoder;
+    bool m_decoderOk = false;
+    int m_codec = 0, m_rate = 0, m_channels = 0, m_frameSamples = 0;
+    int64_t m_frameUs = 10000;
+
+    bool m_hasPackets = false, m_playing = false;
+    uint32_t m_nextSeq = 0, m_newestSeq = 0;
+    int m_deepPulls = 0, m_dryPulls = 0;
+
+    MediaClockSync m_clock;
+    int m_lags[JITTER_HISTORY] = {};
+    uint64_t m_lagCount = 0; // packets ever seen: never wraps, m_lags is its last JITTER_HISTORY
+    int m_jitterUs = 0, m_targetUs = 0, m_syncUs = 0;
+    int64_t m_videoLagUs = 0, m_outputLatencyUs = 0;
+    bool m_videoSeen = false;
+
+    AudioJitterStats m_stats;
+};
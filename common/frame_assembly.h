@@ -0,0 +1,45 @@
+// Which bytes of the frame being reassembled have arrived.
+//
+// Reassembly (client.cpp, native/rdc_native.cpp, common/recv_engine.h)
+// counts received bytes up to the frame's total. Counting alone delivers a
+// frame with holes when a chunk arrives twice (a duplicated or replayed
+// datagram, with nothing sealed to reject it), and the holes hold whatever
+// an earlier frame left there. ChunkRanges takes each chunk's byte range
+// once: a chunk overlapping anything already received is refused, so the
+// count only reaches the total when every byte is in.
+//
+// Portable, no allocation past the first frames: ranges are kept sorted
+// and chunks nearly always arrive in order, appending at the end.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class ChunkRanges
+{
+public:
+    // A new frame.
+    void Clear() { m_ranges.clear(); }
+
+    // False if [offset, offset + len) overlaps a range already taken.
+    bool Add(uint32_t offset, uint32_t len)
+    {
+        uint32_t end = offset + len;
+        auto it = m_ranges.end();
+        if (!m_ranges.empty() && m_ranges.back().first > offset)
+        {
+            it = std::lower_bound(m_ranges.begin(), m_ranges.end(), offset,
+                                  [](const Range &r, uint32_t o) { return r.first < o; });
+            if (it != m_ranges.end() && it->first < end) return false;
+        }
+        if (it != m_ranges.begin() && (it - 1)->second > offset) return false;
+        m_ranges.insert(it, Range(offset, end));
+        return true;
+    }
+
+private:
+    typedef std::pair<uint32_t, uint32_t> Range; // [first, second)
+    std::vector<Range> m_ranges;
+};
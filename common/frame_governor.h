@@ -0,0 +1,81 @@
+// Idle-aware frame-rate governor for the display workers (common/stream_scheduler.h).
+//
+// A worker captures at maxFps while its display changes. Once nothing has
+// changed and no input arrived for idleAfterMs it is "idle": it only polls
+// every reactionMs, checks the poll with a SampledChecksum instead of the full
+// DirtyTracker, and sends nothing but the minFps keep-alive frames.
+//
+// Any change seen by a poll, and any input from the client
+// (InputListener -> StreamScheduler::NotifyInput), puts it straight back at
+// maxFps. Input also wakes the worker immediately, so the first frame after a
+// click or key press is not held back by the poll interval. reactionMs is the
+// latency-to-first-frame target for changes nobody typed (a video starting,
+// a notification): they are seen at the next poll.
+//
+// Timing policy only: no threads, no pixels.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// Keep-alive period for unchanged displays (= 1 / default minFps), so a
+// client that just subscribed or lost a packet gets a full picture.
+#define REFRESH_INTERVAL_MS 1000
+
+struct GovernorConfig
+{
+    int maxFps = 60;
+    int minFps = 1000 / REFRESH_INTERVAL_MS; // keep-alive frames/s while unchanged
+    int reactionMs = 100;                     // idle poll interval; <= 1000/maxFps disables idling
+    int idleAfterMs = 500;                    // full rate this long after the last change or input
+};
+
+class FrameGovernor
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit FrameGovernor(const GovernorConfig &config = GovernorConfig())
+    {
+        Configure(config);
+    }
+
+    void Configure(const GovernorConfig &config)
+    {
+        m_config = config;
+        int maxFps = std::max(1, config.maxFps);
+        int minFps = std::max(1, std::min(config.minFps, maxFps));
+        m_active = std::chrono::microseconds(1000000 / maxFps);
+        m_keepAlive = std::chrono::microseconds(1000000 / minFps);
+        // Never poll faster than maxFps, never slower than the keep-alive.
+        m_poll = std::min<Clock::duration>(std::max<Clock::duration>(std::chrono::milliseconds(config.reactionMs), m_active), m_keepAlive);
+        m_idleAfter = std::chrono::milliseconds(std::max(0, config.idleAfterMs));
+        m_lastActivity = Clock::now();
+    }
+
+    const GovernorConfig &Config() const { return m_config; }
+
+    // A change on screen or input from the client: back to maxFps.
+    void NoteActivity(Clock::time_point now) { m_lastActivity = now; }
+
+    bool Idle(Clock::time_point now) const
+    {
+        return m_poll > m_active && now - m_lastActivity >= m_idleAfter;
+    }
+
+    // Time from one capture to the next.
+    Clock::duration Interval(Clock::time_point now) const { return Idle(now) ? m_poll : m_active; }
+    // The shortest of them (1 / maxFps): no wake-up captures sooner than this.
+    Clock::duration ActiveInterval() const { return m_active; }
+
+    bool KeepAliveDue(Clock::time_point now, Clock::time_point lastSent) const
+    {
+        return now - lastSent >= m_keepAlive;
+    }
+
+private:
+    GovernorConfig m_config;
+    Clock::duration m_active, m_poll, m_keepAlive, m_idleAfter;
+    Clock::time_point m_lastActivity;
+};
@@ -0,0 +1,115 @@
+// One media clock for audio and video (timestampUs in WIRE_FRAME / WIRE_AUDIO).
+//
+// The host stamps every captured video frame and every audio frame with
+// MediaClock::NowUs(), so on the client both streams sit on one timeline.
+// MediaClockSync maps that timeline onto the client's own clock:
+//
+//   transit = local arrival - media timestamp
+//
+// Its running minimum is the path with no queueing (clock offset + base
+// network delay). What a packet spends above that minimum is jitter; how far
+// a shown video frame is above it is the video's lag, which the audio jitter
+// buffer matches (AudioJitterBuffer::OnVideoShown) instead of delaying video.
+//
+// The minimum is kept over two alternating windows, so it follows clock drift
+// and route changes instead of sticking to one lucky packet forever, and the
+// window minima give the drift between host and client clocks.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#define CLOCK_SYNC_WINDOW_US 2000000 // 2 s
+#define CLOCK_SYNC_HISTORY 16        // window minima kept for the drift fit
+
+// Monotonic local time, microseconds.
+inline int64_t LocalMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Host side: microseconds since the session started.
+class MediaClock
+{
+public:
+    MediaClock() { Reset(); }
+    void Reset() { m_start = LocalMicros(); }
+    uint64_t NowUs() const { return (uint64_t)(LocalMicros() - m_start); }
+
+private:
+    int64_t m_start;
+};
+
+// Client side. Not thread-safe; the owner serialises access.
+class MediaClockSync
+{
+public:
+    void OnPacket(uint64_t mediaUs, int64_t localUs)
+    {
+        int64_t transit = localUs - (int64_t)mediaUs;
+        if (!m_valid)
+        {
+            m_valid = true;
+            m_windowStart = localUs;
+            m_curMin = m_oldMin = transit;
+            return;
+        }
+        if (localUs - m_windowStart >= CLOCK_SYNC_WINDOW_US)
+        {
+            // The finished window's minimum goes into the drift fit.
+            m_historyT[m_historyCount % CLOCK_SYNC_HISTORY] = m_windowStart;
+            m_historyMin[m_historyCount % CLOCK_SYNC_HISTORY] = m_curMin;
+            m_historyCount++;
+            m_oldMin = m_curMin;
+            m_curMin = transit;
+            m_windowStart = localUs;
+        }
+        else if (transit < m_curMin)
+        {
+            m_curMin = transit;
+        }
+    }
+
+    bool Valid() const { return m_valid; }
+
+    // Minimum transit over the last one to two windows.
+    int64_t BaseTransit() const { return m_curMin < m_oldMin ? m_curMin : m_oldMin; }
+
+    // Earliest local time something stamped `mediaUs` can be here.
+    int64_t ToLocal(uint64_t mediaUs) const { return (int64_t)mediaUs + BaseTransit(); }
+
+    // How much later than that `localUs` is (>= 0 up to drift within a window).
+    int64_t LagUs(uint64_t mediaUs, int64_t localUs) const { return localUs - ToLocal(mediaUs); }
+
+    // Slope of the window minima: how much faster our clock runs than the
+    // host's, in parts per million. 0 until there are 4 windows. Median of the
+    // pairwise slopes, so one window spoilt by a stall does not skew it.
+    double DriftPpm() const
+    {
+        int n = m_historyCount < CLOCK_SYNC_HISTORY ? m_historyCount : CLOCK_SYNC_HISTORY;
+        if (n < 4) return 0.0;
+        double slopes[CLOCK_SYNC_HISTORY * (CLOCK_SYNC_HISTORY - 1) / 2];
+        int count = 0;
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                int64_t dt = m_historyT[j] - m_historyT[i];
+                if (dt != 0) slopes[count++] = (double)(m_historyMin[j] - m_historyMin[i]) * 1e6 / dt; // us per s == ppm
+            }
+        }
+        if (count == 0) return 0.0;
+        std::nth_element(slopes, slopes + count / 2, slopes + count);
+        return slopes[count / 2];
+    }
+
+private:
+    bool m_valid = false;
+    int64_t m_windowStart = 0;
+    int64_t m_curMin = 0, m_oldMin = 0;
+    int64_t m_historyT[CLOCK_SYNC_HISTORY] = {};
+    int64_t m_historyMin[CLOCK_SYNC_HISTORY] = {};
+    int m_historyCount = 0;
+};
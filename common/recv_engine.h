@@ -0,0 +1,450 @@
+// Receive-side scaling for many concurrent streams (relay fan-in, several
+// hosts or displays at once). Linux only.
+//
+// One thread calling recvfrom() per datagram, like client.cpp, tops out at
+// one core. RecvEngine binds `workers` UDP sockets to one port with
+// SO_REUSEPORT and gives each its own worker thread, pinned to its own core,
+// draining it with recvmmsg() RECV_BATCH datagrams at a time.
+//
+// Steering (which socket a datagram goes to):
+//
+//   RECV_STEER_FLOW  the kernel's flow hash of source address and port
+//                    (default). Every datagram of one sender reaches the
+//                    same worker, whatever CPU it arrived on.
+//   RECV_STEER_CPU   a classic BPF program returns the CPU that received the
+//                    packet, so the worker pinned to that core takes it and
+//                    the data stays in the cache the softirq just warmed.
+//                    Only correct when each flow sticks to one CPU (NIC RSS
+//                    or RPS); a flow spread over CPUs gets its frames split
+//                    between workers and they never complete.
+//
+// Streams are keyed by sender address, port and display (RecvStreamKey).
+// Since a flow always lands on one worker, each worker owns the reassembly
+// state of its streams outright: a plain hash map per worker, no locks and
+// no shared cache lines on the hot path. Stats are published once per batch.
+//
+// Reassembly memory follows what actually arrived, not what a header
+// claims: a stream exists only once a chunk passed Open() and WireParse(),
+// its buffer grows with the chunks received (never to TotalSize() up
+// front), a worker holds at most RECV_WORKER_BUFFER_BYTES across all its
+// streams, and streams idle for RECV_IDLE_MS or evicted give theirs back.
+//
+// What a datagram means is up to the RecvHandler: Open() unseals it (one
+// SecureChannel per sender, kept per worker like the reassembly state),
+// OnFrame() gets every complete frame, OnMessage() every other valid message.
+// A handler that only forwards (common/relay_server.h) takes datagrams as
+// they are in OnDatagram() and skips all of that.
+
+#pragma once
+
+#include "frame_assembly.h"
+#include "stream_scheduler.h" // PinCurrentThread, ThreadCpuMicros
+#include "wire_format.h"
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+#define RECV_STEER_FLOW 0
+#define RECV_STEER_CPU 1
+
+#define RECV_BATCH 32                      // datagrams per recvmmsg()
+#define RECV_MAX_DATAGRAM 65536
+#define RECV_SOCKET_BUFFER (8 * 1024 * 1024) // per socket
+#define RECV_MAX_STREAMS 4096              // per worker; the idlest is dropped beyond this
+#define RECV_POLL_MS 100                   // how quickly Stop() is noticed
+#define RECV_IDLE_MS 5000                  // a stream silent this long is dropped
+#define RECV_WORKER_BUFFER_BYTES (256u * 1024 * 1024) // frames being reassembled, per worker
+
+// Sender address, port and display in one integer.
+inline uint64_t RecvStreamKey(const sockaddr_in &from, int display)
+{
+    return ((uint64_t)ntohl(from.sin_addr.s_addr) << 24) | ((uint64_t)ntohs(from.sin_port) << 8) | (uint8_t)display;
+}
+
+// A complete frame. `data` is only valid during RecvHandler::OnFrame().
+struct RecvFrame
+{
+    uint64_t stream; // RecvStreamKey
+    sockaddr_in from;
+    int display;
+    uint32_t frameId;
+    int width, height, flags;
+    uint64_t timestampUs;
+    const uint8_t *data;
+    int size;
+};
+
+// Called on the worker threads; a given sender is always on the same one.
+class RecvHandler
+{
+public:
+    virtual ~RecvHandler() {}
+
+    // Sees every datagram first. Return true to take it as it is (the
+    // engine does nothing more with it), false to Open() and parse it.
+    virtual bool OnDatagram(int worker, const sockaddr_in &from, const uint8_t *datagram, int len)
+    {
+        (void)worker;
+        (void)from;
+        (void)datagram;
+        (void)len;
+        return false;
+    }
+
+    // After each recvmmsg() batch: flush whatever was gathered per datagram.
+    virtual void OnBatch(int worker) { (void)worker; }
+
+    // Unseals `datagram` in place. Returns the message length and points
+    // *message at it, or -1 to drop the datagram. Only what passes here
+    // gets reassembly state. Default: not sealed, every sender passes (a
+    // trusted network or a bench), bounded by RECV_WORKER_BUFFER_BYTES.
+    virtual int Open(int worker, const sockaddr_in &from, uint8_t *datagram, int len, const uint8_t **message)
+    {
+        (void)worker;
+        (void)from;
+        *message = datagram;
+        return len;
+    }
+
+    virtual void OnFrame(int worker, const RecvFrame &frame) = 0;
+
+    // Any other message that passed WireType(): input, subscribe, audio.
+    virtual void OnMessage(int worker, const sockaddr_in &from, const uint8_t *message, int len)
+    {
+        (void)worker;
+        (void)from;
+        (void)message;
+        (void)len;
+    }
+};
+
+// Written by one worker, once per batch; read by anyone.
+struct alignas(64) RecvStats
+{
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frames{0};     // complete frames delivered
+    std::atomic<uint64_t> incomplete{0}; // frames abandoned for a newer one
+    std::atomic<uint64_t> rejected{0};   // failed Open() or validation
+    std::atomic<uint64_t> batches{0};    // recvmmsg() calls that returned data
+    std::atomic<uint64_t> cpuUs{0};
+    int core = -1;
+};
+
+class RecvEngine
+{
+public:
+    ~RecvEngine() { Close(); }
+
+    // Binds `workers` sockets to `port` (0 = a free port, see Port()).
+    // RECV_STEER_CPU falls back to RECV_STEER_FLOW if the kernel refuses the
+    // program (see Steering()). `batch` 1 behaves like plain recvfrom().
+    bool Open(int port, int workers, int steer = RECV_STEER_FLOW, int batch = RECV_BATCH)
+    {
+        Close();
+        m_batch = std::max(1, std::min(batch, RECV_BATCH));
+        m_steer = RECV_STEER_FLOW;
+        for (int i = 0; i < workers; i++)
+        {
+            int fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (fd < 0)
+            {
+                Close();
+                return false;
+            }
+            int one = 1, buffer = RECV_SOCKET_BUFFER;
+            timeval tv{0, RECV_POLL_MS * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = INADDR_ANY;
+            addr.sin_port = htons((uint16_t)port);
+            if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+            {
+                close(fd);
+                Close();
+                return false;
+            }
+            // Port 0: the first bind picks it, the rest join that group.
+            socklen_t len = sizeof(addr);
+            getsockname(fd, (sockaddr *)&addr, &len);
+            port = ntohs(addr.sin_port);
+
+            std::unique_ptr<Worker> w(new Worker());
+            w->fd = fd;
+            m_workers.push_back(std::move(w));
+        }
+        m_port = port;
+
+        if (steer == RECV_STEER_CPU && !m_workers.empty())
+        {
+            // A = cpu % workers; return A. The group index is bind order, and
+            // worker i is pinned to core i (Start with firstCore 0).
+            sock_filter code[] = {
+                {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)},
+                {BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)m_workers.size()},
+                {BPF_RET | BPF_A, 0, 0, 0},
+            };
+            sock_fprog prog{(unsigned short)(sizeof(code) / sizeof(code[0])), code};
+            if (setsockopt(m_workers[0]->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == 0) m_steer = RECV_STEER_CPU;
+        }
+        return true;
+    }
+
+    // One pinned worker per socket: worker i on core (i + firstCore) % cores.
+    void Start(RecvHandler *handler, bool pin = true, int firstCore = 0)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        m_handler = handler;
+        m_running = true;
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            int core = pin ? (int)((i + firstCore) % cores) : -1;
+            m_workers[i]->thread = std::thread(&RecvEngine::Run, this, (int)i, core);
+        }
+    }
+
+    void Stop()
+    {
+        m_running = false;
+        for (auto &w : m_workers)
+        {
+            if (w->thread.joinable()) w->thread.join();
+        }
+    }
+
+    void Close()
+    {
+        Stop();
+        for (auto &w : m_workers) close(w->fd);
+        m_workers.clear();
+    }
+
+    int Port() const { return m_port; }
+    int Workers() const { return (int)m_workers.size(); }
+    int Steering() const { return m_steer; }
+    // For replies from the same port (the relay answers on it).
+    int Socket(int worker) const { return m_workers[worker]->fd; }
+    const RecvStats &Stats(int worker) const { return m_workers[worker]->stats; }
+
+private:
+    struct Stream
+    {
+        uint32_t frameId = 0;
+        uint32_t lastId = 0; // last delivered, once `delivered`
+        bool delivered = false;
+        uint32_t total = 0; // 0 = no frame in progress
+        uint32_t received = 0;
+        ChunkRanges ranges;
+        int width = 0, height = 0, flags = 0;
+        uint64_t timestampUs = 0;
+        uint64_t lastMs = 0; // worker clock at the last chunk
+        std::vector<uint8_t> buffer;
+    };
+
+    // Counted locally, published per batch: no locked instruction per packet.
+    struct Counters
+    {
+        uint64_t packets = 0, bytes = 0, frames = 0, incomplete = 0, rejected = 0, batches = 0;
+    };
+
+    struct Worker
+    {
+        int fd = -1;
+        std::thread thread;
+        RecvStats stats;
+        std::unordered_map<uint64_t, Stream> streams; // this worker's only
+        size_t buffered = 0;                          // capacity of all their buffers
+        uint64_t nowMs = 0, lastSweepMs = 0;
+    };
+
+    void Run(int index, int core)
+    {
+        Worker *w = m_workers[index].get();
+        if (core >= 0 && PinCurrentThread(core)) w->stats.core = core;
+        uint64_t cpuStart = ThreadCpuMicros();
+
+        std::vector<uint8_t> arena((size_t)m_batch * RECV_MAX_DATAGRAM);
+        std::vector<mmsghdr> msgs(m_batch);
+        std::vector<iovec> iov(m_batch);
+        std::vector<sockaddr_in> from(m_batch);
+        Counters c;
+
+        while (m_running)
+        {
+            for (int i = 0; i < m_batch; i++)
+            {
+                iov[i].iov_base = &arena[(size_t)i * RECV_MAX_DATAGRAM];
+                iov[i].iov_len = RECV_MAX_DATAGRAM;
+                memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = &from[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            }
+            // Blocks for the first datagram, then takes whatever else is queued.
+            int n = recvmmsg(w->fd, msgs.data(), m_batch, MSG_WAITFORONE, NULL);
+            // One clock read per batch (or per RECV_POLL_MS while quiet).
+            w->nowMs = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+            if (w->nowMs - w->lastSweepMs >= RECV_IDLE_MS) SweepIdle(w);
+            if (n <= 0) continue;
+            c.batches++;
+
+            for (int i = 0; i < n; i++)
+            {
+                int len = (int)msgs[i].msg_len;
+                c.packets++;
+                c.bytes += len;
+                if (m_handler->OnDatagram(index, from[i], (const uint8_t *)iov[i].iov_base, len)) continue;
+                const uint8_t *message;
+                len = m_handler->Open(index, from[i], (uint8_t *)iov[i].iov_base, len, &message);
+
+                WireFrameChunk chunk;
+                if (len > 0 && WireParse(message, len, &chunk)) Reassemble(index, w, from[i], chunk, c);
+                else if (len > 0 && WireType(message, len) != 0) m_handler->OnMessage(index, from[i], message, len);
+                else c.rejected++;
+            }
+            m_handler->OnBatch(index);
+
+            w->stats.packets.store(c.packets, std::memory_order_relaxed);
+            w->stats.bytes.store(c.bytes, std::memory_order_relaxed);
+            w->stats.frames.store(c.frames, std::memory_order_relaxed);
+            w->stats.incomplete.store(c.incomplete, std::memory_order_relaxed);
+            w->stats.rejected.store(c.rejected, std::memory_order_relaxed);
+            w->stats.batches.store(c.batches, std::memory_order_relaxed);
+            w->stats.cpuUs.store(ThreadCpuMicros() - cpuStart, std::memory_order_relaxed);
+        }
+    }
+
+    // Same rules as client.cpp: a newer frame id starts a frame, chunks of an
+    // older one or of any frame up to the last delivered are dropped, so are
+    // repeated chunks, and the frame is delivered once every byte is in.
+    void Reassemble(int index, Worker *w, const sockaddr_in &from, const WireFrameChunk &chunk, Counters &c)
+    {
+        uint64_t key = RecvStreamKey(from, chunk.Display());
+        auto it = w->streams.find(key);
+        if (it == w->streams.end())
+        {
+            if (w->streams.size() >= RECV_MAX_STREAMS) EvictIdlest(w);
+            it = w->streams.emplace(key, Stream()).first;
+        }
+        Stream &s = it->second;
+        s.lastMs = w->nowMs;
+        if (s.delivered && (int32_t)(chunk.FrameId() - s.lastId) <= 0) return;
+
+        if (chunk.FrameId() != s.frameId || s.total == 0)
+        {
+            if (s.total != 0 && (int32_t)(chunk.FrameId() - s.frameId) < 0) return;
+            if (s.total != 0) c.incomplete++;
+            s.frameId = chunk.FrameId();
+            s.total = chunk.TotalSize();
+            s.received = 0;
+            s.ranges.Clear();
+            s.width = chunk.Width();
+            s.height = chunk.Height();
+            s.flags = chunk.Flags();
+            s.timestampUs = chunk.TimestampUs();
+        }
+        if (chunk.TotalSize() != s.total) return;
+        uint32_t end = chunk.Offset() + chunk.payloadLen;
+        if (s.buffer.size() < end && !Grow(w, s, end))
+        {
+            // Over the worker's budget: this frame is given up, not the others.
+            c.incomplete++;
+            s.total = 0;
+            Release(w, s);
+            return;
+        }
+        if (!s.ranges.Add(chunk.Offset(), chunk.payloadLen)) return;
+
+        memcpy(s.buffer.data() + chunk.Offset(), chunk.Payload(), chunk.payloadLen);
+        s.received += chunk.payloadLen;
+        if (s.received < s.total) return;
+
+        RecvFrame frame{key, from, chunk.Display(), s.frameId, s.width, s.height, s.flags, s.timestampUs, s.buffer.data(), (int)s.total};
+        s.total = 0;
+        s.lastId = s.frameId;
+        s.delivered = true;
+        c.frames++;
+        m_handler->OnFrame(index, frame);
+    }
+
+    // Makes room for bytes up to `end` of the frame, doubling like a vector
+    // would but never past the frame's size. False if that would take the
+    // worker over RECV_WORKER_BUFFER_BYTES.
+    bool Grow(Worker *w, Stream &s, uint32_t end)
+    {
+        size_t before = s.buffer.capacity();
+        if (end > before)
+        {
+            size_t want = std::max<size_t>(end, std::min<size_t>(s.total, before * 2));
+            if (w->buffered - before + want > RECV_WORKER_BUFFER_BYTES) return false;
+            s.buffer.reserve(want);
+            w->buffered += s.buffer.capacity() - before;
+        }
+        s.buffer.resize(end);
+        return true;
+    }
+
+    void Release(Worker *w, Stream &s)
+    {
+        w->buffered -= s.buffer.capacity();
+        std::vector<uint8_t>().swap(s.buffer);
+    }
+
+    // Rare (RECV_MAX_STREAMS senders on one worker), so a scan is fine.
+    void EvictIdlest(Worker *w)
+    {
+        auto idlest = w->streams.begin();
+        for (auto it = w->streams.begin(); it != w->streams.end(); ++it)
+        {
+            if (it->second.lastMs < idlest->second.lastMs) idlest = it;
+        }
+        Release(w, idlest->second);
+        w->streams.erase(idlest);
+    }
+
+    // Every RECV_IDLE_MS: senders that went away give their buffers back.
+    void SweepIdle(Worker *w)
+    {
+        w->lastSweepMs = w->nowMs;
+        for (auto it = w->streams.begin(); it != w->streams.end();)
+        {
+            if (w->nowMs - it->second.lastMs < RECV_IDLE_MS)
+            {
+                ++it;
+                continue;
+            }
+            Release(w, it->second);
+            it = w->streams.erase(it);
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    RecvHandler *m_handler = NULL;
+    std::atomic<bool> m_running{false};
+    int m_port = 0;
+    int m_batch = RECV_BATCH;
+    int m_steer = RECV_STEER_FLOW;
+};
@@ -0,0 +1,145 @@
+// Relay envelope (relay/relay.cpp).
+//
+// Hosts behind NAT push one stream to a relay and viewers pull it from
+// there. Both only ever send *to* the relay, so neither needs a reachable
+// port or to know the other's address; a keep-alive every
+// RELAY_KEEPALIVE_MS holds their NAT mappings open.
+//
+// Every datagram to or from a relay starts with this plaintext header,
+// followed by a body the relay never looks into:
+//
+//   RELAY_PUBLISH    host -> relay           claims `stream`; repeat as keep-alive.
+//                                            frameId: random per host session
+//   RELAY_JOIN       viewer -> relay         start receiving `stream`; repeat as keep-alive.
+//                                            frameId: downlink cap in kbit/s, 0 = none
+//   RELAY_LEAVE      viewer -> relay
+//   RELAY_MEDIA      host -> relay -> all    one sealed datagram, forwarded as is
+//   RELAY_TO_HOST    viewer -> relay -> host handshake and sealed input; the relay fills in `viewer`
+//   RELAY_TO_VIEWER  host -> relay -> viewer handshake reply and stream key for `viewer`
+//   RELAY_COOKIE     relay -> host, viewer   the cookie to send back, see below
+//
+// PUBLISH and the viewer -> relay datagrams (JOIN, LEAVE, TO_HOST) carry
+// RELAY_COOKIE_SIZE bytes after the header (RELAY_UP_HEADER_SIZE in all).
+// Before it sends anything to, or keeps any state for, an address it has not
+// seen, the relay wants its cookie back: a MAC of the address under a relay
+// secret, answered statelessly in a RELAY_COOKIE no bigger than the request.
+// Only a peer that really receives at its address can echo it, so a spoofed
+// JOIN gets nobody a stream, a spoofed PUBLISH claims no name, and spoofed
+// sources cannot fill the viewer or stream tables. A host already publishing
+// from the same address and session needs no cookie for its keep-alives.
+//
+// For RELAY_MEDIA that is part of a frame, track / frameId / chunk /
+// chunkCount and RELAY_FLAG_KEYFRAME say so (chunkCount 0: audio and
+// anything else). That is all the relay needs to keep the latest keyframe of
+// each track, hand them to a viewer the moment it joins, and after dropping
+// for a slow viewer resume at the start of a keyframe instead of mid-frame.
+//
+// The relay holds no keys (common/relay_session.h): media is sealed once
+// under a per-session stream key each viewer gets from the host over its own
+// handshake, and input stays sealed per viewer. A relay can drop, delay or
+// replay datagrams (replay windows reject repeats) and sees sizes and
+// timing, but cannot read or forge a frame or a keystroke.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define RELAY_PORT 50007
+#define RELAY_MAGIC 0x31594C52u // "RLY1"
+#define RELAY_HEADER_SIZE 24
+
+#define RELAY_PUBLISH 1
+#define RELAY_JOIN 2
+#define RELAY_LEAVE 3
+#define RELAY_MEDIA 4
+#define RELAY_TO_HOST 5
+#define RELAY_TO_VIEWER 6
+#define RELAY_COOKIE 7
+
+#define RELAY_COOKIE_SIZE 8
+#define RELAY_UP_HEADER_SIZE (RELAY_HEADER_SIZE + RELAY_COOKIE_SIZE)
+
+#define RELAY_FLAG_KEYFRAME 0x01 // this frame decodes on its own
+#define RELAY_MAX_TRACKS 16
+
+#define RELAY_KEEPALIVE_MS 2000
+#define RELAY_TIMEOUT_MS 10000 // a host or viewer silent this long is dropped
+
+#pragma pack(push, 1)
+struct RelayHeader
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t chunkCount; // RELAY_MEDIA: chunks in this frame, 0 = not a frame
+    uint32_t stream;     // RelayStreamId()
+    uint32_t viewer;     // RELAY_TO_HOST / RELAY_TO_VIEWER: assigned by the relay
+    uint32_t frameId;    // RELAY_PUBLISH: host session. RELAY_JOIN: kbit/s cap
+    uint16_t chunk;
+    uint16_t track; // RELAY_MEDIA frames: which of the host's streams (display)
+};
+#pragma pack(pop)
+
+static_assert(sizeof(RelayHeader) == RELAY_HEADER_SIZE, "relay header layout");
+
+// Streams are named on the command line; the wire carries a hash (FNV-1a).
+inline uint32_t RelayStreamId(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (uint8_t)*name;
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+inline int RelayWriteHeader(uint8_t *out, uint8_t type, uint32_t stream, uint32_t viewer = 0, uint8_t flags = 0,
+                            uint32_t frameId = 0, uint16_t chunk = 0, uint16_t chunkCount = 0, uint16_t track = 0)
+{
+    RelayHeader h;
+    h.magic = RELAY_MAGIC;
+    h.type = type;
+    h.flags = flags;
+    h.chunkCount = chunkCount;
+    h.stream = stream;
+    h.viewer = viewer;
+    h.frameId = frameId;
+    h.chunk = chunk;
+    h.track = track;
+    memcpy(out, &h, sizeof(h));
+    return RELAY_HEADER_SIZE;
+}
+
+// False for anything that is not a relay datagram.
+inline bool RelayParse(const uint8_t *data, int len, RelayHeader *out)
+{
+    if (len < RELAY_HEADER_SIZE) return false;
+    memcpy(out, data, sizeof(*out));
+    if (out->magic != RELAY_MAGIC || out->type < RELAY_PUBLISH || out->type > RELAY_COOKIE) return false;
+    if (out->chunkCount && (out->chunk >= out->chunkCount || out->track >= RELAY_MAX_TRACKS)) return false;
+    return true;
+}
+
+// "ip", "ip:port" or "ip:port/stream" / "ip/stream" (client.cpp's address box).
+inline bool RelaySplitAddress(const char *text, char *ip, int ipSize, int *port, char *stream, int streamSize)
+{
+    const char *slash = strchr(text, '/');
+    const char *end = slash ? slash : text + strlen(text);
+    const char *colon = (const char *)memchr(text, ':', end - text);
+    const char *ipEnd = colon ? colon : end;
+    if (ipEnd == text || ipEnd - text >= ipSize) return false;
+    memcpy(ip, text, ipEnd - text);
+    ip[ipEnd - text] = 0;
+    *port = colon ? atoi(colon + 1) : RELAY_PORT;
+    if (*port <= 0 || *port > 65535) return false;
+    stream[0] = 0;
+    if (slash)
+    {
+        if (strlen(slash + 1) == 0 || (int)strlen(slash + 1) >= streamSize) return false;
+        strcpy(stream, slash + 1);
+    }
+    return true;
+}
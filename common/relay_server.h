@@ -0,0 +1,895 @@
+// Relay core (relay/relay.cpp, bench/bench_relay.cpp). Linux only.
+//
+// Hosts push one stream each, viewers pull (common/relay_protocol.h). The
+// relay never unseals anything: it receives on a RecvEngine
+// (common/recv_engine.h) and takes every datagram raw in OnDatagram().
+//
+// Forwarding: a host's RELAY_MEDIA datagram is copied once into a refcounted
+// RelayPacket and that one buffer is queued for every joined viewer. Viewers
+// are sharded over sender threads (viewer id % senders); each drains its
+// viewers' queues round-robin, RELAY_VIEWER_BURST at a time, into sendmmsg()
+// batches that mix destinations.
+//
+// Back-pressure stops at the queues: a receive worker only ever appends, so
+// the host is never made to wait. A viewer whose queue is over its byte
+// limit loses that datagram and then the rest of that track until the next
+// keyframe starts, since half a frame is useless. A slow viewer costs itself
+// frames and nobody else anything.
+//
+// A viewer on a thin link says so in RELAY_JOIN. Over UDP nothing else would
+// tell: the relay would send at the host's rate and the link would drop
+// random chunks, spoiling nearly every frame. Its queue is drained at that
+// rate instead (token bucket) and holds at most RELAY_PACED_QUEUE_MS of it,
+// so what it loses are whole frames, at the relay, and what it gets is fresh.
+//
+// Hosts and viewers prove their address first (RELAY_COOKIE,
+// common/relay_protocol.h): until a PUBLISH, JOIN or TO_HOST from a new
+// address echoes its cookie, the relay answers with one datagram of the
+// request's size and keeps nothing, no stream included. The check costs an
+// HMAC, and only on that first contact.
+//
+// Joining: the last complete keyframe of every track is kept (the cache only
+// holds more references to packets already in memory) and queued for a new
+// viewer ahead of live traffic, so it draws at once instead of waiting for
+// the next keyframe, up to a second on an idle 1 fps display.
+//
+// Locks, always taken in this order: table (shared for lookups, exclusive to
+// add or remove hosts and viewers), stream (cache, joined viewers), shard
+// (queues).
+
+#pragma once
+
+#include "recv_engine.h"
+#include "relay_protocol.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+
+#define RELAY_QUEUE_BYTES (1024 * 1024)          // per viewer; relay --queue-kb
+#define RELAY_SEND_BATCH 64                      // datagrams per sendmmsg()
+#define RELAY_VIEWER_BURST 8                     // per viewer per round, so one backlog cannot starve the rest
+#define RELAY_MAX_SENDERS 64
+#define RELAY_MAX_VIEWERS 4096
+#define RELAY_MAX_STREAMS 1024
+#define RELAY_CACHE_MAX_BYTES (16 * 1024 * 1024) // per track; a bigger keyframe is not cached
+#define RELAY_MAX_UPSTREAM 2048                  // viewer -> host datagrams are small
+#define RELAY_SEND_BUFFER (4 * 1024 * 1024)
+#define RELAY_PACE_BURST (2 * RECV_MAX_DATAGRAM) // token bucket depth for a capped viewer
+#define RELAY_PACED_QUEUE_MS 250                 // a capped viewer's queue, in time at its rate
+#define RELAY_COOKIE_PERIOD_MS 10000             // a cookie is good for one to two periods
+
+inline int64_t RelayNowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline int64_t RelayNowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t RelayAddrKey(const sockaddr_in &a)
+{
+    return ((uint64_t)a.sin_addr.s_addr << 16) | a.sin_port;
+}
+
+// One datagram as received, shared by every queue it sits in.
+struct RelayPacket
+{
+    uint64_t order; // arrival order within its stream
+    std::vector<uint8_t> data;
+};
+typedef std::shared_ptr<const RelayPacket> RelayPacketPtr;
+
+struct RelayConfig
+{
+    int port = RELAY_PORT;
+    int workers = 1;
+    int senders = 1;
+    size_t queueBytes = RELAY_QUEUE_BYTES;
+    bool cache = true;
+    bool log = false; // hosts and viewers coming and going, on stdout
+};
+
+// Totals since Start().
+struct RelayCounters
+{
+    uint64_t packetsIn = 0, bytesIn = 0;   // media from hosts
+    uint64_t packetsOut = 0, bytesOut = 0; // everything sent to viewers
+    uint64_t dropped = 0;                  // queue full, or waiting for a keyframe
+    uint64_t sendErrors = 0;
+    uint64_t rejected = 0; // not a relay datagram, unknown stream, wrong sender
+    uint64_t joins = 0, cachedJoins = 0;
+    uint64_t cookies = 0; // sent to addresses not proven yet
+    uint64_t cpuUs = 0; // receive workers and senders
+    int streams = 0, viewers = 0;
+};
+
+class RelayServer : public RecvHandler
+{
+public:
+    ~RelayServer() { Stop(); }
+
+    bool Start(const RelayConfig &config)
+    {
+        Stop();
+        m_config = config;
+        m_config.workers = std::max(1, std::min(config.workers, 64));
+        m_config.senders = std::max(1, std::min(config.senders, RELAY_MAX_SENDERS));
+        if (!m_engine.Open(m_config.port, m_config.workers)) return false;
+        if (RAND_bytes(m_cookieKey, sizeof(m_cookieKey)) != 1)
+        {
+            m_engine.Close();
+            return false;
+        }
+
+        int buffer = RELAY_SEND_BUFFER;
+        for (int i = 0; i < m_config.workers; i++)
+        {
+            setsockopt(m_engine.Socket(i), SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+            m_workers.emplace_back(new WorkerState());
+        }
+        m_running = true;
+        for (int i = 0; i < m_config.senders; i++)
+        {
+            m_shards.emplace_back(new Shard());
+            // Any socket of the group sends from the relay's port.
+            m_shards[i]->fd = m_engine.Socket(i % m_config.workers);
+        }
+        for (int i = 0; i < m_config.senders; i++) m_shards[i]->thread = std::thread(&RelayServer::SendLoop, this, i);
+        m_engine.Start(this);
+        return true;
+    }
+
+    void Stop()
+    {
+        if (!m_running) return;
+        m_engine.Stop();
+        m_running = false;
+        for (auto &s : m_shards)
+        {
+            {
+                std::lock_guard<std::mutex> guard(s->lock);
+            }
+            s->wake.notify_all();
+            s->thread.join();
+        }
+        m_engine.Close();
+        m_shards.clear();
+        m_workers.clear();
+        m_streams.clear();
+        m_byAddr.clear();
+        m_byId.clear();
+    }
+
+    int Port() const { return m_engine.Port(); }
+
+    // Drops hosts and viewers silent for RELAY_TIMEOUT_MS. Call about once a second.
+    void Sweep()
+    {
+        int64_t now = RelayNowMs();
+        std::unique_lock<std::shared_mutex> table(m_tableLock);
+        std::vector<std::shared_ptr<Viewer>> silent;
+        for (auto &it : m_byAddr)
+        {
+            if (now - it.second->lastSeenMs > RELAY_TIMEOUT_MS) silent.push_back(it.second);
+        }
+        for (auto &v : silent) RemoveViewer(v);
+
+        for (auto it = m_streams.begin(); it != m_streams.end();)
+        {
+            Stream &s = *it->second;
+            if (s.hasHost && now - s.hostSeenMs > RELAY_TIMEOUT_MS)
+            {
+                s.hasHost = false;
+                std::lock_guard<std::mutex> guard(s.lock);
+                ClearCache(s);
+                if (m_config.log) std::cout << "[INFO] Stream " << std::hex << s.id << std::dec << ": host gone.\n";
+            }
+            if (!s.hasHost && s.viewers == 0) it = m_streams.erase(it);
+            else ++it;
+        }
+    }
+
+    RelayCounters Counters()
+    {
+        RelayCounters c;
+        for (int i = 0; i < (int)m_workers.size(); i++) c.cpuUs += m_engine.Stats(i).cpuUs;
+        for (auto &w : m_workers)
+        {
+            c.packetsIn += w->shown[IN_PACKETS];
+            c.bytesIn += w->shown[IN_BYTES];
+            c.rejected += w->shown[REJECTED];
+            c.joins += w->shown[JOINS];
+            c.cachedJoins += w->shown[CACHED_JOINS];
+            c.cookies += w->shown[COOKIES];
+        }
+        for (auto &s : m_shards)
+        {
+            c.packetsOut += s->packetsOut;
+            c.bytesOut += s->bytesOut;
+            c.sendErrors += s->sendErrors;
+            c.cpuUs += s->cpuUs;
+            std::lock_guard<std::mutex> guard(s->lock);
+            c.dropped += s->dropped;
+        }
+        std::shared_lock<std::shared_mutex> table(m_tableLock);
+        c.streams = (int)m_streams.size();
+        c.viewers = (int)m_byAddr.size();
+        return c;
+    }
+
+    // --- RecvHandler ---
+    bool OnDatagram(int worker, const sockaddr_in &from, const uint8_t *datagram, int len) override
+    {
+        WorkerState &w = *m_workers[worker];
+        RelayHeader h;
+        if (!RelayParse(datagram, len, &h))
+        {
+            w.local[REJECTED]++;
+            return true;
+        }
+        bool up = h.type == RELAY_PUBLISH || h.type == RELAY_JOIN || h.type == RELAY_LEAVE || h.type == RELAY_TO_HOST;
+        if (up && len < RELAY_UP_HEADER_SIZE)
+        {
+            w.local[REJECTED]++;
+            return true;
+        }
+        switch (h.type)
+        {
+        case RELAY_MEDIA: Media(w, from, h, datagram, len); break;
+        case RELAY_TO_VIEWER: ToViewer(w, from, h, datagram, len); break;
+        case RELAY_TO_HOST: ToHost(worker, w, from, h, datagram, len); break;
+        case RELAY_PUBLISH: Publish(worker, w, from, h, datagram); break;
+        case RELAY_JOIN: Join(worker, w, from, h, datagram); break;
+        case RELAY_LEAVE: Leave(from, h, datagram); break;
+        default: w.local[REJECTED]++; break; // RELAY_COOKIE only goes out
+        }
+        return true;
+    }
+
+    // Wakes the senders this batch queued for, once, and publishes counters.
+    void OnBatch(int worker) override
+    {
+        WorkerState &w = *m_workers[worker];
+        for (int i = 0; w.dirty; i++, w.dirty >>= 1)
+        {
+            if (w.dirty & 1) m_shards[i]->wake.notify_one();
+        }
+        for (int i = 0; i < WORKER_COUNTERS; i++) w.shown[i].store(w.local[i], std::memory_order_relaxed);
+    }
+
+    void OnFrame(int, const RecvFrame &) override {}
+
+private:
+    enum
+    {
+        IN_PACKETS,
+        IN_BYTES,
+        REJECTED,
+        JOINS,
+        CACHED_JOINS,
+        COOKIES,
+        WORKER_COUNTERS
+    };
+
+    // Counted locally, published per batch like RecvEngine's stats.
+    struct alignas(64) WorkerState
+    {
+        uint64_t dirty = 0; // shards with new packets this batch
+        uint64_t local[WORKER_COUNTERS] = {};
+        std::atomic<uint64_t> shown[WORKER_COUNTERS] = {};
+    };
+
+    struct Viewer
+    {
+        uint32_t id = 0;
+        uint32_t stream = 0;
+        sockaddr_in addr{};
+        uint64_t cookie = 0; // the one it proved its address with
+        int shard = 0;
+        std::atomic<int64_t> lastSeenMs{0};
+        bool joined = false; // table lock
+        // Shard lock:
+        std::deque<RelayPacketPtr> queue;
+        size_t queuedBytes = 0;
+        size_t limit = 0;   // queue bytes
+        uint32_t kbps = 0;  // RELAY_JOIN cap, 0 = none
+        double tokens = 0;  // bytes it may be sent now
+        int64_t refillUs = 0;
+        uint32_t resync = 0; // tracks waiting for a keyframe
+        bool gone = false;
+    };
+
+    struct Track
+    {
+        uint32_t frameId = 0;
+        std::vector<RelayPacketPtr> building; // keyframe arriving
+        int have = 0;
+        size_t bytes = 0;
+        std::vector<RelayPacketPtr> latest; // last complete keyframe
+    };
+
+    struct Stream
+    {
+        uint32_t id = 0;
+        // Table lock:
+        bool hasHost = false;
+        sockaddr_in host{};
+        uint32_t session = 0;
+        int viewers = 0;
+        std::atomic<int64_t> hostSeenMs{0};
+        // Stream lock:
+        std::mutex lock;
+        uint64_t order = 0;
+        Track tracks[RELAY_MAX_TRACKS];
+        std::vector<std::vector<std::shared_ptr<Viewer>>> joined; // per shard
+    };
+
+    struct Shard
+    {
+        int fd = -1;
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::vector<std::shared_ptr<Viewer>> viewers;
+        size_t pending = 0;   // packets queued over all viewers
+        uint64_t dropped = 0; // under lock
+        std::atomic<uint64_t> packetsOut{0}, bytesOut{0}, sendErrors{0}, cpuUs{0};
+    };
+
+    static bool SameAddr(const sockaddr_in &a, const sockaddr_in &b)
+    {
+        return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+    }
+
+    static std::string AddrText(const sockaddr_in &a)
+    {
+        char ip[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &a.sin_addr, ip, sizeof(ip));
+        return std::string(ip) + ":" + std::to_string(ntohs(a.sin_port));
+    }
+
+    // --- HOST ---
+    void Publish(int worker, WorkerState &w, const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram)
+    {
+        {
+            std::shared_lock<std::shared_mutex> table(m_tableLock);
+            auto it = m_streams.find(h.stream);
+            if (it != m_streams.end() && it->second->hasHost && SameAddr(it->second->host, from) && it->second->session == h.frameId)
+            {
+                it->second->hostSeenMs = RelayNowMs();
+                return;
+            }
+        }
+        // A new host, address or session: no stream, no claim on a name, until
+        // the address has answered.
+        if (!CookieValid(from, h.stream, CookieOf(datagram)))
+        {
+            SendCookie(worker, w, from, h.stream);
+            return;
+        }
+        std::unique_lock<std::shared_mutex> table(m_tableLock);
+        std::shared_ptr<Stream> s = StreamFor(h.stream);
+        if (!s) return;
+        int64_t now = RelayNowMs();
+        if (s->hasHost && !SameAddr(s->host, from) && now - s->hostSeenMs <= RELAY_TIMEOUT_MS)
+        {
+            w.local[REJECTED]++; // somebody else's stream
+            return;
+        }
+        // A new host session seals under a new key: the old keyframes are useless.
+        if (s->session != h.frameId || !SameAddr(s->host, from))
+        {
+            std::lock_guard<std::mutex> guard(s->lock);
+            ClearCache(*s);
+        }
+        s->hasHost = true;
+        s->host = from;
+        s->session = h.frameId;
+        s->hostSeenMs = now;
+        if (m_config.log) std::cout << "[INFO] Stream " << std::hex << s->id << std::dec << ": host " << AddrText(from) << ".\n";
+    }
+
+    // The stream `from` is the host of, or NULL.
+    std::shared_ptr<Stream> HostStream(const sockaddr_in &from, uint32_t stream)
+    {
+        auto it = m_streams.find(stream);
+        if (it == m_streams.end() || !it->second->hasHost || !SameAddr(it->second->host, from)) return NULL;
+        return it->second;
+    }
+
+    void Media(WorkerState &w, const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram, int len)
+    {
+        std::shared_ptr<Stream> s;
+        {
+            std::shared_lock<std::shared_mutex> table(m_tableLock);
+            s = HostStream(from, h.stream);
+        }
+        if (!s)
+        {
+            w.local[REJECTED]++;
+            return;
+        }
+        w.local[IN_PACKETS]++;
+        w.local[IN_BYTES] += len;
+
+        // OPTIMIZATION: One copy per datagram, however many viewers get it.
+        std::shared_ptr<RelayPacket> p = std::make_shared<RelayPacket>();
+        p->data.assign(datagram, datagram + len);
+        bool frame = h.chunkCount != 0;
+        bool key = frame && (h.flags & RELAY_FLAG_KEYFRAME);
+
+        // Viewers leave under this lock, so none is removed under our feet.
+        std::lock_guard<std::mutex> guard(s->lock);
+        p->order = s->order++;
+        if (key && m_config.cache) Cache(s->tracks[h.track], h, p);
+        for (size_t i = 0; i < s->joined.size(); i++)
+        {
+            if (s->joined[i].empty()) continue;
+            Shard &sh = *m_shards[i];
+            std::lock_guard<std::mutex> shardGuard(sh.lock);
+            for (auto &v : s->joined[i]) Enqueue(sh, *v, p, frame ? h.track : -1, key && h.chunk == 0);
+            w.dirty |= 1ull << i;
+        }
+    }
+
+    void Cache(Track &t, const RelayHeader &h, const RelayPacketPtr &p)
+    {
+        if (t.building.empty() || h.frameId != t.frameId || h.chunkCount != t.building.size())
+        {
+            t.building.assign(h.chunkCount, RelayPacketPtr());
+            t.frameId = h.frameId;
+            t.have = 0;
+            t.bytes = 0;
+        }
+        if (t.building[h.chunk]) return;
+        t.bytes += p->data.size();
+        if (t.bytes > RELAY_CACHE_MAX_BYTES)
+        {
+            t.building.clear();
+            return;
+        }
+        t.building[h.chunk] = p;
+        if (++t.have == (int)t.building.size())
+        {
+            t.latest.swap(t.building);
+            t.building.clear();
+        }
+    }
+
+    // Under the stream's lock.
+    void ClearCache(Stream &s)
+    {
+        for (auto &t : s.tracks) t = Track();
+    }
+
+    // Host -> one viewer (handshake reply, stream key).
+    void ToViewer(WorkerState &w, const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram, int len)
+    {
+        std::shared_lock<std::shared_mutex> table(m_tableLock);
+        auto it = m_byId.find(h.viewer);
+        if (!HostStream(from, h.stream) || it == m_byId.end() || it->second->stream != h.stream)
+        {
+            w.local[REJECTED]++;
+            return;
+        }
+        std::shared_ptr<RelayPacket> p = std::make_shared<RelayPacket>();
+        p->order = 0;
+        p->data.assign(datagram, datagram + len);
+        Viewer &v = *it->second;
+        Shard &sh = *m_shards[v.shard];
+        std::lock_guard<std::mutex> guard(sh.lock);
+        Enqueue(sh, v, p, -1, false);
+        w.dirty |= 1ull << v.shard;
+    }
+
+    // --- VIEWERS ---
+    // HMAC(relay secret, address, stream, period), truncated. Stateless: a
+    // cookie from this period or the last is recognised without a table.
+    uint64_t Cookie(const sockaddr_in &from, uint32_t stream, int64_t period) const
+    {
+        uint8_t msg[18];
+        memcpy(msg, &from.sin_addr.s_addr, 4);
+        memcpy(msg + 4, &from.sin_port, 2);
+        memcpy(msg + 6, &stream, 4);
+        memcpy(msg + 10, &period, 8);
+        uint8_t mac[EVP_MAX_MD_SIZE];
+        unsigned int macLen = 0;
+        HMAC(EVP_sha256(), m_cookieKey, sizeof(m_cookieKey), msg, sizeof(msg), mac, &macLen);
+        uint64_t cookie;
+        memcpy(&cookie, mac, sizeof(cookie));
+        return cookie;
+    }
+
+    static uint64_t CookieOf(const uint8_t *datagram)
+    {
+        uint64_t cookie;
+        memcpy(&cookie, datagram + RELAY_HEADER_SIZE, sizeof(cookie));
+        return cookie;
+    }
+
+    bool CookieValid(const sockaddr_in &from, uint32_t stream, uint64_t cookie) const
+    {
+        int64_t period = RelayNowMs() / RELAY_COOKIE_PERIOD_MS;
+        uint64_t now = Cookie(from, stream, period), last = Cookie(from, stream, period - 1);
+        return CRYPTO_memcmp(&cookie, &now, sizeof(cookie)) == 0 || CRYPTO_memcmp(&cookie, &last, sizeof(cookie)) == 0;
+    }
+
+    // RELAY_UP_HEADER_SIZE bytes, no more than the request it answers.
+    void SendCookie(int worker, WorkerState &w, const sockaddr_in &from, uint32_t stream)
+    {
+        uint8_t reply[RELAY_UP_HEADER_SIZE];
+        RelayWriteHeader(reply, RELAY_COOKIE, stream);
+        uint64_t cookie = Cookie(from, stream, RelayNowMs() / RELAY_COOKIE_PERIOD_MS);
+        memcpy(reply + RELAY_HEADER_SIZE, &cookie, sizeof(cookie));
+        sendto(m_engine.Socket(worker), reply, sizeof(reply), MSG_DONTWAIT, (const sockaddr *)&from, sizeof(from));
+        w.local[COOKIES]++;
+    }
+
+    // Viewer -> host, with the viewer's id filled in so the host can answer
+    // and the cookie taken out.
+    void ToHost(int worker, WorkerState &w, const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram, int len)
+    {
+        if (len > RELAY_MAX_UPSTREAM)
+        {
+            w.local[REJECTED]++;
+            return;
+        }
+        uint32_t id = 0;
+        sockaddr_in host{};
+        bool found = false;
+        {
+            std::shared_lock<std::shared_mutex> table(m_tableLock);
+            auto it = m_byAddr.find(RelayAddrKey(from));
+            if (it != m_byAddr.end() && it->second->stream == h.stream)
+            {
+                found = true;
+                id = it->second->id;
+                it->second->lastSeenMs = RelayNowMs();
+                auto s = m_streams.find(h.stream);
+                if (s != m_streams.end() && s->second->hasHost) host = s->second->host;
+            }
+        }
+        if (!found)
+        {
+            uint64_t cookie = CookieOf(datagram);
+            if (!CookieValid(from, h.stream, cookie))
+            {
+                SendCookie(worker, w, from, h.stream);
+                return;
+            }
+            std::unique_lock<std::shared_mutex> table(m_tableLock);
+            std::shared_ptr<Viewer> v = ViewerFor(from, h.stream, &cookie);
+            if (v)
+            {
+                id = v->id;
+                Stream &s = *m_streams[h.stream];
+                if (s.hasHost) host = s.host;
+            }
+        }
+        if (!id || !host.sin_port)
+        {
+            w.local[REJECTED]++;
+            return;
+        }
+
+        uint8_t buffer[RELAY_MAX_UPSTREAM];
+        int bodyLen = len - RELAY_UP_HEADER_SIZE;
+        memcpy(buffer, datagram, RELAY_HEADER_SIZE);
+        memcpy(buffer + RELAY_HEADER_SIZE, datagram + RELAY_UP_HEADER_SIZE, bodyLen);
+        memcpy(buffer + offsetof(RelayHeader, viewer), &id, sizeof(id));
+        sendto(m_engine.Socket(worker), buffer, RELAY_HEADER_SIZE + bodyLen, MSG_DONTWAIT, (sockaddr *)&host, sizeof(host));
+    }
+
+    void Join(int worker, WorkerState &w, const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram)
+    {
+        bool known = false;
+        {
+            std::shared_lock<std::shared_mutex> table(m_tableLock);
+            auto it = m_byAddr.find(RelayAddrKey(from));
+            if (it != m_byAddr.end() && it->second->stream == h.stream)
+            {
+                it->second->lastSeenMs = RelayNowMs();
+                if (it->second->joined) return;
+                known = true; // handshook through us already
+            }
+        }
+        uint64_t cookie = CookieOf(datagram);
+        if (!known && !CookieValid(from, h.stream, cookie))
+        {
+            SendCookie(worker, w, from, h.stream);
+            return;
+        }
+        std::unique_lock<std::shared_mutex> table(m_tableLock);
+        std::shared_ptr<Viewer> v = ViewerFor(from, h.stream, known ? NULL : &cookie);
+        if (!v || v->joined) return;
+        v->joined = true;
+        std::shared_ptr<Stream> s = m_streams[h.stream];
+
+        std::lock_guard<std::mutex> guard(s->lock);
+        s->joined[v->shard].push_back(v);
+
+        // The latest keyframe of every track and what has arrived of the
+        // next, oldest first: the viewer's replay window takes them in the
+        // order the host sealed them.
+        std::vector<std::pair<RelayPacketPtr, int>> cached;
+        for (int t = 0; t < RELAY_MAX_TRACKS; t++)
+        {
+            for (auto &p : s->tracks[t].latest) cached.push_back(std::make_pair(p, t));
+            for (auto &p : s->tracks[t].building)
+            {
+                if (p) cached.push_back(std::make_pair(p, t));
+            }
+        }
+        std::sort(cached.begin(), cached.end(), [](const std::pair<RelayPacketPtr, int> &a, const std::pair<RelayPacketPtr, int> &b) {
+            return a.first->order < b.first->order;
+        });
+
+        Shard &sh = *m_shards[v->shard];
+        std::lock_guard<std::mutex> shardGuard(sh.lock);
+        if (h.frameId)
+        {
+            v->kbps = h.frameId;
+            v->tokens = RELAY_PACE_BURST;
+            v->refillUs = RelayNowUs();
+            v->limit = std::min(m_config.queueBytes, std::max((size_t)h.frameId * RELAY_PACED_QUEUE_MS / 8, (size_t)RELAY_PACE_BURST));
+        }
+        for (size_t i = 0; i < cached.size(); i++)
+        {
+            bool start = i == 0 || cached[i].second != cached[i - 1].second;
+            Enqueue(sh, *v, cached[i].first, cached[i].second, start);
+        }
+        w.local[JOINS]++;
+        if (!cached.empty()) w.local[CACHED_JOINS]++;
+        w.dirty |= 1ull << v->shard;
+        if (m_config.log)
+        {
+            std::cout << "[INFO] Stream " << std::hex << s->id << std::dec << ": viewer " << v->id << " (" << AddrText(from) << ") joined"
+                      << (cached.empty() ? "" : ", sent cached keyframe") << ".\n";
+        }
+    }
+
+    // Only with the cookie the viewer registered with (or a fresh one), so a
+    // spoofed LEAVE cannot disconnect anybody.
+    void Leave(const sockaddr_in &from, const RelayHeader &h, const uint8_t *datagram)
+    {
+        uint64_t cookie = CookieOf(datagram);
+        std::unique_lock<std::shared_mutex> table(m_tableLock);
+        auto it = m_byAddr.find(RelayAddrKey(from));
+        if (it == m_byAddr.end() || it->second->stream != h.stream) return;
+        if (CRYPTO_memcmp(&cookie, &it->second->cookie, sizeof(cookie)) != 0 && !CookieValid(from, h.stream, cookie)) return;
+        RemoveViewer(it->second);
+    }
+
+    // Under the exclusive table lock. Creates the stream if needed, so
+    // viewers can wait for a host that has not published yet.
+    std::shared_ptr<Stream> StreamFor(uint32_t id)
+    {
+        auto it = m_streams.find(id);
+        if (it != m_streams.end()) return it->second;
+        if ((int)m_streams.size() >= RELAY_MAX_STREAMS) return NULL;
+        std::shared_ptr<Stream> s = std::make_shared<Stream>();
+        s->id = id;
+        s->joined.resize(m_shards.size());
+        m_streams[id] = s;
+        return s;
+    }
+
+    // Under the exclusive table lock. Creates a viewer only given a `cookie`
+    // the caller checked; NULL: existing viewers only.
+    std::shared_ptr<Viewer> ViewerFor(const sockaddr_in &from, uint32_t stream, const uint64_t *cookie)
+    {
+        uint64_t key = RelayAddrKey(from);
+        auto it = m_byAddr.find(key);
+        if (it != m_byAddr.end())
+        {
+            if (it->second->stream == stream)
+            {
+                it->second->lastSeenMs = RelayNowMs();
+                return it->second;
+            }
+            RemoveViewer(it->second); // moved on to another stream
+        }
+        if (!cookie || (int)m_byAddr.size() >= RELAY_MAX_VIEWERS) return NULL;
+        std::shared_ptr<Stream> s = StreamFor(stream);
+        if (!s) return NULL;
+
+        std::shared_ptr<Viewer> v = std::make_shared<Viewer>();
+        if (++m_nextViewerId == 0) m_nextViewerId = 1;
+        v->id = m_nextViewerId;
+        v->stream = stream;
+        v->addr = from;
+        v->cookie = *cookie;
+        v->shard = (int)(v->id % m_shards.size());
+        v->limit = m_config.queueBytes;
+        v->lastSeenMs = RelayNowMs();
+        m_byAddr[key] = v;
+        m_byId[v->id] = v;
+        s->viewers++;
+        Shard &sh = *m_shards[v->shard];
+        std::lock_guard<std::mutex> guard(sh.lock);
+        sh.viewers.push_back(v);
+        return v;
+    }
+
+    // Under the exclusive table lock.
+    void RemoveViewer(std::shared_ptr<Viewer> v)
+    {
+        auto s = m_streams.find(v->stream);
+        if (s != m_streams.end())
+        {
+            s->second->viewers--;
+            if (v->joined)
+            {
+                std::lock_guard<std::mutex> guard(s->second->lock);
+                auto &list = s->second->joined[v->shard];
+                list.erase(std::remove(list.begin(), list.end(), v), list.end());
+            }
+        }
+        Shard &sh = *m_shards[v->shard];
+        {
+            std::lock_guard<std::mutex> guard(sh.lock);
+            sh.viewers.erase(std::remove(sh.viewers.begin(), sh.viewers.end(), v), sh.viewers.end());
+            sh.pending -= v->queue.size();
+            v->queue.clear();
+            v->queuedBytes = 0;
+            v->gone = true;
+        }
+        m_byAddr.erase(RelayAddrKey(v->addr));
+        m_byId.erase(v->id);
+    }
+
+    // Under the shard's lock. track -1: not part of a frame.
+    void Enqueue(Shard &sh, Viewer &v, const RelayPacketPtr &p, int track, bool keyStart)
+    {
+        if (v.gone) return;
+        uint32_t bit = track >= 0 ? 1u << track : 0;
+        if (v.resync & bit)
+        {
+            if (!keyStart)
+            {
+                sh.dropped++;
+                return;
+            }
+            v.resync &= ~bit;
+        }
+        size_t size = p->data.size();
+        if (v.queuedBytes + size > v.limit)
+        {
+            // The rest of this frame would be thrown away by the viewer anyway.
+            v.resync |= bit;
+            sh.dropped++;
+            return;
+        }
+        v.queue.push_back(p);
+        v.queuedBytes += size;
+        sh.pending++;
+    }
+
+    // --- SENDING ---
+    // Token bucket of a viewer with a rate cap. Under the shard's lock.
+    static bool Spend(Viewer &v, size_t size, int64_t nowUs)
+    {
+        v.tokens = std::min(v.tokens + (nowUs - v.refillUs) * (v.kbps / 8000.0), (double)RELAY_PACE_BURST);
+        v.refillUs = nowUs;
+        if (v.tokens < (double)size) return false;
+        v.tokens -= size;
+        return true;
+    }
+
+    void SendLoop(int index)
+    {
+        Shard &sh = *m_shards[index];
+        std::vector<mmsghdr> msgs(RELAY_SEND_BATCH);
+        std::vector<iovec> iov(RELAY_SEND_BATCH);
+        std::vector<sockaddr_in> to(RELAY_SEND_BATCH);
+        std::vector<RelayPacketPtr> held(RELAY_SEND_BATCH);
+        size_t next = 0;
+        uint64_t packets = 0, bytes = 0, errors = 0;
+        uint64_t cpuStart = ThreadCpuMicros();
+        bool throttled = false; // only capped viewers have anything queued
+
+        while (true)
+        {
+            int n = 0;
+            {
+                std::unique_lock<std::mutex> lk(sh.lock);
+                if (throttled) sh.wake.wait_for(lk, std::chrono::milliseconds(1));
+                else sh.wake.wait_for(lk, std::chrono::milliseconds(RECV_POLL_MS), [&] { return sh.pending > 0 || !m_running; });
+                if (!m_running) break;
+
+                // Round-robin over the viewers until the batch is full or
+                // every queue is empty or out of tokens.
+                int64_t nowUs = RelayNowUs();
+                size_t count = sh.viewers.size();
+                bool more = true;
+                while (n < RELAY_SEND_BATCH && more)
+                {
+                    more = false;
+                    for (size_t k = 0; k < count && n < RELAY_SEND_BATCH; k++)
+                    {
+                        Viewer &v = *sh.viewers[(next + k) % count];
+                        int b = 0;
+                        for (; b < RELAY_VIEWER_BURST && !v.queue.empty() && n < RELAY_SEND_BATCH; b++)
+                        {
+                            if (v.kbps && !Spend(v, v.queue.front()->data.size(), nowUs)) break;
+                            held[n] = std::move(v.queue.front());
+                            v.queue.pop_front();
+                            v.queuedBytes -= held[n]->data.size();
+                            sh.pending--;
+                            to[n] = v.addr;
+                            n++;
+                        }
+                        if (b == RELAY_VIEWER_BURST && !v.queue.empty()) more = true;
+                    }
+                }
+                next++;
+                throttled = n == 0 && sh.pending > 0;
+            }
+
+            for (int i = 0; i < n; i++)
+            {
+                iov[i].iov_base = (void *)held[i]->data.data();
+                iov[i].iov_len = held[i]->data.size();
+                memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_name = &to[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            }
+            // OPTIMIZATION: One syscall for up to RELAY_SEND_BATCH datagrams to any mix of viewers.
+            int done = 0;
+            while (done < n && m_running)
+            {
+                int r = sendmmsg(sh.fd, &msgs[done], n - done, MSG_DONTWAIT);
+                if (r > 0)
+                {
+                    for (int i = done; i < done + r; i++) bytes += iov[i].iov_len;
+                    packets += r;
+                    done += r;
+                }
+                else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                {
+                    // Socket buffer full: only this sender waits; queues keep filling and dropping.
+                    pollfd pfd{sh.fd, POLLOUT, 0};
+                    poll(&pfd, 1, 10);
+                }
+                else if (errno != EINTR)
+                {
+                    done++; // this destination refused; skip it
+                    errors++;
+                }
+            }
+            for (int i = 0; i < n; i++) held[i].reset();
+            sh.packetsOut.store(packets, std::memory_order_relaxed);
+            sh.bytesOut.store(bytes, std::memory_order_relaxed);
+            sh.sendErrors.store(errors, std::memory_order_relaxed);
+            sh.cpuUs.store(ThreadCpuMicros() - cpuStart, std::memory_order_relaxed);
+        }
+    }
+
+    RelayConfig m_config;
+    RecvEngine m_engine;
+    std::atomic<bool> m_running{false};
+    std::vector<std::unique_ptr<WorkerState>> m_workers;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::shared_mutex m_tableLock;
+    std::unordered_map<uint32_t, std::shared_ptr<Stream>> m_streams;
+    std::unordered_map<uint64_t, std::shared_ptr<Viewer>> m_byAddr;
+    std::unordered_map<uint32_t, std::shared_ptr<Viewer>> m_byId;
+    uint32_t m_nextViewerId = 0;
+    uint8_t m_cookieKey[32] = {};
+};
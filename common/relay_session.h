@@ -0,0 +1,280 @@
+// Both ends of a session through a relay (common/relay_protocol.h).
+//
+//   viewer                        relay                 host
+//                                 new address:       <-  PUBLISH
+//                                 prove it           ->  COOKIE
+//                                 stream claimed     <-  PUBLISH+cookie, then as keep-alive
+//   TO_HOST  HELLO        ->      new address:
+//   COOKIE                <-      prove it
+//   TO_HOST  HELLO+cookie ->      fills in viewer id ->  RelayHostSessions: AcceptHello
+//   TO_VIEWER REPLY       <-      by viewer id       <-
+//   TO_HOST  CONFIRM      ->                         ->  AcceptConfirm, then the stream
+//   TO_VIEWER [stream key]<-                         <-  key sealed under this session
+//   JOIN                  ->      cached keyframe, then live RELAY_MEDIA
+//
+// RELAY_MEDIA is sealed under the host's stream key (SecureChannel::
+// InitBroadcast); RELAY_TO_HOST messages after the handshake under the
+// viewer's own session. Keeping media on one key is what lets the relay send
+// one ciphertext to every viewer and replay a cached keyframe untouched.
+
+#pragma once
+
+#include "relay_protocol.h"
+#include "secure_channel.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define RELAY_MAX_SESSIONS 256 // viewers the host keeps a session for; the idlest goes first
+#define RELAY_MAX_PENDING 64   // handshakes in progress; the idlest goes first
+#define RELAY_REPLY_MAX (RELAY_UP_HEADER_SIZE + SEAL_OVERHEAD + 128)
+#define RELAY_HANDSHAKE_TIMEOUT_MS 10000 // bad replies and no good one for this long: wrong key
+
+// Host side. Driven by one thread (host.cpp: InputListener).
+//
+// A HELLO proves nothing (anyone can send one), so a handshake in progress
+// lives in m_pending, a pool of its own: HELLOs only ever push out other
+// unfinished handshakes. A session moves to m_sessions on a valid CONFIRM,
+// which needs the key; only then can it take the place of an idle one.
+class RelayHostSessions
+{
+public:
+    void Init(const std::string &psk, uint32_t stream, const SecureChannel *broadcast)
+    {
+        m_psk = psk;
+        m_stream = stream;
+        m_broadcast = broadcast;
+        m_sessions.clear();
+        m_pending.clear();
+        m_cookie = 0;
+        RAND_bytes((uint8_t *)&m_session, sizeof(m_session));
+    }
+
+    uint32_t Stream() const { return m_stream; }
+    int Viewers() const { return (int)m_sessions.size(); }
+
+    // Register / keep-alive, RELAY_UP_HEADER_SIZE bytes. A new session tells
+    // the relay its cached keyframes (sealed under the previous stream key)
+    // are stale. Safe to call from another thread than Handle().
+    int WritePublish(uint8_t *out) const
+    {
+        RelayWriteHeader(out, RELAY_PUBLISH, m_stream, 0, 0, m_session);
+        uint64_t cookie = m_cookie;
+        memcpy(out + RELAY_HEADER_SIZE, &cookie, sizeof(cookie));
+        return RELAY_UP_HEADER_SIZE;
+    }
+
+    // One datagram from the relay. Returns the length of a reply written to
+    // `reply` (RELAY_REPLY_MAX bytes) for a handshake step or a PUBLISH with
+    // a new cookie, 0 with *message / *messageLen set for a viewer's sealed
+    // message (opened in place), or -1 for anything else.
+    int Handle(uint8_t *datagram, int len, uint8_t *reply, const uint8_t **message, int *messageLen)
+    {
+        RelayHeader h;
+        if (!RelayParse(datagram, len, &h) || h.stream != m_stream) return -1;
+        uint8_t *body = datagram + RELAY_HEADER_SIZE;
+        int bodyLen = len - RELAY_HEADER_SIZE;
+        if (h.type == RELAY_COOKIE)
+        {
+            // The relay does not know us (first PUBLISH, relay restarted): publish again, with proof.
+            if (bodyLen != RELAY_COOKIE_SIZE) return -1;
+            uint64_t cookie;
+            memcpy(&cookie, body, sizeof(cookie));
+            m_cookie = cookie;
+            return WritePublish(reply);
+        }
+        if (h.type != RELAY_TO_HOST) return -1;
+        m_tick++;
+
+        if (bodyLen == (int)sizeof(HandshakeHello))
+        {
+            // A viewer starting over gets a fresh session; its current one,
+            // if any, stays until the new one is confirmed.
+            std::unique_ptr<Session> s(new Session());
+            HandshakeReply out;
+            if (s->channel.AcceptHello(m_psk, body, bodyLen, &out))
+            {
+                if (!m_pending.count(h.viewer) && (int)m_pending.size() >= RELAY_MAX_PENDING) EvictIdlest(m_pending);
+                s->lastUse = m_tick;
+                m_pending[h.viewer] = std::move(s);
+                int n = RelayWriteHeader(reply, RELAY_TO_VIEWER, m_stream, h.viewer);
+                memcpy(reply + n, &out, sizeof(out));
+                return n + (int)sizeof(out);
+            }
+        }
+
+        auto pending = m_pending.find(h.viewer);
+        if (pending != m_pending.end() && pending->second->channel.AcceptConfirm(body, bodyLen))
+        {
+            std::unique_ptr<Session> s = std::move(pending->second);
+            m_pending.erase(pending);
+            if (!m_sessions.count(h.viewer) && (int)m_sessions.size() >= RELAY_MAX_SESSIONS) EvictIdlest(m_sessions);
+            s->lastUse = m_tick;
+            Session &ready = *(m_sessions[h.viewer] = std::move(s));
+
+            int n = RelayWriteHeader(reply, RELAY_TO_VIEWER, m_stream, h.viewer);
+            HandshakeStreamKey key;
+            m_broadcast->ExportBroadcast(&key);
+            memcpy(reply + n + SEAL_SEQ_SIZE, &key, sizeof(key));
+            OPENSSL_cleanse(&key, sizeof(key));
+            return n + ready.channel.Seal(reply + n, (int)sizeof(key));
+        }
+
+        auto it = m_sessions.find(h.viewer);
+        if (it == m_sessions.end()) return -1;
+        Session &s = *it->second;
+        int plainLen = s.channel.Open(body, bodyLen);
+        if (plainLen <= 0) return -1;
+        s.lastUse = m_tick;
+        *message = body + SEAL_SEQ_SIZE;
+        *messageLen = plainLen;
+        return 0;
+    }
+
+private:
+    struct Session
+    {
+        SecureChannel channel;
+        uint64_t lastUse = 0;
+    };
+    typedef std::map<uint32_t, std::unique_ptr<Session>> SessionMap;
+
+    static void EvictIdlest(SessionMap &sessions)
+    {
+        auto idlest = sessions.begin();
+        for (auto it = sessions.begin(); it != sessions.end(); ++it)
+        {
+            if (it->second->lastUse < idlest->second->lastUse) idlest = it;
+        }
+        if (idlest != sessions.end()) sessions.erase(idlest);
+    }
+
+    std::string m_psk;
+    uint32_t m_stream = 0;
+    uint32_t m_session = 0;
+    std::atomic<uint64_t> m_cookie{0}; // from the relay's last RELAY_COOKIE
+    const SecureChannel *m_broadcast = NULL;
+    SessionMap m_sessions; // confirmed
+    SessionMap m_pending;  // HELLO answered, no CONFIRM yet
+    uint64_t m_tick = 0;
+};
+
+// Viewer side. Not thread-safe; client.cpp drives it from its one UI and
+// receive thread.
+class RelayViewerSession
+{
+public:
+    // (Re)starts the handshake. Writes the first datagram to `out`
+    // (RELAY_REPLY_MAX bytes) and returns its length, 0 on failure.
+    int Begin(const std::string &psk, uint32_t stream, uint8_t *out)
+    {
+        if (stream != m_stream) m_cookie = 0;
+        m_stream = stream;
+        m_session.reset(new SecureChannel());
+        m_media.reset(new SecureChannel());
+        HandshakeHello hello;
+        if (!m_session->BeginClient(psk, &hello)) return 0;
+        int n = WriteUp(out, RELAY_TO_HOST);
+        memcpy(out + n, &hello, sizeof(hello));
+        n += (int)sizeof(hello);
+        m_last.assign(out, out + n);
+        return n;
+    }
+
+    // Has the stream key: time to JOIN.
+    bool Ready() const { return m_media && m_media->Ready(); }
+    // Replies that failed to verify since the last one that did. One proves
+    // nothing (a stale reply, a forged one); nothing else for
+    // RELAY_HANDSHAKE_TIMEOUT_MS means the host holds another key.
+    int Rejected() const { return m_rejected; }
+
+    // kbps: what our link takes, so the relay drops whole frames for us
+    // instead of the network dropping random chunks (0 = no cap).
+    // `out` holds RELAY_UP_HEADER_SIZE bytes.
+    int WriteJoin(uint8_t *out, uint32_t kbps = 0)
+    {
+        int n = WriteUp(out, RELAY_JOIN, kbps);
+        m_last.assign(out, out + n);
+        return n;
+    }
+    int WriteLeave(uint8_t *out) const { return WriteUp(out, RELAY_LEAVE); }
+
+    // One datagram from the relay. Returns the length of a reply written to
+    // `reply` (RELAY_REPLY_MAX bytes), 0 with *message / *messageLen set for
+    // a frame chunk or audio (opened in place), or -1 for anything else,
+    // the stream key included (check Ready()).
+    int Handle(uint8_t *datagram, int len, uint8_t *reply, const uint8_t **message, int *messageLen)
+    {
+        RelayHeader h;
+        if (!m_session || !RelayParse(datagram, len, &h) || h.stream != m_stream) return -1;
+        uint8_t *body = datagram + RELAY_HEADER_SIZE;
+        int bodyLen = len - RELAY_HEADER_SIZE;
+
+        if (h.type == RELAY_COOKIE)
+        {
+            // The relay does not know our address yet: say the last thing again, with proof.
+            if (bodyLen != RELAY_COOKIE_SIZE || m_last.empty()) return -1;
+            memcpy(&m_cookie, body, sizeof(m_cookie));
+            memcpy(reply, m_last.data(), m_last.size());
+            memcpy(reply + RELAY_HEADER_SIZE, &m_cookie, sizeof(m_cookie));
+            return (int)m_last.size();
+        }
+        if (h.type == RELAY_MEDIA)
+        {
+            int plainLen = m_media->Open(body, bodyLen);
+            if (plainLen <= 0) return -1;
+            *message = body + SEAL_SEQ_SIZE;
+            *messageLen = plainLen;
+            return 0;
+        }
+        if (h.type != RELAY_TO_VIEWER) return -1;
+
+        if (bodyLen == (int)sizeof(HandshakeReply) && !m_session->Ready())
+        {
+            HandshakeConfirm confirm;
+            if (!m_session->FinishClient(body, bodyLen, &confirm))
+            {
+                m_rejected++;
+                return -1;
+            }
+            m_rejected = 0;
+            int n = WriteUp(reply, RELAY_TO_HOST);
+            memcpy(reply + n, &confirm, sizeof(confirm));
+            return n + (int)sizeof(confirm);
+        }
+        if (m_session->Ready() && !m_media->Ready())
+        {
+            int plainLen = m_session->Open(body, bodyLen);
+            if (plainLen <= 0 || !m_media->ImportBroadcast(body + SEAL_SEQ_SIZE, plainLen)) return -1;
+            OPENSSL_cleanse(body, bodyLen);
+        }
+        return -1;
+    }
+
+    // `out` holds RELAY_UP_HEADER_SIZE + SEAL_SEQ_SIZE spare bytes, plainLen
+    // bytes of a wire message, then SEAL_TAG_SIZE spare. Returns the size to send.
+    int SealToHost(uint8_t *out, int plainLen)
+    {
+        int n = WriteUp(out, RELAY_TO_HOST);
+        return n + m_session->Seal(out + n, plainLen);
+    }
+
+private:
+    // Header and cookie of a viewer -> relay datagram.
+    int WriteUp(uint8_t *out, uint8_t type, uint32_t frameId = 0) const
+    {
+        RelayWriteHeader(out, type, m_stream, 0, 0, frameId);
+        memcpy(out + RELAY_HEADER_SIZE, &m_cookie, sizeof(m_cookie));
+        return RELAY_UP_HEADER_SIZE;
+    }
+
+    uint32_t m_stream = 0;
+    uint64_t m_cookie = 0;       // from the relay's last RELAY_COOKIE
+    std::vector<uint8_t> m_last; // last HELLO or JOIN, resent with a new cookie
+    std::unique_ptr<SecureChannel> m_session; // handshake, then viewer -> host
+    std::unique_ptr<SecureChannel> m_media;   // stream key, host -> viewers
+    int m_rejected = 0;
+};
@@ -0,0 +1,289 @@
+// Region-of-interest quality map for the capture loop.
+//
+// The frame is split into TILE x TILE tiles. Each tile gets a weight in
+// [0, 1] from three cues, all in send-space coordinates (g_sendW x g_sendH):
+//   - the cursor position (remote input or local mouse), with a soft falloff
+//   - recent input activity (clicks / keys), which boosts the cursor area
+//   - the foreground window rectangle, unless it covers most of the frame
+//     (a maximised window is no region of interest; the cursor still is)
+// Weights are smoothed over time (fast attack, slow release, both in ms so
+// 1 fps and 60 fps fade alike) and quantised into a few levels with
+// hysteresis so tiles do not flicker between levels.
+//
+// GDI+ JPEG has no per-block quantiser, so RoiPrefilter() spends the bits
+// instead: low-weight tiles are averaged over 2x2 / 4x4 / 8x8 blocks before
+// encoding, which removes the detail JPEG would otherwise pay for, and the
+// host raises the global quality to spend the savings inside the ROI.
+// RoiQuality picks that quality from bytes: frames stay within what the same
+// content costs unfiltered at the baseline quality.
+//
+// Portable: no Windows headers, so it can be built and measured on Linux.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#define ROI_TILE 64
+#define ROI_LEVELS 4 // 0 = full detail, 1 = 2x2, 2 = 4x4, 3 = 8x8 average
+#define ROI_FOCUS_MAX_SHARE 0.5f // larger focus rectangles are ignored
+#define ROI_BUDGET_FRAMES 60     // frames between two measurements of the byte budget
+
+struct RoiRect
+{
+    int x, y, w, h;
+};
+
+class RoiMap
+{
+public:
+    RoiMap(int frameW, int frameH)
+    {
+        Resize(frameW, frameH);
+    }
+
+    void Resize(int frameW, int frameH)
+    {
+        m_frameW = frameW;
+        m_frameH = frameH;
+        m_tilesX = (frameW + ROI_TILE - 1) / ROI_TILE;
+        m_tilesY = (frameH + ROI_TILE - 1) / ROI_TILE;
+        m_weight.assign(m_tilesX * m_tilesY, 1.0f);
+        m_level.assign(m_tilesX * m_tilesY, 0);
+        m_lastUpdateMs = 0;
+    }
+
+    // Cursor moves are cheap and frequent; they only move the centre.
+    void SetCursor(int x, int y)
+    {
+        m_cursorX = x;
+        m_cursorY = y;
+        m_hasCursor = true;
+    }
+
+    // Cursor is on another display.
+    void ClearCursor() { m_hasCursor = false; }
+
+    // Clicks and key presses: the user is actively working around here.
+    void NoteInput(uint64_t nowMs)
+    {
+        m_lastInputMs = nowMs;
+    }
+
+    void SetFocus(const RoiRect &rect)
+    {
+        m_focus = rect;
+        m_hasFocus = rect.w > 0 && rect.h > 0;
+    }
+
+    void ClearFocus() { m_hasFocus = false; }
+
+    // Recomputes target weights and blends them into the smoothed map.
+    // Call once per captured frame, at whatever rate frames come.
+    void Update(uint64_t nowMs)
+    {
+        // Blend by elapsed time, not per call: alpha = 1 - exp(-dt / tau).
+        float dt = m_lastUpdateMs && nowMs >= m_lastUpdateMs ? (float)(nowMs - m_lastUpdateMs) : NOMINAL_FRAME_MS;
+        m_lastUpdateMs = nowMs;
+        float attack = 1.0f - std::exp(-dt / ATTACK_MS);
+        float release = 1.0f - std::exp(-dt / RELEASE_MS);
+        bool focus = m_hasFocus && (float)m_focus.w * m_focus.h <= ROI_FOCUS_MAX_SHARE * m_frameW * m_frameH;
+
+        // Falloff radius scales with the frame so 720p and 4K behave alike.
+        float radius = 0.18f * (float)std::max(m_frameW, m_frameH);
+        float activity = 0.0f;
+        if (m_lastInputMs && nowMs >= m_lastInputMs)
+        {
+            float age = (float)(nowMs - m_lastInputMs);
+            activity = age < ACTIVITY_MS ? 1.0f - age / ACTIVITY_MS : 0.0f;
+        }
+        radius *= 1.0f + 0.5f * activity;
+
+        for (int ty = 0; ty < m_tilesY; ty++)
+        {
+            for (int tx = 0; tx < m_tilesX; tx++)
+            {
+                float cx = (tx + 0.5f) * ROI_TILE;
+                float cy = (ty + 0.5f) * ROI_TILE;
+                float target = BACKGROUND_WEIGHT;
+
+                if (m_hasCursor)
+                {
+                    float dx = cx - m_cursorX, dy = cy - m_cursorY;
+                    float d2 = (dx * dx + dy * dy) / (radius * radius);
+                    target = std::max(target, std::exp(-d2 * 2.0f));
+                }
+                if (focus && cx >= m_focus.x && cx < m_focus.x + m_focus.w && cy >= m_focus.y && cy < m_focus.y + m_focus.h)
+                {
+                    target = std::max(target, FOCUS_WEIGHT);
+                }
+
+                int i = ty * m_tilesX + tx;
+                float alpha = target > m_weight[i] ? attack : release;
+                m_weight[i] += alpha * (target - m_weight[i]);
+                m_level[i] = (uint8_t)Quantise(m_weight[i], m_level[i]);
+            }
+        }
+    }
+
+    int TilesX() const { return m_tilesX; }
+    int TilesY() const { return m_tilesY; }
+    float Weight(int tx, int ty) const { return m_weight[ty * m_tilesX + tx]; }
+    int Level(int tx, int ty) const { return m_level[ty * m_tilesX + tx]; }
+
+private:
+    // Level thresholds on the weight, with a dead band so a tile sitting on
+    // a boundary keeps its level instead of toggling every frame.
+    static int Quantise(float w, int current)
+    {
+        static const float edges[ROI_LEVELS - 1] = {0.7f, 0.45f, 0.2f};
+        const float band = 0.05f;
+        int level = 0;
+        while (level < ROI_LEVELS - 1 && w < edges[level]) level++;
+        if (level == current) return level;
+
+        // Only move when clearly past the edge we would cross.
+        int edge = level > current ? level - 1 : level;
+        float distance = std::fabs(w - edges[edge]);
+        return distance > band ? level : current;
+    }
+
+    // Time constants; at 60 fps they blend 0.6 and 0.08 of the way per frame.
+    static constexpr float ATTACK_MS = 18.0f;
+    static constexpr float RELEASE_MS = 200.0f;
+    static constexpr float NOMINAL_FRAME_MS = 16.0f; // first update, clock going back
+    static constexpr float ACTIVITY_MS = 2000.0f;
+    // Background lands on level 2 (4x4); level 3 is only reached while a
+    // tile fades out, so text far from the cursor stays readable.
+    static constexpr float BACKGROUND_WEIGHT = 0.3f;
+    static constexpr float FOCUS_WEIGHT = 0.8f;
+
+    int m_frameW = 0, m_frameH = 0;
+    int m_tilesX = 0, m_tilesY = 0;
+    std::vector<float> m_weight;
+    std::vector<uint8_t> m_level;
+    uint64_t m_lastUpdateMs = 0;
+
+    int m_cursorX = 0, m_cursorY = 0;
+    bool m_hasCursor = false;
+    uint64_t m_lastInputMs = 0;
+    RoiRect m_focus{0, 0, 0, 0};
+    bool m_hasFocus = false;
+};
+
+// Global JPEG quality for prefiltered frames. The budget is what the frame
+// would cost unfiltered at the baseline quality (the host encodes one such
+// frame every ROI_BUDGET_FRAMES); each encoded size then steps the quality
+// down at once when over it, up by one when clearly under. The floor is the
+// baseline itself, where a prefiltered frame is never larger.
+class RoiQuality
+{
+public:
+    RoiQuality(int minQuality, int maxQuality) : m_min(minQuality), m_max(maxQuality), m_quality(minQuality) {}
+
+    // New frame size: the old budget and quality mean nothing.
+    void Reset()
+    {
+        m_quality = m_min;
+        m_budget = 0;
+        m_sinceBudget = 0;
+    }
+
+    int Quality() const { return m_quality; }
+    size_t Budget() const { return m_budget; }
+
+    // Time to encode a baseline frame and call SetBudget().
+    bool NeedsBudget() const { return m_budget == 0 || m_sinceBudget >= ROI_BUDGET_FRAMES; }
+
+    void SetBudget(size_t bytes)
+    {
+        m_budget = std::max<size_t>(bytes, 1);
+        m_sinceBudget = 0;
+    }
+
+    // Size of the frame just encoded at Quality().
+    void Observe(size_t bytes)
+    {
+        m_sinceBudget++;
+        if (!m_budget) return;
+        double ratio = (double)bytes / m_budget;
+        if (ratio > 1.0) m_quality -= std::min(MAX_STEP, 1 + (int)((ratio - 1.0) * 40.0));
+        else if (ratio < 0.96) m_quality++;
+        m_quality = std::max(m_min, std::min(m_max, m_quality));
+    }
+
+private:
+    static constexpr int MAX_STEP = 15;
+
+    int m_min, m_max, m_quality;
+    size_t m_budget = 0;
+    int m_sinceBudget = 0;
+};
+
+// Averages each tile over (1 << level) square blocks, in place, on 32-bit
+// BGRX pixels. Level-0 tiles (the ROI) are not touched at all.
+// OPTIMIZATION: Walks a whole band of block rows across all tiles so memory
+// is swept line by line instead of tile by tile.
+inline void RoiPrefilter(uint8_t *pixels, int width, int height, int stride, const RoiMap &map)
+{
+    const int maxBlock = 1 << (ROI_LEVELS - 1);
+    for (int ty = 0; ty < map.TilesY(); ty++)
+    {
+        int y0 = ty * ROI_TILE, y1 = std::min(y0 + ROI_TILE, height);
+        for (int by = y0; by < y1; by += maxBlock)
+        {
+            for (int tx = 0; tx < map.TilesX(); tx++)
+            {
+                int level = map.Level(tx, ty);
+                if (level == 0) continue;
+                int block = 1 << level;
+                int x0 = tx * ROI_TILE, x1 = std::min(x0 + ROI_TILE, width);
+                int bandEnd = std::min(by + maxBlock, y1);
+
+                for (int sy = by; sy < bandEnd; sy += block)
+                {
+                    int bh = std::min(block, bandEnd - sy);
+                    for (int bx = x0; bx < x1; bx += block)
+                    {
+                        int bw = std::min(block, x1 - bx);
+                        // Blue/red share one accumulator (16 bits each is
+                        // enough for 64 pixels), green gets its own.
+                        uint32_t rb = 0, g = 0;
+                        for (int y = sy; y < sy + bh; y++)
+                        {
+                            const uint32_t *p = (const uint32_t *)(pixels + (size_t)y * stride) + bx;
+                            for (int x = 0; x < bw; x++)
+                            {
+                                rb += p[x] & 0x00ff00ffu;
+                                g += (p[x] >> 8) & 0xffu;
+                            }
+                        }
+                        unsigned n = bw * bh;
+                        uint32_t b8, g8, r8;
+                        if (n == (unsigned)(block * block))
+                        {
+                            int shift = 2 * level;
+                            b8 = (rb & 0xffffu) >> shift;
+                            r8 = (rb >> 16) >> shift;
+                            g8 = g >> shift;
+                        }
+                        else
+                        {
+                            b8 = (rb & 0xffffu) / n;
+                            r8 = (rb >> 16) / n;
+                            g8 = g / n;
+                        }
+                        uint32_t fill = b8 | (g8 << 8) | (r8 << 16) | 0xff000000u;
+                        for (int y = sy; y < sy + bh; y++)
+                        {
+                            uint32_t *p = (uint32_t *)(pixels + (size_t)y * stride) + bx;
+                            for (int x = 0; x < bw; x++) p[x] = fill;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
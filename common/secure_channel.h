@@ -0,0 +1,431 @@
+// Encrypted transport shared by host.cpp, client.cpp and the native library.
+//
+// Session start (3 datagrams, all on the existing ports):
+//   client -> host   HELLO    X25519 public key + nonce
+//   host   -> client REPLY    X25519 public key + nonce + HMAC(deviceKey, transcript)
+//   client -> host   CONFIRM  HMAC(deviceKey, transcript)
+// deviceKey is now only a pre-shared secret for authenticating the exchange;
+// it never goes on the wire. Both directions get their own key from
+// HKDF(ECDH secret, salt = deviceKey, info = transcript).
+//
+// Any of the three may be lost. The client re-sends the same HELLO until a
+// REPLY verifies, and the host answers a repeated HELLO with the REPLY it
+// already sent rather than new keys. A REPLY that does not verify (stale,
+// forged) is ignored; only HANDSHAKE_TIMEOUT_MS of them and no good one
+// means a wrong deviceKey. The client re-sends CONFIRM every
+// HANDSHAKE_CONFIRM_RESEND_MS until the first sealed datagram opens.
+//
+// Every datagram afterwards is sealed with AES-256-GCM (AES-NI + PCLMUL inside
+// OpenSSL) or ChaCha20-Poly1305 when either side lacks AES-NI:
+//   [seq 8 bytes LE][ciphertext ...][tag 16]
+// The nonce is a per-direction 4-byte salt + seq, so it is never reused, and a
+// 64-packet window drops replays.
+//
+// Through a relay (common/relay_session.h) the host seals media once, under
+// a random stream key (InitBroadcast), for every viewer. Each viewer still
+// runs the handshake above with the host and then receives the stream key
+// sealed under its own session (HandshakeStreamKey, ImportBroadcast).
+//
+// Link with -lcrypto.
+
+#pragma once
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/kdf.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#define HANDSHAKE_MAGIC 0x31434452 // "RDC1"
+#define HS_HELLO 1
+#define HS_REPLY 2
+#define HS_CONFIRM 3
+#define HS_STREAM_KEY 4
+
+#define HANDSHAKE_TIMEOUT_MS 10000
+#define HANDSHAKE_CONFIRM_RESEND_MS 250
+
+#define CIPHER_AES_GCM 1
+#define CIPHER_CHACHA20_POLY1305 2
+
+#define SEAL_SEQ_SIZE 8
+#define SEAL_TAG_SIZE 16
+#define SEAL_OVERHEAD (SEAL_SEQ_SIZE + SEAL_TAG_SIZE)
+
+#pragma pack(push, 1)
+struct HandshakeHello
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t cipherPref;
+    uint8_t pub[32];
+    uint8_t nonce[16];
+};
+
+struct HandshakeReply
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t cipher;
+    uint8_t pub[32];
+    uint8_t nonce[16];
+    uint8_t mac[32];
+};
+
+struct HandshakeConfirm
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t mac[32];
+};
+
+// Host -> viewer after CONFIRM, sealed under that viewer's session.
+struct HandshakeStreamKey
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t cipher;
+    uint8_t key[32];
+    uint8_t salt[4];
+};
+#pragma pack(pop)
+
+// Best cipher for this CPU. AES-GCM is only faster with hardware AES.
+inline uint8_t PreferredCipher()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul")) ? CIPHER_AES_GCM : CIPHER_CHACHA20_POLY1305;
+#else
+    return CIPHER_AES_GCM;
+#endif
+}
+
+class SecureChannel
+{
+public:
+    SecureChannel() = default;
+    SecureChannel(const SecureChannel &) = delete;
+    SecureChannel &operator=(const SecureChannel &) = delete;
+
+    ~SecureChannel()
+    {
+        EVP_PKEY_free(m_local);
+        EVP_CIPHER_CTX_free(m_sendCtx);
+        EVP_CIPHER_CTX_free(m_recvCtx);
+        OPENSSL_cleanse(m_confirmMac, sizeof(m_confirmMac));
+        OPENSSL_cleanse(m_broadcastKey, sizeof(m_broadcastKey));
+    }
+
+    bool Ready() const { return m_ready; }
+    uint8_t Cipher() const { return m_cipher; }
+
+    // --- CLIENT SIDE ---
+    bool BeginClient(const std::string &psk, HandshakeHello *out)
+    {
+        m_psk = psk;
+        m_ready = false;
+        if (!GenerateKey()) return false;
+        out->magic = HANDSHAKE_MAGIC;
+        out->type = HS_HELLO;
+        out->cipherPref = PreferredCipher();
+        if (!PublicKey(out->pub)) return false;
+        RAND_bytes(out->nonce, sizeof(out->nonce));
+        m_hello = *out;
+        return true;
+    }
+
+    bool FinishClient(const void *data, int len, HandshakeConfirm *out)
+    {
+        if (len != (int)sizeof(HandshakeReply) || !m_local) return false;
+        HandshakeReply reply;
+        memcpy(&reply, data, sizeof(reply));
+        if (reply.magic != HANDSHAKE_MAGIC || reply.type != HS_REPLY) return false;
+        if (reply.cipher != CIPHER_AES_GCM && reply.cipher != CIPHER_CHACHA20_POLY1305) return false;
+
+        uint8_t expected[32];
+        TranscriptMac("host", m_hello, reply, expected);
+        if (CRYPTO_memcmp(expected, reply.mac, sizeof(expected)) != 0) return false;
+
+        if (!DeriveKeys(reply.pub, m_hello, reply, false)) return false;
+
+        out->magic = HANDSHAKE_MAGIC;
+        out->type = HS_CONFIRM;
+        TranscriptMac("client", m_hello, reply, out->mac);
+        m_ready = true;
+        return true;
+    }
+
+    // --- HOST SIDE ---
+    bool AcceptHello(const std::string &psk, const void *data, int len, HandshakeReply *out)
+    {
+        if (len != (int)sizeof(HandshakeHello)) return false;
+        HandshakeHello hello;
+        memcpy(&hello, data, sizeof(hello));
+        if (hello.magic != HANDSHAKE_MAGIC || hello.type != HS_HELLO) return false;
+
+        m_psk = psk;
+        m_ready = false;
+        if (!GenerateKey()) return false;
+
+        out->magic = HANDSHAKE_MAGIC;
+        out->type = HS_REPLY;
+        out->cipher = (hello.cipherPref == CIPHER_AES_GCM && PreferredCipher() == CIPHER_AES_GCM) ? CIPHER_AES_GCM : CIPHER_CHACHA20_POLY1305;
+        if (!PublicKey(out->pub)) return false;
+        RAND_bytes(out->nonce, sizeof(out->nonce));
+        TranscriptMac("host", hello, *out, out->mac);
+
+        if (!DeriveKeys(hello.pub, hello, *out, true)) return false;
+        TranscriptMac("client", hello, *out, m_confirmMac);
+        return true;
+    }
+
+    // Only after a valid CONFIRM does the host know the peer holds deviceKey.
+    bool AcceptConfirm(const void *data, int len)
+    {
+        if (len != (int)sizeof(HandshakeConfirm) || !m_sendCtx) return false;
+        HandshakeConfirm confirm;
+        memcpy(&confirm, data, sizeof(confirm));
+        if (confirm.magic != HANDSHAKE_MAGIC || confirm.type != HS_CONFIRM) return false;
+        if (CRYPTO_memcmp(confirm.mac, m_confirmMac, sizeof(m_confirmMac)) != 0) return false;
+        m_ready = true;
+        return true;
+    }
+
+    // --- BROADCAST (one stream, many viewers) ---
+    // Host: a fresh random key to seal this session's media with. Send only.
+    bool InitBroadcast()
+    {
+        m_cipher = PreferredCipher();
+        if (RAND_bytes(m_broadcastKey, sizeof(m_broadcastKey)) != 1 || RAND_bytes(m_sendSalt, sizeof(m_sendSalt)) != 1) return false;
+        SetKeys(m_broadcastKey, NULL);
+        m_ready = true;
+        return true;
+    }
+
+    // Host: the stream key for one viewer. Seal it with that viewer's session.
+    void ExportBroadcast(HandshakeStreamKey *out) const
+    {
+        out->magic = HANDSHAKE_MAGIC;
+        out->type = HS_STREAM_KEY;
+        out->cipher = m_cipher;
+        memcpy(out->key, m_broadcastKey, sizeof(out->key));
+        memcpy(out->salt, m_sendSalt, sizeof(out->salt));
+    }
+
+    // Viewer: receive-only channel for the host's stream.
+    bool ImportBroadcast(const void *data, int len)
+    {
+        if (len != (int)sizeof(HandshakeStreamKey)) return false;
+        HandshakeStreamKey msg;
+        memcpy(&msg, data, sizeof(msg));
+        if (msg.magic != HANDSHAKE_MAGIC || msg.type != HS_STREAM_KEY) return false;
+        if (msg.cipher != CIPHER_AES_GCM && msg.cipher != CIPHER_CHACHA20_POLY1305) return false;
+        m_cipher = msg.cipher;
+        memcpy(m_recvSalt, msg.salt, sizeof(m_recvSalt));
+        SetKeys(NULL, msg.key);
+        OPENSSL_cleanse(&msg, sizeof(msg));
+        m_ready = true;
+        return true;
+    }
+
+    // --- DATAGRAMS ---
+    // `datagram` holds SEAL_SEQ_SIZE spare bytes, then plainLen bytes of
+    // plaintext, then SEAL_TAG_SIZE spare bytes. Encrypts in place and returns
+    // the size to send. Only one thread may seal.
+    int Seal(uint8_t *datagram, int plainLen)
+    {
+        uint64_t seq = m_sendSeq++;
+        for (int i = 0; i < 8; i++) datagram[i] = (uint8_t)(seq >> (8 * i));
+
+        uint8_t iv[12];
+        MakeIv(m_sendSalt, datagram, iv);
+
+        int outLen = 0;
+        uint8_t *body = datagram + SEAL_SEQ_SIZE;
+        EVP_EncryptInit_ex(m_sendCtx, NULL, NULL, NULL, iv);
+        EVP_EncryptUpdate(m_sendCtx, NULL, &outLen, datagram, SEAL_SEQ_SIZE);
+        EVP_EncryptUpdate(m_sendCtx, body, &outLen, body, plainLen);
+        EVP_EncryptFinal_ex(m_sendCtx, body + outLen, &outLen);
+        EVP_CIPHER_CTX_ctrl(m_sendCtx, EVP_CTRL_AEAD_GET_TAG, SEAL_TAG_SIZE, body + plainLen);
+        return SEAL_OVERHEAD + plainLen;
+    }
+
+    // Seals every chunk of a frame in one pass before the burst goes out, so
+    // the send loop never interleaves crypto with sendto().
+    void SealBatch(uint8_t *arena, int slotSize, const int *plainLens, int *sealedLens, int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            sealedLens[i] = Seal(arena + (size_t)i * slotSize, plainLens[i]);
+        }
+    }
+
+    // Verifies and decrypts in place. Returns the plaintext length (plaintext
+    // starts at datagram + SEAL_SEQ_SIZE) or -1 for anything forged, replayed
+    // or truncated. Only one thread may open.
+    int Open(uint8_t *datagram, int len)
+    {
+        if (!m_ready || !m_recvCtx || len < SEAL_OVERHEAD) return -1;
+        uint64_t seq = 0;
+        for (int i = 0; i < 8; i++) seq |= (uint64_t)datagram[i] << (8 * i);
+        if (!ReplayCheck(seq, false)) return -1;
+
+        uint8_t iv[12];
+        MakeIv(m_recvSalt, datagram, iv);
+
+        int plainLen = len - SEAL_OVERHEAD;
+        uint8_t *body = datagram + SEAL_SEQ_SIZE;
+        int outLen = 0;
+        EVP_DecryptInit_ex(m_recvCtx, NULL, NULL, NULL, iv);
+        EVP_DecryptUpdate(m_recvCtx, NULL, &outLen, datagram, SEAL_SEQ_SIZE);
+        EVP_DecryptUpdate(m_recvCtx, body, &outLen, body, plainLen);
+        EVP_CIPHER_CTX_ctrl(m_recvCtx, EVP_CTRL_AEAD_SET_TAG, SEAL_TAG_SIZE, body + plainLen);
+        if (EVP_DecryptFinal_ex(m_recvCtx, body + outLen, &outLen) <= 0) return -1;
+
+        ReplayCheck(seq, true);
+        return plainLen;
+    }
+
+private:
+    bool GenerateKey()
+    {
+        EVP_PKEY_free(m_local);
+        m_local = NULL;
+        EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, NULL);
+        bool ok = ctx && EVP_PKEY_keygen_init(ctx) > 0 && EVP_PKEY_keygen(ctx, &m_local) > 0;
+        EVP_PKEY_CTX_free(ctx);
+        return ok;
+    }
+
+    bool PublicKey(uint8_t *out)
+    {
+        size_t len = 32;
+        return EVP_PKEY_get_raw_public_key(m_local, out, &len) > 0 && len == 32;
+    }
+
+    void TranscriptMac(const char *label, const HandshakeHello &hello, const HandshakeReply &reply, uint8_t *out)
+    {
+        uint8_t msg[sizeof(HandshakeHello) + sizeof(HandshakeReply) + 8];
+        size_t labelLen = strlen(label);
+        size_t n = 0;
+        memcpy(msg + n, label, labelLen); n += labelLen;
+        memcpy(msg + n, &hello, sizeof(hello)); n += sizeof(hello);
+        memcpy(msg + n, &reply, offsetof(HandshakeReply, mac)); n += offsetof(HandshakeReply, mac);
+        unsigned int macLen = 32;
+        HMAC(EVP_sha256(), m_psk.data(), (int)m_psk.size(), msg, n, out, &macLen);
+    }
+
+    bool DeriveKeys(const uint8_t *peerPub, const HandshakeHello &hello, const HandshakeReply &reply, bool isHost)
+    {
+        uint8_t shared[32];
+        size_t sharedLen = sizeof(shared);
+        EVP_PKEY *peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, NULL, peerPub, 32);
+        EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(m_local, NULL);
+        bool ok = peer && ctx && EVP_PKEY_derive_init(ctx) > 0 && EVP_PKEY_derive_set_peer(ctx, peer) > 0 &&
+                  EVP_PKEY_derive(ctx, shared, &sharedLen) > 0;
+        EVP_PKEY_CTX_free(ctx);
+        EVP_PKEY_free(peer);
+        if (!ok) return false;
+
+        // okm = host->client key | client->host key | host salt | client salt
+        uint8_t okm[32 + 32 + 4 + 4];
+        uint8_t info[sizeof(HandshakeHello) + offsetof(HandshakeReply, mac)];
+        memcpy(info, &hello, sizeof(hello));
+        memcpy(info + sizeof(hello), &reply, offsetof(HandshakeReply, mac));
+
+        size_t okmLen = sizeof(okm);
+        EVP_PKEY_CTX *kdf = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+        ok = kdf && EVP_PKEY_derive_init(kdf) > 0 &&
+             EVP_PKEY_CTX_set_hkdf_md(kdf, EVP_sha256()) > 0 &&
+             EVP_PKEY_CTX_set1_hkdf_salt(kdf, (const unsigned char *)m_psk.data(), (int)m_psk.size()) > 0 &&
+             EVP_PKEY_CTX_set1_hkdf_key(kdf, shared, (int)sharedLen) > 0 &&
+             EVP_PKEY_CTX_add1_hkdf_info(kdf, info, (int)sizeof(info)) > 0 &&
+             EVP_PKEY_derive(kdf, okm, &okmLen) > 0;
+        EVP_PKEY_CTX_free(kdf);
+        OPENSSL_cleanse(shared, sizeof(shared));
+        if (!ok) return false;
+
+        m_cipher = reply.cipher;
+        memcpy(m_sendSalt, isHost ? okm + 64 : okm + 68, 4);
+        memcpy(m_recvSalt, isHost ? okm + 68 : okm + 64, 4);
+        SetKeys(isHost ? okm : okm + 32, isHost ? okm + 32 : okm);
+        OPENSSL_cleanse(okm, sizeof(okm));
+        return true;
+    }
+
+    // NULL leaves that direction without a key.
+    void SetKeys(const uint8_t *sendKey, const uint8_t *recvKey)
+    {
+        // OPTIMIZATION: Key schedule runs once per session, not per packet.
+        const EVP_CIPHER *cipher = m_cipher == CIPHER_AES_GCM ? EVP_aes_256_gcm() : EVP_chacha20_poly1305();
+        EVP_CIPHER_CTX_free(m_sendCtx);
+        EVP_CIPHER_CTX_free(m_recvCtx);
+        m_sendCtx = m_recvCtx = NULL;
+        if (sendKey)
+        {
+            m_sendCtx = EVP_CIPHER_CTX_new();
+            EVP_EncryptInit_ex(m_sendCtx, cipher, NULL, NULL, NULL);
+            EVP_CIPHER_CTX_ctrl(m_sendCtx, EVP_CTRL_AEAD_SET_IVLEN, 12, NULL);
+            EVP_EncryptInit_ex(m_sendCtx, NULL, NULL, sendKey, NULL);
+        }
+        if (recvKey)
+        {
+            m_recvCtx = EVP_CIPHER_CTX_new();
+            EVP_DecryptInit_ex(m_recvCtx, cipher, NULL, NULL, NULL);
+            EVP_CIPHER_CTX_ctrl(m_recvCtx, EVP_CTRL_AEAD_SET_IVLEN, 12, NULL);
+            EVP_DecryptInit_ex(m_recvCtx, NULL, NULL, recvKey, NULL);
+        }
+
+        m_sendSeq = 0;
+        m_recvHighest = 0;
+        m_recvWindow = 0;
+    }
+
+    static void MakeIv(const uint8_t *salt, const uint8_t *seq, uint8_t *iv)
+    {
+        memcpy(iv, salt, 4);
+        memcpy(iv + 4, seq, 8);
+    }
+
+    // Sliding window over the last 64 sequence numbers (datagrams may arrive
+    // slightly out of order). `commit` only after the tag verified.
+    bool ReplayCheck(uint64_t seq, bool commit)
+    {
+        if (m_recvWindow != 0 && seq <= m_recvHighest)
+        {
+            uint64_t age = m_recvHighest - seq;
+            if (age >= 64 || (m_recvWindow & (1ULL << age))) return false;
+            if (commit) m_recvWindow |= 1ULL << age;
+            return true;
+        }
+        if (commit)
+        {
+            uint64_t shift = m_recvWindow == 0 ? 64 : seq - m_recvHighest;
+            m_recvWindow = shift >= 64 ? 1 : (m_recvWindow << shift) | 1;
+            m_recvHighest = seq;
+        }
+        return true;
+    }
+
+    std::string m_psk;
+    EVP_PKEY *m_local = NULL;
+    HandshakeHello m_hello{};
+    uint8_t m_confirmMac[32]{};
+    uint8_t m_broadcastKey[32]{};
+    bool m_ready = false;
+    uint8_t m_cipher = 0;
+
+    EVP_CIPHER_CTX *m_sendCtx = NULL;
+    EVP_CIPHER_CTX *m_recvCtx = NULL;
+    uint8_t m_sendSalt[4]{};
+    uint8_t m_recvSalt[4]{};
+    uint64_t m_sendSeq = 0;
+    uint64_t m_recvHighest = 0;
+    uint64_t m_recvWindow = 0;
+};
@@ -0,0 +1,421 @@
+// Session recording: append-only capture file + keyframe index.
+//
+// <name>.rdcrec   FileHeader, then records back to back:
+//                 RecordHeader { type, size, timestampUs } + payload
+//                   REC_FRAME  FrameInfo + encoded frame bytes (JPEG)
+//                   REC_INPUT  InputRecord (what the client sent)
+// <name>.rdcrec.idx  IndexEntry { timestampUs, offset } for a keyframe at
+//                 least every INDEX_INTERVAL_US. Fixed-size entries sorted by
+//                 time, so a reader mmaps it and binary-searches.
+//
+// SessionRecorder never blocks the caller on disk I/O: records are copied into
+// pooled buffers and handed to a writer thread. If the disk cannot keep up and
+// the queue passes MAX_QUEUED_BYTES, frames are dropped (and counted) rather
+// than stalling the send loop.
+//
+// SessionReader maps both files read-only and seeks in O(log n).
+//
+// Portable: used by host.cpp, tools/rdc_player.cpp and bench/bench_record.cpp.
+
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define REC_MAGIC "RDCREC1"
+#define REC_VERSION 2 // 2: display index on frames and input
+#define REC_FRAME 1
+#define REC_INPUT 2
+#define INDEX_INTERVAL_US 500000 // one index entry per 0.5 s of keyframes
+#define MAX_QUEUED_BYTES (64 * 1024 * 1024)
+
+#pragma pack(push, 1)
+struct RecFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t startUnixMs;
+};
+
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t size; // payload bytes after this header
+    uint64_t timestampUs;
+};
+
+struct FrameInfo
+{
+    int32_t width;
+    int32_t height;
+    uint32_t keyframe; // GDI frames are all full JPEGs, so always 1 there
+    int32_t display;   // host display index (wire frame chunk display)
+};
+
+struct InputRecord
+{
+    int32_t type;
+    int32_t x;
+    int32_t y;
+    int32_t key;
+    int32_t display;
+};
+
+struct IndexEntry
+{
+    uint64_t timestampUs;
+    uint64_t offset; // of the RecordHeader in the .rdcrec file
+};
+#pragma pack(pop)
+
+class SessionRecorder
+{
+public:
+    ~SessionRecorder() { Close(); }
+
+    bool Open(const std::string &path)
+    {
+        m_file = fopen(path.c_str(), "wb");
+        m_index = fopen((path + ".idx").c_str(), "wb");
+        if (!m_file || !m_index)
+        {
+            Close();
+            return false;
+        }
+        // OPTIMIZATION: Large stdio buffer, the writer thread issues few syscalls.
+        setvbuf(m_file, NULL, _IOFBF, 1 << 20);
+
+        RecFileHeader header{};
+        memcpy(header.magic, REC_MAGIC, sizeof(header.magic));
+        header.version = REC_VERSION;
+        header.startUnixMs = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch()).count();
+        fwrite(&header, sizeof(header), 1, m_file);
+        m_offset = sizeof(header);
+
+        m_start = std::chrono::steady_clock::now();
+        m_running = true;
+        m_writer = std::thread(&SessionRecorder::WriterLoop, this);
+        return true;
+    }
+
+    bool IsOpen() const { return m_running; }
+
+    // Microseconds since Open(); the time base of every record.
+    uint64_t Now() const
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+    void RecordFrame(const void *data, int size, int width, int height, bool keyframe = true, int display = 0)
+    {
+        RecordFrameAt(Now(), data, size, width, height, keyframe, display);
+    }
+
+    void RecordInput(int type, int x, int y, int key, int display = 0)
+    {
+        InputRecord input{type, x, y, key, display};
+        Enqueue(Now(), REC_INPUT, &input, sizeof(input), NULL, 0, false);
+    }
+
+    // Explicit timestamp, for tools that re-encode or synthesise recordings.
+    void RecordFrameAt(uint64_t timestampUs, const void *data, int size, int width, int height, bool keyframe = true, int display = 0)
+    {
+        FrameInfo info{width, height, keyframe ? 1u : 0u, display};
+        Enqueue(timestampUs, REC_FRAME, &info, sizeof(info), data, size, keyframe);
+    }
+
+    // Flushes everything queued so far and stops the writer.
+    void Close()
+    {
+        if (m_running)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_running = false;
+            }
+            m_wake.notify_one();
+            m_writer.join();
+        }
+        if (m_file) fclose(m_file);
+        if (m_index) fclose(m_index);
+        m_file = m_index = NULL;
+    }
+
+    uint64_t Dropped() const { return m_dropped; }
+    uint64_t Written() const { return m_written; }
+
+private:
+    struct Pending
+    {
+        std::vector<uint8_t> bytes; // RecordHeader + payload
+        bool keyframe;
+    };
+
+    // An input record may overtake a frame that is still being copied, so the
+    // file is only roughly time-ordered. Seek() relies on keyframes alone.
+    // With several display streams those can also be a few microseconds out
+    // of order; the writer only indexes a keyframe that is later than the
+    // previous entry, so the index itself stays sorted.
+    void Enqueue(uint64_t timestampUs, uint32_t type, const void *prefix, int prefixLen, const void *data, int size, bool keyframe)
+    {
+        if (!m_running) return;
+        RecordHeader header{type, (uint32_t)(prefixLen + size), timestampUs};
+        size_t total = sizeof(header) + prefixLen + size;
+
+        std::unique_lock<std::mutex> guard(m_lock);
+        if (m_queuedBytes + total > MAX_QUEUED_BYTES)
+        {
+            m_dropped++;
+            return;
+        }
+
+        // Reuse a buffer the writer already finished with (no allocation in
+        // steady state). The copy itself happens outside the lock.
+        Pending item;
+        if (!m_free.empty())
+        {
+            item.bytes.swap(m_free.back());
+            m_free.pop_back();
+        }
+        m_queuedBytes += total;
+        guard.unlock();
+
+        item.bytes.resize(total);
+        item.keyframe = keyframe;
+        memcpy(item.bytes.data(), &header, sizeof(header));
+        memcpy(item.bytes.data() + sizeof(header), prefix, prefixLen);
+        if (size > 0) memcpy(item.bytes.data() + sizeof(header) + prefixLen, data, size);
+
+        guard.lock();
+        m_queue.push_back(std::move(item));
+        guard.unlock();
+        m_wake.notify_one();
+    }
+
+    void WriterLoop()
+    {
+        std::deque<Pending> batch;
+        uint64_t lastIndexUs = 0;
+        bool anyIndexed = false;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(m_lock);
+                m_wake.wait(guard, [this] { return !m_queue.empty() || !m_running; });
+                if (m_queue.empty() && !m_running) break;
+                batch.swap(m_queue);
+            }
+
+            for (Pending &item : batch)
+            {
+                RecordHeader header;
+                memcpy(&header, item.bytes.data(), sizeof(header));
+                if (item.keyframe && (!anyIndexed || header.timestampUs >= lastIndexUs + INDEX_INTERVAL_US))
+                {
+                    IndexEntry entry{header.timestampUs, m_offset};
+                    fwrite(&entry, sizeof(entry), 1, m_index);
+                    lastIndexUs = header.timestampUs;
+                    anyIndexed = true;
+                }
+                fwrite(item.bytes.data(), 1, item.bytes.size(), m_file);
+                m_offset += item.bytes.size();
+                m_written++;
+            }
+            // Index entries must never point past what is on disk.
+            fflush(m_file);
+            fflush(m_index);
+
+            std::lock_guard<std::mutex> guard(m_lock);
+            for (Pending &item : batch)
+            {
+                m_queuedBytes -= item.bytes.size();
+                if (m_free.size() < 64) m_free.push_back(std::move(item.bytes));
+            }
+            batch.clear();
+        }
+    }
+
+    FILE *m_file = NULL;
+    FILE *m_index = NULL;
+    uint64_t m_offset = 0;
+    std::chrono::steady_clock::time_point m_start;
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::deque<Pending> m_queue;
+    std::vector<std::vector<uint8_t>> m_free;
+    size_t m_queuedBytes = 0;
+    std::thread m_writer;
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_written{0};
+};
+
+// Read-only mapping of a file, released on destruction.
+class MappedFile
+{
+public:
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string &path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+        if (m_file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        GetFileSizeEx(m_file, &size);
+        m_size = (size_t)size.QuadPart;
+        if (m_size == 0) return true;
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping) return false;
+        m_data = (const uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        return m_data != NULL;
+#else
+        m_fd = open(path.c_str(), O_RDONLY);
+        if (m_fd < 0) return false;
+        struct stat st;
+        fstat(m_fd, &st);
+        m_size = (size_t)st.st_size;
+        if (m_size == 0) return true;
+        void *p = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (p == MAP_FAILED) return false;
+        m_data = (const uint8_t *)p;
+        return true;
+#endif
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (m_data) UnmapViewOfFile(m_data);
+        if (m_mapping) CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+        m_mapping = NULL;
+        m_file = INVALID_HANDLE_VALUE;
+#else
+        if (m_data) munmap((void *)m_data, m_size);
+        if (m_fd >= 0) close(m_fd);
+        m_fd = -1;
+#endif
+        m_data = NULL;
+        m_size = 0;
+    }
+
+    const uint8_t *Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const uint8_t *m_data = NULL;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
+
+// One record as seen by the reader: points straight into the mapping.
+struct RecordView
+{
+    uint32_t type;
+    uint64_t timestampUs;
+    const uint8_t *payload;
+    uint32_t size;
+    uint64_t offset;
+};
+
+class SessionReader
+{
+public:
+    bool Open(const std::string &path)
+    {
+        if (!m_rec.Open(path) || m_rec.Size() < sizeof(RecFileHeader)) return false;
+        memcpy(&m_header, m_rec.Data(), sizeof(m_header));
+        if (memcmp(m_header.magic, REC_MAGIC, sizeof(m_header.magic)) != 0 || m_header.version != REC_VERSION) return false;
+        // A missing index only costs seek speed; Seek() falls back to a scan.
+        m_idx.Open(path + ".idx");
+        return true;
+    }
+
+    const RecFileHeader &Header() const { return m_header; }
+    size_t IndexEntries() const { return m_idx.Size() / sizeof(IndexEntry); }
+
+    // Reads the record at `offset`. Returns false past the end or on a
+    // truncated tail (a recording cut off by a crash).
+    bool At(uint64_t offset, RecordView *out) const
+    {
+        if (offset + sizeof(RecordHeader) > m_rec.Size()) return false;
+        RecordHeader header;
+        memcpy(&header, m_rec.Data() + offset, sizeof(header));
+        if (header.size > m_rec.Size() - offset - sizeof(header)) return false;
+        out->type = header.type;
+        out->timestampUs = header.timestampUs;
+        out->payload = m_rec.Data() + offset + sizeof(header);
+        out->size = header.size;
+        out->offset = offset;
+        return true;
+    }
+
+    uint64_t First() const { return sizeof(RecFileHeader); }
+    uint64_t Next(const RecordView &rec) const { return rec.offset + sizeof(RecordHeader) + rec.size; }
+
+    // Offset of the last keyframe at or before `timestampUs`: binary search on
+    // the index, then a short forward scan (at most INDEX_INTERVAL_US of
+    // records) for a closer keyframe.
+    uint64_t Seek(uint64_t timestampUs) const
+    {
+        const IndexEntry *entries = (const IndexEntry *)m_idx.Data();
+        size_t count = IndexEntries();
+        uint64_t start = First();
+        if (count > 0)
+        {
+            const IndexEntry *it = std::upper_bound(entries, entries + count, timestampUs,
+                                                    [](uint64_t t, const IndexEntry &e) { return t < e.timestampUs; });
+            if (it != entries) start = (it - 1)->offset;
+        }
+
+        uint64_t best = start;
+        RecordView rec;
+        for (uint64_t off = start; At(off, &rec) && rec.timestampUs <= timestampUs; off = Next(rec))
+        {
+            if (IsKeyframe(rec)) best = off;
+        }
+        return best;
+    }
+
+    static bool IsKeyframe(const RecordView &rec)
+    {
+        if (rec.type != REC_FRAME || rec.size < sizeof(FrameInfo)) return false;
+        FrameInfo info;
+        memcpy(&info, rec.payload, sizeof(info));
+        return info.keyframe != 0;
+    }
+
+private:
+    MappedFile m_rec;
+    MappedFile m_idx;
+    RecFileHeader m_header{};
+};
@@ -0,0 +1,374 @@
+// Per-display capture/encode streams, one worker thread each.
+//
+// host.cpp creates one StreamPipeline per monitor (GDI capture + GDI+ JPEG),
+// bench/bench_streams.cpp creates synthetic ones (generated pixels + libjpeg).
+// The scheduler itself knows nothing about GDI: it owns the threads, pins
+// each one to its own core, paces it with a FrameGovernor (maxFps while the
+// display changes, slow polls while idle), skips frames whose tiles did not
+// change (DirtyTracker) and keeps per-stream stats.
+//
+// Portable: Win32 threads affinity via SetThreadAffinityMask, Linux via
+// pthread_setaffinity_np.
+
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include "frame_governor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define DIRTY_TILE 64
+// Idle polls hash every SAMPLE_ROW_STEP-th row only (SampledChecksum).
+#define SAMPLE_ROW_STEP 4
+
+// Hash of columns [x0, x1) of rows y0, y0 + yStep, ... < y1 of a BGRX frame.
+inline uint64_t HashPixels(const uint8_t *pixels, int stride, int x0, int x1, int y0, int y1, int yStep)
+{
+    // OPTIMIZATION: four independent lanes, so the multiplies overlap
+    // instead of waiting on each other.
+    uint64_t h0 = 0x9e3779b97f4a7c15ull, h1 = 0xc2b2ae3d27d4eb4full, h2 = 0x165667b19e3779f9ull, h3 = 0x27d4eb2f165667c5ull;
+    int bytes = (x1 - x0) * 4;
+    for (int y = y0; y < y1; y += yStep)
+    {
+        const uint8_t *row = pixels + (size_t)y * stride + x0 * 4;
+        int i = 0;
+        for (; i + 32 <= bytes; i += 32)
+        {
+            uint64_t v[4];
+            memcpy(v, row + i, 32);
+            h0 = (h0 ^ v[0]) * 0x100000001b3ull;
+            h1 = (h1 ^ v[1]) * 0x100000001b3ull;
+            h2 = (h2 ^ v[2]) * 0x100000001b3ull;
+            h3 = (h3 ^ v[3]) * 0x100000001b3ull;
+        }
+        for (; i < bytes; i += 4)
+        {
+            uint32_t v;
+            memcpy(&v, row + i, 4);
+            h0 = (h0 ^ v) * 0x100000001b3ull;
+        }
+    }
+    return h0 ^ (h1 << 1) ^ (h2 << 2) ^ (h3 << 3);
+}
+
+// Hashes each DIRTY_TILE x DIRTY_TILE tile of a BGRX frame and remembers the
+// previous hashes, so the worker can tell whether anything changed.
+class DirtyTracker
+{
+public:
+    // Returns the number of tiles that differ from the previous call.
+    int Update(const uint8_t *pixels, int width, int height, int stride)
+    {
+        int tilesX = (width + DIRTY_TILE - 1) / DIRTY_TILE;
+        int tilesY = (height + DIRTY_TILE - 1) / DIRTY_TILE;
+        if ((int)m_hashes.size() != tilesX * tilesY)
+        {
+            m_hashes.assign(tilesX * tilesY, 0);
+            m_first = true;
+        }
+
+        int dirty = 0;
+        for (int ty = 0; ty < tilesY; ty++)
+        {
+            int y0 = ty * DIRTY_TILE, y1 = std::min(y0 + DIRTY_TILE, height);
+            for (int tx = 0; tx < tilesX; tx++)
+            {
+                int x0 = tx * DIRTY_TILE, x1 = std::min(x0 + DIRTY_TILE, width);
+                uint64_t h = HashPixels(pixels, stride, x0, x1, y0, y1, 1);
+                uint64_t &prev = m_hashes[ty * tilesX + tx];
+                if (m_first || prev != h) dirty++;
+                prev = h;
+            }
+        }
+        m_first = false;
+        return dirty;
+    }
+
+private:
+    std::vector<uint64_t> m_hashes;
+    bool m_first = true;
+};
+
+// Cheap "did anything change" for idle polls: one hash over every
+// SAMPLE_ROW_STEP-th row, a quarter of DirtyTracker's reads. Text, carets and
+// windows are taller than that and always cross a sampled row; anything
+// thinner still goes out with the next keep-alive frame.
+class SampledChecksum
+{
+public:
+    // True if the sampled rows differ from the previous call (or there was none).
+    bool Update(const uint8_t *pixels, int width, int height, int stride)
+    {
+        uint64_t h = HashPixels(pixels, stride, 0, width, SAMPLE_ROW_STEP / 2, height, SAMPLE_ROW_STEP) ^ ((uint64_t)width << 32 | height);
+        bool changed = !m_primed || h != m_hash;
+        m_hash = h;
+        m_primed = true;
+        return changed;
+    }
+
+    // The next Update() only records a baseline.
+    void Reset() { m_primed = false; }
+    bool Primed() const { return m_primed; }
+
+private:
+    uint64_t m_hash = 0;
+    bool m_primed = false;
+};
+
+// One display's capture + encode + send. Implemented by the host (GDI) and the
+// benchmark (synthetic). Called only from that stream's worker thread.
+class StreamPipeline
+{
+public:
+    virtual ~StreamPipeline() {}
+    // Grabs the next frame into the pipeline's own BGRX buffer.
+    virtual bool Capture(const uint8_t **pixels, int *width, int *height, int *stride) = 0;
+    // Encodes the captured frame and sends it. `refresh` = nothing changed,
+    // sent only to keep late joiners and lossy links in sync.
+    virtual void EncodeAndSend(bool refresh) = 0;
+};
+
+struct StreamStats
+{
+    std::atomic<uint64_t> captured{0};
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> skipped{0}; // unchanged, not encoded
+    std::atomic<uint64_t> cpuUs{0};   // worker thread CPU time
+    std::atomic<uint64_t> polls{0};   // idle captures checked with SampledChecksum
+    std::atomic<bool> idle{false};
+    int core = -1;
+};
+
+inline uint64_t ThreadCpuMicros()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+inline bool PinCurrentThread(int core)
+{
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+class StreamScheduler
+{
+public:
+    ~StreamScheduler() { Stop(); }
+
+    // Takes ownership. Returns the stream index used in Stats()/SetActive().
+    int Add(StreamPipeline *pipeline, const GovernorConfig &config)
+    {
+        std::unique_ptr<Worker> w(new Worker());
+        w->pipeline.reset(pipeline);
+        w->governor.Configure(config);
+        m_workers.push_back(std::move(w));
+        return (int)m_workers.size() - 1;
+    }
+
+    int Add(StreamPipeline *pipeline, int maxFps)
+    {
+        GovernorConfig config;
+        config.maxFps = maxFps;
+        return Add(pipeline, config);
+    }
+
+    // Streams nobody subscribed to sleep instead of capturing.
+    void SetActive(int stream, bool active)
+    {
+        m_workers[stream]->active = active;
+    }
+
+    // Forces a full frame right away (new subscriber, crop change).
+    void RequestRefresh(int stream)
+    {
+        m_workers[stream]->refreshNow = true;
+        Wake(m_workers[stream].get(), false);
+    }
+
+    // Input from the client: the stream (or all, -1) wakes up now and runs at
+    // maxFps until the governor sees it idle again. Never faster: a wake-up
+    // within 1 / maxFps of the last capture waits for the rest of it.
+    void NotifyInput(int stream = -1)
+    {
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            if (stream < 0 || stream == (int)i) Wake(m_workers[i].get(), true);
+        }
+    }
+
+    // Starts one thread per stream. With pin=true stream i runs on core
+    // (i + firstCore) % cores, so encoders never fight over a core while others idle.
+    void Start(bool pin = true, int firstCore = 0)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        m_running = true;
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            Worker *w = m_workers[i].get();
+            int core = pin ? (int)((i + firstCore) % cores) : -1;
+            w->thread = std::thread(&StreamScheduler::Run, this, w, core);
+        }
+    }
+
+    void Stop()
+    {
+        m_running = false;
+        for (auto &w : m_workers)
+        {
+            Wake(w.get(), false);
+            if (w->thread.joinable()) w->thread.join();
+        }
+    }
+
+    size_t Count() const { return m_workers.size(); }
+    const StreamStats &Stats(int stream) const { return m_workers[stream]->stats; }
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<StreamPipeline> pipeline;
+        FrameGovernor governor;
+        std::atomic<bool> active{true};
+        std::atomic<bool> refreshNow{true};
+        DirtyTracker dirty;
+        SampledChecksum sampler;
+        StreamStats stats;
+        std::thread thread;
+
+        // Cuts the sleep between captures short (input, refresh, Stop).
+        std::mutex wakeLock;
+        std::condition_variable wakeCv;
+        bool wake = false;
+        bool input = false;
+    };
+
+    void Wake(Worker *w, bool input)
+    {
+        {
+            std::lock_guard<std::mutex> guard(w->wakeLock);
+            w->wake = true;
+            w->input |= input;
+        }
+        w->wakeCv.notify_one();
+    }
+
+    void Run(Worker *w, int core)
+    {
+        if (core >= 0 && PinCurrentThread(core)) w->stats.core = core;
+
+        typedef std::chrono::steady_clock Clock;
+        auto next = Clock::now();
+        auto lastCapture = Clock::now() - std::chrono::hours(1);
+        auto lastSent = Clock::now() - std::chrono::hours(1);
+        uint64_t cpuStart = ThreadCpuMicros();
+
+        while (m_running)
+        {
+            if (!w->active)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                next = Clock::now();
+                continue;
+            }
+
+            const uint8_t *pixels;
+            int width, height, stride;
+            lastCapture = Clock::now();
+            if (w->pipeline->Capture(&pixels, &width, &height, &stride))
+            {
+                w->stats.captured++;
+                auto now = Clock::now();
+                bool idle = w->governor.Idle(now);
+                bool changed;
+                if (idle && w->sampler.Primed())
+                {
+                    // OPTIMIZATION: idle polls read a quarter of the frame;
+                    // the tile hashes only catch up once something moved.
+                    w->stats.polls++;
+                    changed = w->sampler.Update(pixels, width, height, stride);
+                    if (changed) w->dirty.Update(pixels, width, height, stride);
+                }
+                else
+                {
+                    changed = w->dirty.Update(pixels, width, height, stride) > 0;
+                    // Entering idle: baseline for the polls that follow.
+                    if (idle) w->sampler.Update(pixels, width, height, stride);
+                    else w->sampler.Reset();
+                }
+
+                if (changed) w->governor.NoteActivity(now);
+                w->stats.idle = w->governor.Idle(now);
+
+                bool refresh = w->refreshNow.exchange(false) || w->governor.KeepAliveDue(now, lastSent);
+                if (changed || refresh)
+                {
+                    w->pipeline->EncodeAndSend(!changed);
+                    w->stats.sent++;
+                    lastSent = now;
+                }
+                else
+                {
+                    w->stats.skipped++;
+                }
+            }
+            w->stats.cpuUs = ThreadCpuMicros() - cpuStart;
+
+            auto now = Clock::now();
+            next += w->governor.Interval(now);
+            if (next < now) next = now; // fell behind: don't try to catch up with a burst
+
+            std::unique_lock<std::mutex> lock(w->wakeLock);
+            while (m_running)
+            {
+                w->wakeCv.wait_until(lock, next, [&] { return w->wake || !m_running; });
+                if (!w->wake) break;
+                w->wake = false;
+                if (w->input) w->governor.NoteActivity(Clock::now());
+                w->input = false;
+                // Cut the sleep short, but never to less than 1 / maxFps
+                // after the last capture: mouse moves arrive far faster than
+                // that. An idle worker last captured a poll ago, so a click
+                // still gets its frame right away.
+                next = std::min(next, std::max(Clock::now(), lastCapture + w->governor.ActiveInterval()));
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_running{false};
+};
@@ -0,0 +1,326 @@
+// Wire format shared by host.cpp, client.cpp, host_ffmpeg.cpp/client_ffmpeg.cpp,
+// native/rdc_native.cpp and (mirrored) wire_format.py.
+//
+// Every datagram payload (the plaintext inside a SecureChannel seal) starts
+// with an 8-byte header, all fields little-endian:
+//
+//   u16 magic 'R''D'   u8 version   u8 type   u16 bodyLen   u16 reserved
+//
+// followed by a fixed body per type and, for frame chunks, the payload.
+//
+//   WIRE_FRAME      u32 frameId  u32 offset  u32 totalSize  u16 width
+//                   u16 height   u8 display  u8 flags  u16 reserved
+//                   u64 timestampUs  + bytes
+//   WIRE_INPUT      u8 kind  u8 display  u16 reserved  i32 x  i32 y  i32 key
+//   WIRE_SUBSCRIBE  u8 display (WIRE_ALL_DISPLAYS = all)  u8 reserved
+//                   u16 x  u16 y  u16 w  u16 h  u16 reserved
+//   WIRE_AUDIO      u64 timestampUs  u32 seq  u32 sampleRate  u8 codec
+//                   u8 channels  u16 frameSamples  + bytes
+//
+// timestampUs is the host's media clock (common/media_clock.h): capture time
+// of a video frame, or of an audio frame's first sample. Audio and video
+// share it, which is what the client syncs on.
+//
+// WireParse<Msg>() validates a datagram in place and returns a view: the
+// accessors read straight out of the receive buffer, nothing is copied or
+// allocated. Magic, version and type are checked with one 32-bit compare,
+// the length with one more, and the field ranges with a branch-free AND, so
+// a receiver can size buffers from a view without further checks.
+//
+// Bump WIRE_VERSION when a layout changes; old peers then drop the packets
+// instead of misreading them.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#define WIRE_MAGIC 0x4452 // "RD" as it appears on the wire
+#define WIRE_VERSION 2 // 2: media timestamps, WIRE_AUDIO
+#define WIRE_HEADER_SIZE 8
+#define WIRE_MAX_BODY 65535
+
+#define WIRE_FRAME 1
+#define WIRE_INPUT 2
+#define WIRE_SUBSCRIBE 3
+#define WIRE_AUDIO 4
+
+// Anything beyond these is not something we sent.
+#define WIRE_MAX_FRAME_BYTES (32 * 1024 * 1024)
+#define WIRE_MAX_DIM 8192
+#define WIRE_MAX_DISPLAYS 8
+#define WIRE_ALL_DISPLAYS 0xFF
+#define WIRE_MAX_AUDIO_SAMPLES 2880 // 60 ms at 48 kHz, per channel
+
+#define WIRE_FLAG_KEYFRAME 1
+
+// Input kinds (WIRE_INPUT)
+#define INPUT_MOUSE_MOVE 1
+#define INPUT_LEFT_DOWN 2
+#define INPUT_LEFT_UP 3
+#define INPUT_RIGHT_DOWN 4
+#define INPUT_RIGHT_UP 5
+#define INPUT_KEY_DOWN 6
+#define INPUT_KEY_UP 7
+
+// Audio codecs (WIRE_AUDIO), see common/audio_stream.h
+#define AUDIO_CODEC_ADPCM 1
+#define AUDIO_CODEC_OPUS 2 // reserved: no build encodes or decodes it
+
+#define WIRE_FRAME_BODY 28
+#define WIRE_INPUT_BODY 16
+#define WIRE_SUBSCRIBE_BODY 12
+#define WIRE_AUDIO_BODY 20
+// Bytes in front of every frame chunk's / audio frame's payload.
+#define WIRE_FRAME_OVERHEAD (WIRE_HEADER_SIZE + WIRE_FRAME_BODY)
+#define WIRE_AUDIO_OVERHEAD (WIRE_HEADER_SIZE + WIRE_AUDIO_BODY)
+
+// Little-endian loads/stores. On x86/ARM these compile to plain moves.
+inline uint16_t WireLoad16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, 2);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap16(v);
+#endif
+    return v;
+}
+
+inline uint32_t WireLoad32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline uint64_t WireLoad64(const uint8_t *p)
+{
+    return WireLoad32(p) | (uint64_t)WireLoad32(p + 4) << 32;
+}
+
+inline void WireStore16(uint8_t *p, uint16_t v)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap16(v);
+#endif
+    memcpy(p, &v, 2);
+}
+
+inline void WireStore32(uint8_t *p, uint32_t v)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    memcpy(p, &v, 4);
+}
+
+inline void WireStore64(uint8_t *p, uint64_t v)
+{
+    WireStore32(p, (uint32_t)v);
+    WireStore32(p + 4, (uint32_t)(v >> 32));
+}
+
+// Views. `body` points into the datagram and is only valid as long as it is.
+
+struct WireFrameChunk
+{
+    enum { TYPE = WIRE_FRAME, BODY_SIZE = WIRE_FRAME_BODY, VARIABLE = 1 };
+    const uint8_t *body;
+    int payloadLen;
+
+    uint32_t FrameId() const { return WireLoad32(body); }
+    uint32_t Offset() const { return WireLoad32(body + 4); }
+    uint32_t TotalSize() const { return WireLoad32(body + 8); }
+    int Width() const { return WireLoad16(body + 12); }
+    int Height() const { return WireLoad16(body + 14); }
+    int Display() const { return body[16]; }
+    int Flags() const { return body[17]; }
+    uint64_t TimestampUs() const { return WireLoad64(body + 20); }
+    const uint8_t *Payload() const { return body + BODY_SIZE; }
+
+    static bool Check(const uint8_t *b, int payloadLen)
+    {
+        uint32_t offset = WireLoad32(b + 4);
+        uint32_t total = WireLoad32(b + 8);
+        uint32_t w = WireLoad16(b + 12), h = WireLoad16(b + 14);
+        // Unsigned wrap-around folds the "> 0" checks into the upper bounds.
+        return ((total - 1u < (uint32_t)WIRE_MAX_FRAME_BYTES) & (offset < total) &
+                ((uint32_t)payloadLen - 1u < total - offset) &
+                (w - 1u < (uint32_t)WIRE_MAX_DIM) & (h - 1u < (uint32_t)WIRE_MAX_DIM) &
+                (b[16] < WIRE_MAX_DISPLAYS)) != 0;
+    }
+};
+
+struct WireInput
+{
+    enum { TYPE = WIRE_INPUT, BODY_SIZE = WIRE_INPUT_BODY, VARIABLE = 0 };
+    const uint8_t *body;
+    int payloadLen;
+
+    int Kind() const { return body[0]; }
+    int Display() const { return body[1]; }
+    int X() const { return (int)WireLoad32(body + 4); }
+    int Y() const { return (int)WireLoad32(body + 8); }
+    int Key() const { return (int)WireLoad32(body + 12); }
+    bool IsMouse() const { return Kind() <= INPUT_RIGHT_UP; }
+
+    static bool Check(const uint8_t *b, int)
+    {
+        return (((uint32_t)b[0] - 1u < 7u) & (b[1] < WIRE_MAX_DISPLAYS) &
+                (WireLoad32(b + 4) < (uint32_t)WIRE_MAX_DIM) & (WireLoad32(b + 8) < (uint32_t)WIRE_MAX_DIM) &
+                (WireLoad32(b + 12) < 256u)) != 0;
+    }
+};
+
+struct WireSubscribe
+{
+    enum { TYPE = WIRE_SUBSCRIBE, BODY_SIZE = WIRE_SUBSCRIBE_BODY, VARIABLE = 0 };
+    const uint8_t *body;
+    int payloadLen;
+
+    int Display() const { return body[0]; }
+    bool AllDisplays() const { return body[0] == WIRE_ALL_DISPLAYS; }
+    int X() const { return WireLoad16(body + 2); }
+    int Y() const { return WireLoad16(body + 4); }
+    int W() const { return WireLoad16(body + 6); }
+    int H() const { return WireLoad16(body + 8); }
+    bool Cropped() const { return W() > 0; }
+
+    // No crop (w = h = 0) or a non-empty crop inside WIRE_MAX_DIM.
+    static bool Check(const uint8_t *b, int)
+    {
+        uint32_t x = WireLoad16(b + 2), y = WireLoad16(b + 4), w = WireLoad16(b + 6), h = WireLoad16(b + 8);
+        bool noCrop = (w | h) == 0;
+        bool crop = (w - 1u < (uint32_t)WIRE_MAX_DIM) & (h - 1u < (uint32_t)WIRE_MAX_DIM) &
+                    (x + w <= (uint32_t)WIRE_MAX_DIM) & (y + h <= (uint32_t)WIRE_MAX_DIM);
+        return ((b[0] < WIRE_MAX_DISPLAYS) | (b[0] == WIRE_ALL_DISPLAYS)) & (noCrop | crop);
+    }
+};
+
+struct WireAudio
+{
+    enum { TYPE = WIRE_AUDIO, BODY_SIZE = WIRE_AUDIO_BODY, VARIABLE = 1 };
+    const uint8_t *body;
+    int payloadLen;
+
+    uint64_t TimestampUs() const { return WireLoad64(body); }
+    uint32_t Seq() const { return WireLoad32(body + 8); }
+    int SampleRate() const { return (int)WireLoad32(body + 12); }
+    int Codec() const { return body[16]; }
+    int Channels() const { return body[17]; }
+    int FrameSamples() const { return WireLoad16(body + 18); }
+    const uint8_t *Payload() const { return body + BODY_SIZE; }
+
+    static bool Check(const uint8_t *b, int payloadLen)
+    {
+        uint32_t rate = WireLoad32(b + 12);
+        uint32_t samples = WireLoad16(b + 18);
+        return ((rate - 8000u <= 40000u) & ((uint32_t)b[16] - 1u < 2u) & ((uint32_t)b[17] - 1u < 2u) &
+                (samples - 1u < (uint32_t)WIRE_MAX_AUDIO_SAMPLES) & (payloadLen > 0)) != 0;
+    }
+};
+
+// Validates `data` as a Msg and fills the view. Specialised per message type
+// at compile time: the expected first word and the fixed/variable length rule
+// are constants, so a mismatch costs a compare and a branch.
+template <typename Msg>
+inline bool WireParse(const uint8_t *data, int len, Msg *out)
+{
+    const uint32_t expect = WIRE_MAGIC | ((uint32_t)WIRE_VERSION << 16) | ((uint32_t)Msg::TYPE << 24);
+    if (len < WIRE_HEADER_SIZE + (int)Msg::BODY_SIZE || len > WIRE_HEADER_SIZE + WIRE_MAX_BODY) return false;
+    int bodyLen = len - WIRE_HEADER_SIZE;
+    if (WireLoad32(data) != expect || WireLoad16(data + 4) != bodyLen) return false;
+    if (!Msg::VARIABLE && bodyLen != (int)Msg::BODY_SIZE) return false;
+
+    const uint8_t *body = data + WIRE_HEADER_SIZE;
+    int payloadLen = bodyLen - (int)Msg::BODY_SIZE;
+    if (!Msg::Check(body, payloadLen)) return false;
+    out->body = body;
+    out->payloadLen = payloadLen;
+    return true;
+}
+
+// Message type for dispatch, 0 if the datagram is not ours (or too new).
+// WireParse() still has to accept it before any field is trusted.
+inline int WireType(const uint8_t *data, int len)
+{
+    if (len < WIRE_HEADER_SIZE || WireLoad16(data) != WIRE_MAGIC || data[2] != WIRE_VERSION) return 0;
+    return data[3];
+}
+
+// Writers. Each returns the number of bytes written.
+
+inline int WireWriteHeader(uint8_t *out, int type, int bodyLen)
+{
+    WireStore16(out, WIRE_MAGIC);
+    out[2] = WIRE_VERSION;
+    out[3] = (uint8_t)type;
+    WireStore16(out + 4, (uint16_t)bodyLen);
+    WireStore16(out + 6, 0);
+    return WIRE_HEADER_SIZE;
+}
+
+// Header + fixed body only; the caller places payloadLen bytes right after
+// (so the host can copy the JPEG chunk straight into its send slot).
+inline int WireWriteFrameChunk(uint8_t *out, uint32_t frameId, uint64_t timestampUs, uint32_t offset, uint32_t totalSize,
+                               int width, int height, int display, int flags, int payloadLen)
+{
+    WireWriteHeader(out, WIRE_FRAME, WIRE_FRAME_BODY + payloadLen);
+    uint8_t *b = out + WIRE_HEADER_SIZE;
+    WireStore32(b, frameId);
+    WireStore32(b + 4, offset);
+    WireStore32(b + 8, totalSize);
+    WireStore16(b + 12, (uint16_t)width);
+    WireStore16(b + 14, (uint16_t)height);
+    b[16] = (uint8_t)display;
+    b[17] = (uint8_t)flags;
+    WireStore16(b + 18, 0);
+    WireStore64(b + 20, timestampUs);
+    return WIRE_FRAME_OVERHEAD;
+}
+
+inline int WireWriteInput(uint8_t *out, int kind, int display, int x, int y, int key)
+{
+    WireWriteHeader(out, WIRE_INPUT, WIRE_INPUT_BODY);
+    uint8_t *b = out + WIRE_HEADER_SIZE;
+    b[0] = (uint8_t)kind;
+    b[1] = (uint8_t)display;
+    WireStore16(b + 2, 0);
+    WireStore32(b + 4, (uint32_t)x);
+    WireStore32(b + 8, (uint32_t)y);
+    WireStore32(b + 12, (uint32_t)key);
+    return WIRE_HEADER_SIZE + WIRE_INPUT_BODY;
+}
+
+inline int WireWriteSubscribe(uint8_t *out, int display, int x, int y, int w, int h)
+{
+    WireWriteHeader(out, WIRE_SUBSCRIBE, WIRE_SUBSCRIBE_BODY);
+    uint8_t *b = out + WIRE_HEADER_SIZE;
+    b[0] = (uint8_t)display;
+    b[1] = 0;
+    WireStore16(b + 2, (uint16_t)x);
+    WireStore16(b + 4, (uint16_t)y);
+    WireStore16(b + 6, (uint16_t)w);
+    WireStore16(b + 8, (uint16_t)h);
+    WireStore16(b + 10, 0);
+    return WIRE_HEADER_SIZE + WIRE_SUBSCRIBE_BODY;
+}
+
+// Header + fixed body only, like WireWriteFrameChunk(); the encoded audio
+// frame follows at out + WIRE_AUDIO_OVERHEAD.
+inline int WireWriteAudio(uint8_t *out, uint32_t seq, uint64_t timestampUs, int sampleRate, int codec,
+                          int channels, int frameSamples, int payloadLen)
+{
+    WireWriteHeader(out, WIRE_AUDIO, WIRE_AUDIO_BODY + payloadLen);
+    uint8_t *b = out + WIRE_HEADER_SIZE;
+    WireStore64(b, timestampUs);
+    WireStore32(b + 8, seq);
+    WireStore32(b + 12, (uint32_t)sampleRate);
+    b[16] = (uint8_t)codec;
+    b[17] = (uint8_t)channels;
+    WireStore16(b + 18, (uint16_t)frameSamples);
+    return WIRE_AUDIO_OVERHEAD;
+}
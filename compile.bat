@@ -1,2 +1,2 @@
-g++ host.cpp -o host.exe -lws2_32 -lgdi32 -lgdiplus -lole32 -luser32
-g++ client.cpp -o client.exe -lws2_32 -lgdi32 -lgdiplus -lole32 -luser32
\ No newline at end of file
+g++ host.cpp -o host.exe -lws2_32 -lgdi32 -lgdiplus -lole32 -luser32 -lcrypto
+g++ client.cpp -o client.exe -lws2_32 -lgdi32 -lgdiplus -lole32 -luser32 -lwinmm -lcrypto
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include <vector>
 #include <fstream> // For file checking
 
+#include "../common/wire_format.h"
+
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "user32.lib")
 #pragma comment(lib, "gdi32.lib")
@@ -24,14 +26,6 @@ int HOST_WIDTH = 1280;
 int HOST_HEIGHT = 720;
 const char* VIDEO_WINDOW_TITLE = "Remote Video Stream";
 
-struct InputPacket
-{
-    int type;
-    int x;
-    int y;
-    int key;
-};
-
 SOCKET sock;
 sockaddr_in hostAddr;
 int g_windowW = 0;
@@ -49,17 +43,13 @@ void SendInputPacket(int type, int x, int y, int key)
 {
     if (g_windowW == 0 || g_windowH == 0) return;
 
-    InputPacket pkt;
-    pkt.type = type;
-    pkt.x = x;
-    pkt.y = y;
-    pkt.key = key;
-
     // Scale coordinates from our window size to Host resolution
-    pkt.x = (x * HOST_WIDTH) / g_windowW;
-    pkt.y = (y * HOST_HEIGHT) / g_windowH;
+    int hostX = (x * HOST_WIDTH) / g_windowW;
+    int hostY = (y * HOST_HEIGHT) / g_windowH;
 
-    sendto(sock, (char *)&pkt, sizeof(pkt), 0, (sockaddr *)&hostAddr, sizeof(hostAddr));
+    uint8_t pkt[WIRE_HEADER_SIZE + WIRE_INPUT_BODY];
+    int len = WireWriteInput(pkt, type, 0, hostX, hostY, key);
+    sendto(sock, (char *)pkt, len, 0, (sockaddr *)&hostAddr, sizeof(hostAddr));
 }
 
 // --- WINDOW SNAPPER ---
@@ -126,13 +116,13 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
         return 0;
 
     // Mouse Inputs
-    case WM_MOUSEMOVE:     SendInputPacket(1, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_LBUTTONDOWN:   SendInputPacket(2, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_LBUTTONUP:     SendInputPacket(3, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_RBUTTONDOWN:   SendInputPacket(4, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_RBUTTONUP:     SendInputPacket(5, LOWORD(lp), HIWORD(lp), 0); break;
-    case WM_KEYDOWN:       SendInputPacket(6, 0, 0, (int)wp); break;
-    case WM_KEYUP:         SendInputPacket(7, 0, 0, (int)wp); break;
+    case WM_MOUSEMOVE:     SendInputPacket(INPUT_MOUSE_MOVE, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_LBUTTONDOWN:   SendInputPacket(INPUT_LEFT_DOWN, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_LBUTTONUP:     SendInputPacket(INPUT_LEFT_UP, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_RBUTTONDOWN:   SendInputPacket(INPUT_RIGHT_DOWN, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_RBUTTONUP:     SendInputPacket(INPUT_RIGHT_UP, LOWORD(lp), HIWORD(lp), 0); break;
+    case WM_KEYDOWN:       SendInputPacket(INPUT_KEY_DOWN, 0, 0, (int)wp); break;
+    case WM_KEYUP:         SendInputPacket(INPUT_KEY_UP, 0, 0, (int)wp); break;
         
     case WM_PAINT:
         {
@@ -157,7 +147,9 @@ void StartFFplay()
 
     // -noborder: removes title bar (optional, often better for overlay)
     // udp://0.0.0.0 is safer than @ on Windows
-    std::string cmd = "ffplay.exe -fflags nobuffer -flags low_delay -framedrop -window_title \"" + 
+    // -sync video: audio follows the picture (the default audio master would
+    // hold frames back to the sound card instead).
+    std::string cmd = "ffplay.exe -fflags nobuffer -flags low_delay -framedrop -sync video -window_title \"" + 
                       std::string(VIDEO_WINDOW_TITLE) + "\" udp://0.0.0.0:50006?overrun_nonfatal=1";
 
     STARTUPINFOA si;
@@ -11,6 +11,8 @@
 #include <thread>
 #include <vector>
 
+#include "../common/wire_format.h"
+
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "user32.lib")
 
@@ -24,58 +26,59 @@ int g_screenH = 1080;
 int g_streamW = 1280;
 int g_streamH = 720;
 
-struct InputPacket
-{
-    int type;
-    int x;
-    int y;
-    int key;
-};
-
 // --- INPUT LISTENER ---
 void InputListener(SOCKET sock)
 {
     sockaddr_in senderAddr;
     int senderSize = sizeof(senderAddr);
-    char buffer[1024];
+    uint8_t buffer[1024];
 
     std::cout << "[INPUT] Listening for mouse/keyboard on port " << INPUT_PORT << "...\n";
 
     while (true)
     {
-        int recvLen = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
-        if (recvLen == sizeof(InputPacket))
+        int recvLen = recvfrom(sock, (char *)buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
+        WireInput pkt;
+        if (WireParse(buffer, recvLen, &pkt))
         {
-            InputPacket *pkt = (InputPacket *)buffer;
-            
             // Map input back to real screen coordinates
-            int realX = (pkt->x * g_screenW) / g_streamW;
-            int realY = (pkt->y * g_screenH) / g_streamH;
+            int realX = (pkt.X() * g_screenW) / g_streamW;
+            int realY = (pkt.Y() * g_screenH) / g_streamH;
 
-            switch (pkt->type)
+            switch (pkt.Kind())
             {
-            case 1: SetCursorPos(realX, realY); break;
-            case 2: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0); break;
-            case 3: mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0); break;
-            case 4: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0, 0); break;
-            case 5: mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0, 0); break;
-            case 6: keybd_event((BYTE)pkt->key, 0, 0, 0); break;
-            case 7: keybd_event((BYTE)pkt->key, 0, KEYEVENTF_KEYUP, 0); break;
+            case INPUT_MOUSE_MOVE: SetCursorPos(realX, realY); break;
+            case INPUT_LEFT_DOWN: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0); break;
+            case INPUT_LEFT_UP: mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0); break;
+            case INPUT_RIGHT_DOWN: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0, 0); break;
+            case INPUT_RIGHT_UP: mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0, 0); break;
+            case INPUT_KEY_DOWN: keybd_event((BYTE)pkt.Key(), 0, 0, 0); break;
+            case INPUT_KEY_UP: keybd_event((BYTE)pkt.Key(), 0, KEYEVENTF_KEYUP, 0); break;
             }
         }
     }
 }
 
 // --- FFMPEG LAUNCHER ---
-void StartFFmpeg(std::string clientIP)
+// audioDevice: DirectShow capture device name ("Stereo Mix (...)",
+// "virtual-audio-capturer"); empty = video only.
+void StartFFmpeg(std::string clientIP, std::string audioDevice)
 {
     // CHANGED: Removed "-video_size 1280x720" from before input (-i)
     // ADDED: "-vf scale=1280:720" to scale the FULL screen down properly
-    
-    std::string cmd = "ffmpeg.exe -f gdigrab -framerate 30 -i desktop "
-                      "-vf scale=1280:720 "
-                      "-c:v libx264 -preset ultrafast -tune zerolatency "
-                      "-b:v 2000k -f mpegts udp://" + clientIP + ":50006?pkt_size=1316";
+    // AUDIO: both inputs are stamped with the wall clock, so the MPEG-TS PTS
+    // of picture and sound come from one media clock. Opus in 10 ms frames,
+    // 10 ms capture buffer (dshow defaults to 500 ms).
+
+    std::string cmd = "ffmpeg.exe -use_wallclock_as_timestamps 1 -f gdigrab -framerate 30 -i desktop ";
+    if (!audioDevice.empty())
+    {
+        cmd += "-use_wallclock_as_timestamps 1 -f dshow -audio_buffer_size 10 -i audio=\"" + audioDevice + "\" "
+               "-map 0:v -map 1:a -c:a libopus -application lowdelay -frame_duration 10 -b:a 96k ";
+    }
+    cmd += "-vf scale=1280:720 "
+           "-c:v libx264 -preset ultrafast -tune zerolatency "
+           "-b:v 2000k -f mpegts udp://" + clientIP + ":50006?pkt_size=1316";
 
     std::cout << "[FFMPEG] Starting Stream...\n";
     std::cout << "[CMD] " << cmd << "\n";
@@ -106,8 +109,15 @@ void StartFFmpeg(std::string clientIP)
     CloseHandle(pi.hThread);
 }
 
-int main()
+// host_ffmpeg.exe [--audio-device "<dshow audio device>"]
+int main(int argc, char **argv)
 {
+    std::string audioDevice;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (std::string(argv[i]) == "--audio-device") audioDevice = argv[i + 1];
+    }
+
     // 1. Setup Screen Metrics (DPI Aware to get real screen size)
     SetProcessDPIAware();
     g_screenW = GetSystemMetrics(SM_CXSCREEN);
@@ -133,7 +143,7 @@ int main()
     inputThread.detach();
 
     // 5. Start FFmpeg (Main Thread)
-    StartFFmpeg(clientIP);
+    StartFFmpeg(clientIP, audioDevice);
 
     return 0;
 }
\ No newline at end of file
@@ -1,12 +1,23 @@
 import socket
-import struct
 import sys
 import threading
+import os
 import tkinter as tk
 import cv2  # Requires: pip install opencv-python
 from PIL import Image, ImageTk
 from tkinter import simpledialog
 
+# Native receive/decode core (../native). Needs a build with -DRDC_WITH_AVCODEC
+# for MPEG-TS (native/build.sh avcodec); otherwise we stay on OpenCV's VideoCapture.
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "native"))
+try:
+    from rdc_native import NativeReceiver, MODE_MPEGTS
+except (ImportError, OSError):
+    NativeReceiver = None
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import wire_format
+
 # Configuration
 INPUT_PORT = 50005
 STREAM_PORT = 50006
@@ -45,7 +56,14 @@ class RemoteScreenApp:
 
         # Start Video Thread
         self.is_running = True
-        self.thread = threading.Thread(target=self.video_loop)
+        self.native = None
+        if NativeReceiver:
+            # Input still goes through self.sock; the library only receives.
+            try: self.native = NativeReceiver(None, 0, STREAM_PORT, None, MODE_MPEGTS)
+            except OSError: self.native = None
+
+        loop = self.native_video_loop if self.native else self.video_loop
+        self.thread = threading.Thread(target=loop)
         self.thread.daemon = True
         self.thread.start()
 
@@ -84,6 +102,26 @@ class RemoteScreenApp:
 
         cap.release()
 
+    def native_video_loop(self):
+        while self.is_running:
+            frame = self.native.acquire(50)
+            if not frame: continue
+
+            # Zero-copy view over the decoded RGBA buffer; the resize copies.
+            view, width, height, mode = frame
+            img = Image.frombuffer(mode, (width, height), view, "raw", mode, 0, 1)
+            win_w = self.root.winfo_width()
+            win_h = self.root.winfo_height()
+            if win_w > 10 and win_h > 10:
+                img = img.resize((win_w, win_h), Image.NEAREST)
+            else:
+                img = img.copy()
+            del view
+            self.native.release()
+
+            imgtk = ImageTk.PhotoImage(image=img)
+            self.label.after(0, self.update_image, imgtk)
+
     def update_image(self, imgtk):
         self.label.configure(image=imgtk)
         self.label.image = imgtk # Keep reference
@@ -98,7 +136,7 @@ class RemoteScreenApp:
         scaled_x = int((x / win_w) * HOST_WIDTH)
         scaled_y = int((y / win_h) * HOST_HEIGHT)
 
-        packet = struct.pack('iiii', type_id, scaled_x, scaled_y, key)
+        packet = wire_format.pack_input(type_id, scaled_x, scaled_y, key)
         try: self.sock.sendto(packet, self.host_address)
         except: pass
 
@@ -123,6 +161,7 @@ class RemoteScreenApp:
 
     def on_close(self):
         self.is_running = False
+        if self.native: self.native.close()
         self.root.destroy()
         sys.exit(0)
 
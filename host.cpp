@@ -7,14 +7,32 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <gdiplus.h>
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include <mmreg.h>
+#include <ksmedia.h>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "common/audio_stream.h"
+#include "common/media_clock.h"
+#include "common/relay_session.h"
+#include "common/roi_map.h"
+#include "common/secure_channel.h"
+#include "common/session_recorder.h"
+#include "common/stream_scheduler.h"
+#include "common/wire_format.h"
+
 #pragma comment(lib, "ws2_32.lib")
 #pragma comment(lib, "gdi32.lib")
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "user32.lib")
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "libcrypto.lib")
 
 using namespace Gdiplus;
 
@@ -24,35 +42,215 @@ using namespace Gdiplus;
 #define MAX_PACKET_SIZE 60000 
 // Lower quality = Higher FPS. 25-35 is the sweet spot for speed.
 #define JPEG_QUALITY 25 
-
+// Region-of-interest mode: background tiles are pre-blurred (common/roi_map.h)
+// so the frame can be encoded at a higher quality for the same size. Each
+// display's quality follows its bytes (RoiQuality), between JPEG_QUALITY and
+// ROI_MAX_QUALITY, so frames cost what uniform JPEG_QUALITY would.
+// bench/bench_roi.cpp: q72 with a focused window, q75 with a maximised one.
+#define ROI_ENABLED 1
+#define ROI_MAX_QUALITY 75
+// Per display; each display has its own worker thread (common/stream_scheduler.h).
+#define STREAM_MAX_FPS 60
+// Idle governor (common/frame_governor.h): after STREAM_IDLE_AFTER_MS with no
+// change and no input a display is only polled every STREAM_REACTION_MS and
+// sends STREAM_MIN_FPS keep-alive frames. Override with --max-fps, --min-fps,
+// --reaction-ms.
+#define STREAM_MIN_FPS 1
+#define STREAM_REACTION_MS 100
+#define STREAM_IDLE_AFTER_MS 500
+// Audio (common/audio_stream.h): what the default output device plays, via
+// WASAPI loopback, in AUDIO_FRAME_MS frames of IMA ADPCM. --audio-file <wav>
+// streams a file instead, --no-audio turns it off.
+#define AUDIO_ENABLED 1
+// Loopback delivers nothing while nothing plays: after this many frame
+// periods without data, silence is sent so the client keeps its timing.
+#define LOOPBACK_SILENCE_FRAMES 2
+// Behind NAT: --relay <relay ip[:port]>[/<stream>] pushes the stream to a
+// relay (relay/relay.cpp) that viewers pull from, instead of waiting for a
+// client on LISTEN_PORT.
+#define RELAY_DEFAULT_STREAM "desktop"
+
+// Pre-shared secret. Only used to authenticate the key exchange, never sent.
 std::string deviceKey = "TEST_KEY_123";
+SecureChannel g_channel;
 
-int g_screenW = 0;
-int g_screenH = 0;
+// Optional session recording (host.exe --record <file>), see tools/rdc_player.cpp
+SessionRecorder g_recorder;
 
-// OPTIMIZATION: 1280x720 provides MUCH higher FPS than 1080p for GDI+ encoding
-int g_sendW = 1280;
-int g_sendH = 720;
+// Video capture and audio frames are stamped on this clock (common/media_clock.h)
+// so the client can line them up. Starts when the client authenticates.
+MediaClock g_mediaClock;
 
-#pragma pack(push, 1)
-struct PacketHeader
-{
-    int offset;
-    int dataLen;
-    int totalSize;
-    int width;
-    int height;
-};
-#pragma pack(pop)
+// Last click / key press from the client, for the ROI activity boost.
+std::atomic<DWORD> g_lastInputTick{0};
+
+SOCKET g_sock = INVALID_SOCKET;
+sockaddr_in g_clientAddr{}; // the relay in relay mode
+
+// Relay mode: g_channel seals media under a stream key every viewer gets
+// from g_relaySessions over its own handshake (common/relay_session.h).
+bool g_relayMode = false;
+RelayHostSessions g_relaySessions;
 
-struct InputPacket
+// All display workers share one channel: sealing and sending happen under
+// this lock so sequence numbers go out in order (client replay window).
+std::mutex g_sendLock;
+
+CLSID g_jpgClsid;
+
+// What the client subscribed to (common/wire_format.h WIRE_SUBSCRIBE).
+// display = WIRE_ALL_DISPLAYS streams every display; w/h > 0 crops one
+// display to that rectangle (display pixels).
+struct Subscription
 {
-    int type;
+    int display;
     int x;
     int y;
-    int key;
+    int w;
+    int h;
+};
+
+// OPTIMIZATION: 1280x720 provides MUCH higher FPS than 1080p for GDI+ encoding.
+// Displays wider than 1440p get 1080p instead: they have a core of their own
+// now, and a 4K desktop squeezed into 720p is unreadable.
+void PickSendSize(int srcW, int srcH, int *sendW, int *sendH)
+{
+    int boxW = srcW > 2560 ? 1920 : 1280;
+    int boxH = srcW > 2560 ? 1080 : 720;
+    double scale = std::min(1.0, std::min((double)boxW / srcW, (double)boxH / srcH));
+    *sendW = std::max(16, (int)(srcW * scale) & ~1);
+    *sendH = std::max(16, (int)(srcH * scale) & ~1);
+}
+
+// One monitor: GDI capture, ROI, GDI+ JPEG and send, run on its own worker.
+struct DisplayStream : public StreamPipeline
+{
+    int index;
+    RECT bounds; // virtual-screen coordinates
+
+    // Active capture rectangle and send size. Written by the worker, read by
+    // InputListener for coordinate mapping, so guarded by `lock`.
+    std::mutex lock;
+    RECT src;
+    int sendW = 0, sendH = 0;
+    RECT pendingSrc;
+    bool srcChanged = true;
+
+    HDC screenDC = NULL;
+    HDC memDC = NULL;
+    HBITMAP hBitmap = NULL;
+    void *dibBits = NULL;
+    Bitmap *frameBmp = NULL;
+    RoiMap roiMap{16, 16}; // resized to the send size in Allocate()
+    RoiQuality roiQuality{JPEG_QUALITY, ROI_MAX_QUALITY};
+
+    // One sealed datagram per slot: [seq][wire header][chunk][tag].
+    // Grows to the largest frame seen and is then reused.
+    std::vector<uint8_t> sendArena;
+    std::vector<int> plainLens, sealedLens;
+    uint32_t frameId = 0;
+    uint64_t captureUs = 0; // g_mediaClock at capture
+
+    DisplayStream(int idx, const RECT &rc) : index(idx), bounds(rc), src(rc), pendingSrc(rc)
+    {
+        screenDC = GetDC(NULL);
+        memDC = CreateCompatibleDC(screenDC);
+        SetStretchBltMode(memDC, COLORONCOLOR); // Fastest scaling mode
+    }
+
+    ~DisplayStream()
+    {
+        delete frameBmp;
+        if (hBitmap) DeleteObject(hBitmap);
+        DeleteDC(memDC);
+        ReleaseDC(NULL, screenDC);
+    }
+
+    // Region in display pixels; w/h <= 0 = the whole display.
+    // Returns true if the capture rectangle changed.
+    bool SetCrop(int x, int y, int w, int h)
+    {
+        RECT rc = bounds;
+        if (w > 0 && h > 0)
+        {
+            rc.left = bounds.left + std::max(0, x);
+            rc.top = bounds.top + std::max(0, y);
+            rc.right = std::min(bounds.right, rc.left + w);
+            rc.bottom = std::min(bounds.bottom, rc.top + h);
+            if (rc.right - rc.left < 16 || rc.bottom - rc.top < 16) rc = bounds;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        if (EqualRect(&rc, &pendingSrc)) return false;
+        pendingSrc = rc;
+        srcChanged = true;
+        return true;
+    }
+
+    // Stream coordinates -> virtual-screen coordinates for SetCursorPos.
+    void MapInput(int x, int y, int *realX, int *realY)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (sendW == 0 || sendH == 0) { *realX = src.left; *realY = src.top; return; }
+        *realX = src.left + (x * (src.right - src.left)) / sendW;
+        *realY = src.top + (y * (src.bottom - src.top)) / sendH;
+    }
+
+    // DIB section so the ROI prefilter can touch the pixels directly.
+    void Allocate()
+    {
+        PickSendSize(src.right - src.left, src.bottom - src.top, &sendW, &sendH);
+
+        delete frameBmp;
+        if (hBitmap) DeleteObject(hBitmap);
+
+        BITMAPINFO bmi{};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = sendW;
+        bmi.bmiHeader.biHeight = -sendH; // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        hBitmap = CreateDIBSection(screenDC, &bmi, DIB_RGB_COLORS, &dibBits, NULL, 0);
+        SelectObject(memDC, hBitmap);
+
+        // OPTIMIZATION: GDI+ Bitmap wraps the DIB memory, no per-frame copy.
+        frameBmp = new Bitmap(sendW, sendH, sendW * 4, PixelFormat32bppRGB, (BYTE *)dibBits);
+        roiMap.Resize(sendW, sendH);
+        roiQuality.Reset();
+    }
+
+    bool Capture(const uint8_t **pixels, int *width, int *height, int *stride) override
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (srcChanged)
+            {
+                src = pendingSrc;
+                Allocate();
+                srcChanged = false;
+            }
+        }
+
+        // 1. Capture & Resize
+        StretchBlt(memDC, 0, 0, sendW, sendH, screenDC, src.left, src.top, src.right - src.left, src.bottom - src.top, SRCCOPY);
+        GdiFlush();
+        captureUs = g_mediaClock.NowUs();
+
+        *pixels = (const uint8_t *)dibBits;
+        *width = sendW;
+        *height = sendH;
+        *stride = sendW * 4;
+        return true;
+    }
+
+    // Every GDI frame is a full JPEG, so a refresh is encoded like any other.
+    void EncodeAndSend(bool refresh) override;
 };
 
+std::vector<DisplayStream *> g_displays;
+StreamScheduler g_scheduler;
+Subscription g_subscription{0, 0, 0, 0, 0};
+
 bool IsElevated()
 {
     bool fRet = false;
@@ -110,9 +308,87 @@ int GetEncoderClsid(const WCHAR *format, CLSID *pClsid)
     return -1;
 }
 
-bool validateIncomingKey(const std::string &incoming)
+// GDI+ JPEG at `quality` into a new stream; the bytes are its HGLOBAL.
+IStream *EncodeJpeg(Bitmap *bmp, ULONG quality)
+{
+    EncoderParameters params;
+    params.Count = 1;
+    params.Parameter[0].Guid = EncoderQuality;
+    params.Parameter[0].Type = EncoderParameterValueTypeLong;
+    params.Parameter[0].NumberOfValues = 1;
+    params.Parameter[0].Value = &quality;
+
+    IStream *pStream = NULL;
+    CreateStreamOnHGlobal(NULL, TRUE, &pStream);
+    bmp->Save(pStream, &g_jpgClsid, &params);
+    return pStream;
+}
+
+int JpegSize(IStream *pStream)
+{
+    HGLOBAL hMem = NULL;
+    GetHGlobalFromStream(pStream, &hMem);
+    return (int)GlobalSize(hMem);
+}
+
+// Starts/stops display workers to match what the client asked for. The client
+// re-sends its subscription periodically, so repeats are ignored cheaply.
+void ApplySubscription(const WireSubscribe &msg)
+{
+    Subscription sub{msg.Display(), msg.X(), msg.Y(), msg.W(), msg.H()};
+    bool all = msg.AllDisplays();
+    if (!all && sub.display >= (int)g_displays.size()) return;
+    if (memcmp(&sub, &g_subscription, sizeof(sub)) == 0) return;
+    g_subscription = sub;
+
+    for (size_t i = 0; i < g_displays.size(); i++)
+    {
+        bool active = all || sub.display == (int)i;
+        bool cropped = sub.display == (int)i && msg.Cropped();
+        g_displays[i]->SetCrop(cropped ? sub.x : 0, cropped ? sub.y : 0, cropped ? sub.w : 0, cropped ? sub.h : 0);
+        g_scheduler.SetActive((int)i, active);
+        if (active) g_scheduler.RequestRefresh((int)i);
+    }
+    std::cout << "[INFO] Client subscribed to " << (all ? std::string("all displays") : "display " + std::to_string(sub.display))
+              << (msg.Cropped() ? " (cropped)" : "") << ".\n";
+}
+
+// A subscription or input event from the client (through a relay: from any viewer).
+void HandleClientMessage(const uint8_t *plain, int plainLen)
 {
-    return incoming == deviceKey;
+    WireSubscribe sub;
+    WireInput pkt;
+    if (WireParse(plain, plainLen, &sub))
+    {
+        ApplySubscription(sub);
+    }
+    else if (WireParse(plain, plainLen, &pkt))
+    {
+        // Map input back to real screen coordinates of the display it was on
+        int realX = 0, realY = 0;
+        if (pkt.IsMouse())
+        {
+            if (pkt.Display() >= (int)g_displays.size()) return;
+            g_displays[pkt.Display()]->MapInput(pkt.X(), pkt.Y(), &realX, &realY);
+        }
+
+        if (pkt.Kind() != INPUT_MOUSE_MOVE) g_lastInputTick = GetTickCount();
+        // The screen is about to change: wake the display (keys: all of
+        // them, the focus may be anywhere) instead of waiting for a poll.
+        g_scheduler.NotifyInput(pkt.IsMouse() ? pkt.Display() : -1);
+        if (g_recorder.IsOpen()) g_recorder.RecordInput(pkt.Kind(), pkt.X(), pkt.Y(), pkt.Key(), pkt.Display());
+
+        switch (pkt.Kind())
+        {
+        case INPUT_MOUSE_MOVE: SetCursorPos(realX, realY); break;
+        case INPUT_LEFT_DOWN: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0); break;
+        case INPUT_LEFT_UP: mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0); break;
+        case INPUT_RIGHT_DOWN: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0, 0); break;
+        case INPUT_RIGHT_UP: mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0, 0); break;
+        case INPUT_KEY_DOWN: keybd_event((BYTE)pkt.Key(), 0, 0, 0); break;
+        case INPUT_KEY_UP: keybd_event((BYTE)pkt.Key(), 0, KEYEVENTF_KEYUP, 0); break;
+        }
+    }
 }
 
 DWORD WINAPI InputListener(LPVOID lpParam)
@@ -120,38 +396,402 @@ DWORD WINAPI InputListener(LPVOID lpParam)
     SOCKET sock = (SOCKET)lpParam;
     sockaddr_in senderAddr;
     int senderSize = sizeof(senderAddr);
-    char buffer[1024];
+    uint8_t buffer[1024];
+    uint8_t reply[RELAY_REPLY_MAX];
+
+    while (true)
+    {
+        int recvLen = recvfrom(sock, (char *)buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
+        // Anything that does not authenticate under the session key is dropped,
+        // and so is anything that is not a well-formed message.
+        const uint8_t *plain = buffer + SEAL_SEQ_SIZE;
+        int plainLen = -1;
+        if (g_relayMode)
+        {
+            // Viewers' handshakes and messages, each under its own session.
+            if (senderAddr.sin_addr.s_addr != g_clientAddr.sin_addr.s_addr || senderAddr.sin_port != g_clientAddr.sin_port) continue;
+            int replyLen = g_relaySessions.Handle(buffer, recvLen, reply, &plain, &plainLen);
+            if (replyLen > 0) sendto(sock, (char *)reply, replyLen, 0, (sockaddr *)&g_clientAddr, sizeof(g_clientAddr));
+            if (replyLen != 0) continue;
+        }
+        else
+        {
+            plainLen = recvLen > SEAL_OVERHEAD ? g_channel.Open(buffer, recvLen) : -1;
+        }
+        HandleClientMessage(plain, plainLen);
+    }
+    return 0;
+}
 
+// Registers the stream with the relay and keeps our NAT mapping to it open.
+// The relay's cookie, once InputListener has it, rides along.
+DWORD WINAPI RelayKeepAlive(LPVOID lpParam)
+{
+    SOCKET sock = (SOCKET)lpParam;
+    uint8_t publish[RELAY_UP_HEADER_SIZE];
     while (true)
     {
-        int recvLen = recvfrom(sock, buffer, sizeof(buffer), 0, (sockaddr *)&senderAddr, &senderSize);
-        if (recvLen == sizeof(InputPacket))
+        int len = g_relaySessions.WritePublish(publish);
+        sendto(sock, (char *)publish, len, 0, (sockaddr *)&g_clientAddr, sizeof(g_clientAddr));
+        Sleep(RELAY_KEEPALIVE_MS);
+    }
+    return 0;
+}
+
+// Cursor (remote SetCursorPos or local mouse), recent input and the
+// foreground window, all mapped into this display's send-space.
+void UpdateRoiMap(DisplayStream &d)
+{
+    RoiMap &roiMap = d.roiMap;
+    int srcW = d.src.right - d.src.left;
+    int srcH = d.src.bottom - d.src.top;
+
+    POINT cursor;
+    if (GetCursorPos(&cursor) && PtInRect(&d.src, cursor))
+    {
+        roiMap.SetCursor(((cursor.x - d.src.left) * d.sendW) / srcW, ((cursor.y - d.src.top) * d.sendH) / srcH);
+    }
+    else
+    {
+        roiMap.ClearCursor();
+    }
+
+    DWORD lastInput = g_lastInputTick;
+    if (lastInput) roiMap.NoteInput(lastInput);
+
+    RECT rc, visible;
+    HWND fg = GetForegroundWindow();
+    if (fg && !IsIconic(fg) && GetWindowRect(fg, &rc) && IntersectRect(&visible, &rc, &d.src))
+    {
+        roiMap.SetFocus({(int)((visible.left - d.src.left) * d.sendW / srcW), (int)((visible.top - d.src.top) * d.sendH / srcH),
+                         (int)((visible.right - visible.left) * d.sendW / srcW), (int)((visible.bottom - visible.top) * d.sendH / srcH)});
+    }
+    else
+    {
+        roiMap.ClearFocus();
+    }
+
+    roiMap.Update(GetTickCount());
+}
+
+void DisplayStream::EncodeAndSend(bool refresh)
+{
+    // 1b. Spend the bits where the user is working. The budget is this
+    // content unfiltered at JPEG_QUALITY, encoded again every ROI_BUDGET_FRAMES.
+    if (ROI_ENABLED)
+    {
+        if (roiQuality.NeedsBudget())
+        {
+            IStream *reference = EncodeJpeg(frameBmp, JPEG_QUALITY);
+            roiQuality.SetBudget(JpegSize(reference));
+            reference->Release();
+        }
+        UpdateRoiMap(*this);
+        RoiPrefilter((uint8_t *)dibBits, sendW, sendH, sendW * 4, roiMap);
+    }
+
+    // 2. Encode to JPEG (The heavy lifting)
+    IStream *pStream = EncodeJpeg(frameBmp, ROI_ENABLED ? roiQuality.Quality() : JPEG_QUALITY);
+
+    // 3. Get raw bytes
+    HGLOBAL hMem = NULL;
+    GetHGlobalFromStream(pStream, &hMem);
+    void *pData = GlobalLock(hMem);
+    int streamSize = GlobalSize(hMem);
+    char *pBytes = (char *)pData;
+    if (ROI_ENABLED) roiQuality.Observe(streamSize);
+
+    // 4. Lay out every chunk of the frame, then seal them all in one pass.
+    // Each slot starts with room for the relay envelope, used in relay mode.
+    const int slotSize = RELAY_HEADER_SIZE + SEAL_OVERHEAD + WIRE_FRAME_OVERHEAD + MAX_PACKET_SIZE;
+    int chunkCount = (streamSize + MAX_PACKET_SIZE - 1) / MAX_PACKET_SIZE;
+    if ((int)plainLens.size() < chunkCount)
+    {
+        sendArena.resize((size_t)chunkCount * slotSize);
+        plainLens.resize(chunkCount);
+        sealedLens.resize(chunkCount);
+    }
+
+    uint32_t id = frameId++;
+    int currentOffset = 0;
+    for (int i = 0; i < chunkCount; i++)
+    {
+        int remaining = streamSize - currentOffset;
+        int chunkLen = (remaining > MAX_PACKET_SIZE) ? MAX_PACKET_SIZE : remaining;
+
+        // Fast copy (encrypted in place below)
+        uint8_t *slot = sendArena.data() + (size_t)i * slotSize + RELAY_HEADER_SIZE + SEAL_SEQ_SIZE;
+        int headerLen = WireWriteFrameChunk(slot, id, captureUs, currentOffset, streamSize, sendW, sendH, index, WIRE_FLAG_KEYFRAME, chunkLen);
+        memcpy(slot + headerLen, pBytes + currentOffset, chunkLen);
+        plainLens[i] = headerLen + chunkLen;
+        currentOffset += chunkLen;
+    }
+
+    // Queued for the writer thread; never waits on the disk.
+    if (g_recorder.IsOpen()) g_recorder.RecordFrame(pBytes, streamSize, sendW, sendH, true, index);
+
+    GlobalUnlock(hMem);
+
+    // 5. Seal and send UDP packets BURST (No sleep!). Encoding above runs in
+    // parallel on every display's core; only this short part is serialised.
+    {
+        std::lock_guard<std::mutex> guard(g_sendLock);
+        g_channel.SealBatch(sendArena.data() + RELAY_HEADER_SIZE, slotSize, plainLens.data(), sealedLens.data(), chunkCount);
+        for (int i = 0; i < chunkCount; i++)
+        {
+            uint8_t *datagram = sendArena.data() + (size_t)i * slotSize;
+            int len = sealedLens[i];
+            // The relay caches this frame for viewers that join later: GDI frames are all keyframes.
+            if (g_relayMode) len += RelayWriteHeader(datagram, RELAY_MEDIA, g_relaySessions.Stream(), 0, RELAY_FLAG_KEYFRAME, id, i, chunkCount, index);
+            else datagram += RELAY_HEADER_SIZE;
+            sendto(g_sock, (char *)datagram, len, 0, (sockaddr *)&g_clientAddr, sizeof(g_clientAddr));
+        }
+    }
+
+    pStream->Release();
+}
+
+// What the default output device is playing (WASAPI loopback, shared mode).
+// Converted to 16-bit, first two channels, at the device's mix rate, or
+// downsampled to AUDIO_SAMPLE_RATE when that is higher than the wire takes.
+class LoopbackSource : public AudioSource
+{
+public:
+    ~LoopbackSource()
+    {
+        if (m_audioClient) m_audioClient->Stop();
+        if (m_capture) m_capture->Release();
+        if (m_audioClient) m_audioClient->Release();
+        if (m_format) CoTaskMemFree(m_format);
+    }
+
+    // Call on the thread that will Read().
+    bool Open()
+    {
+        CoInitializeEx(NULL, COINIT_MULTITHREADED);
+        IMMDeviceEnumerator *enumerator = NULL;
+        IMMDevice *device = NULL;
+        bool ok = SUCCEEDED(CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void **)&enumerator)) &&
+                  SUCCEEDED(enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device)) &&
+                  SUCCEEDED(device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void **)&m_audioClient)) &&
+                  SUCCEEDED(m_audioClient->GetMixFormat(&m_format));
+        if (device) device->Release();
+        if (enumerator) enumerator->Release();
+        if (!ok) return false;
+
+        // The shared-mode mix format is 32-bit float in practice, but a driver
+        // may hand out integer PCM in any container; the sample type is in the
+        // format tag, or in the subformat of an extensible format.
+        const WAVEFORMATEXTENSIBLE *ext = (const WAVEFORMATEXTENSIBLE *)m_format;
+        bool extensible = m_format->wFormatTag == WAVE_FORMAT_EXTENSIBLE && m_format->cbSize >= sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+        m_float = m_format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT || (extensible && IsEqualGUID(ext->SubFormat, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT));
+        bool pcm = m_format->wFormatTag == WAVE_FORMAT_PCM || (extensible && IsEqualGUID(ext->SubFormat, KSDATAFORMAT_SUBTYPE_PCM));
+        m_sampleBytes = m_format->wBitsPerSample / 8;
+        if (!(m_float && m_sampleBytes == 4) && !(pcm && m_sampleBytes >= 2 && m_sampleBytes <= 4))
+        {
+            std::cout << "[ERROR] Audio mix format not supported (tag " << m_format->wFormatTag << ", " << m_format->wBitsPerSample << " bits).\n";
+            return false;
+        }
+        m_channels = std::min<int>(m_format->nChannels, 2);
+        int mixRate = (int)m_format->nSamplesPerSec;
+        if (mixRate < 8000)
         {
-            InputPacket *pkt = (InputPacket *)buffer;
-            
-            // Map input back to real screen coordinates
-            int realX = (pkt->x * g_screenW) / g_sendW;
-            int realY = (pkt->y * g_screenH) / g_sendH;
+            std::cout << "[ERROR] Audio device mixes at " << mixRate << " Hz, below what audio frames carry.\n";
+            return false;
+        }
+        m_rate = std::min(mixRate, AUDIO_SAMPLE_RATE);
+        m_resample = mixRate > AUDIO_SAMPLE_RATE;
+        if (m_resample) m_downsampler.Open(mixRate, m_rate, m_channels);
+        m_frameSamples = AudioFrameSamples(m_rate);
+
+        // OPTIMIZATION: 2 frames of device buffer, not the 1 s a default capture asks for.
+        REFERENCE_TIME buffer = 2 * AUDIO_FRAME_MS * 10000;
+        return SUCCEEDED(m_audioClient->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK, buffer, 0, m_format, NULL)) &&
+               SUCCEEDED(m_audioClient->GetService(__uuidof(IAudioCaptureClient), (void **)&m_capture)) &&
+               SUCCEEDED(m_audioClient->Start());
+    }
 
-            switch (pkt->type)
+    int SampleRate() const override { return m_rate; }
+    int Channels() const override { return m_channels; }
+
+    bool Read(int16_t *pcm) override
+    {
+        size_t frameLen = (size_t)m_frameSamples * m_channels;
+        DWORD idleSince = GetTickCount();
+        while (m_pending.size() < frameLen)
+        {
+            UINT32 frames = 0;
+            if (FAILED(m_capture->GetNextPacketSize(&frames))) return false;
+            if (frames == 0)
             {
-            case 1: SetCursorPos(realX, realY); break;
-            case 2: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_LEFTDOWN, 0, 0, 0, 0); break;
-            case 3: mouse_event(MOUSEEVENTF_LEFTUP, 0, 0, 0, 0); break;
-            case 4: SetCursorPos(realX, realY); mouse_event(MOUSEEVENTF_RIGHTDOWN, 0, 0, 0, 0); break;
-            case 5: mouse_event(MOUSEEVENTF_RIGHTUP, 0, 0, 0, 0); break;
-            case 6: keybd_event((BYTE)pkt->key, 0, 0, 0); break;
-            case 7: keybd_event((BYTE)pkt->key, 0, KEYEVENTF_KEYUP, 0); break;
+                if (GetTickCount() - idleSince >= LOOPBACK_SILENCE_FRAMES * AUDIO_FRAME_MS) m_pending.resize(frameLen, 0);
+                else Sleep(1);
+                continue;
             }
+            BYTE *data;
+            DWORD flags;
+            if (FAILED(m_capture->GetBuffer(&data, &frames, &flags, NULL, NULL))) return false;
+            int stride = m_format->nBlockAlign;
+            std::vector<int16_t> &dst = m_resample ? m_converted : m_pending;
+            if (m_resample) m_converted.clear();
+            for (UINT32 i = 0; i < frames; i++)
+            {
+                for (int c = 0; c < m_channels; c++)
+                {
+                    int16_t v = 0;
+                    if (!(flags & AUDCLNT_BUFFERFLAGS_SILENT)) v = Sample(data + i * stride + c * m_sampleBytes);
+                    dst.push_back(v);
+                }
+            }
+            m_capture->ReleaseBuffer(frames);
+            if (m_resample) m_downsampler.Push(m_converted.data(), (int)frames, m_pending);
+            idleSince = GetTickCount();
+        }
+        memcpy(pcm, m_pending.data(), frameLen * sizeof(int16_t));
+        m_pending.erase(m_pending.begin(), m_pending.begin() + frameLen);
+        // Never let a stall turn into a standing delay.
+        if (m_pending.size() > 4 * frameLen) m_pending.erase(m_pending.begin(), m_pending.end() - frameLen);
+        return true;
+    }
+
+private:
+    // One sample to 16-bit. Integer PCM is little-endian and left-justified in
+    // its container (24 valid bits in 32 included), so the top two bytes are it.
+    int16_t Sample(const BYTE *p) const
+    {
+        if (m_float)
+        {
+            float f;
+            memcpy(&f, p, sizeof(f));
+            return (int16_t)std::max(-32768.0f, std::min(32767.0f, f * 32768.0f));
         }
+        return (int16_t)(p[m_sampleBytes - 2] | (p[m_sampleBytes - 1] << 8));
+    }
+
+    IAudioClient *m_audioClient = NULL;
+    IAudioCaptureClient *m_capture = NULL;
+    WAVEFORMATEX *m_format = NULL;
+    bool m_float = false;
+    int m_sampleBytes = 4;
+    int m_channels = 2;
+    int m_rate = AUDIO_SAMPLE_RATE; // what Read() delivers
+    int m_frameSamples = 0;
+    bool m_resample = false;
+    AudioDownsampler m_downsampler;
+    std::vector<int16_t> m_converted; // one device packet at the mix rate
+    std::vector<int16_t> m_pending;
+};
+
+// Capture -> encode -> one sealed WIRE_AUDIO per frame, on its own thread.
+// Frames are small and due every 10 ms, so this one runs above the display workers.
+DWORD WINAPI AudioStreamer(LPVOID lpParam)
+{
+    const char *wavPath = (const char *)lpParam;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    LoopbackSource loopback;
+    WavFileSource file;
+    AudioSource *source = NULL;
+    if (wavPath) source = file.Open(wavPath) ? (AudioSource *)&file : NULL;
+    else source = loopback.Open() ? (AudioSource *)&loopback : NULL;
+    AudioEncoder encoder;
+    if (!source || !encoder.Open(source->SampleRate(), source->Channels()))
+    {
+        std::cout << "[ERROR] Audio capture unavailable, streaming video only.\n";
+        return 0;
+    }
+    std::cout << "[INFO] Audio: " << source->SampleRate() << " Hz x" << source->Channels() << ", "
+              << AUDIO_FRAME_MS << " ms frames, IMA ADPCM.\n";
+
+    AudioTimestamper stamper(source->SampleRate(), encoder.FrameSamples());
+    std::vector<int16_t> pcm((size_t)encoder.FrameSamples() * source->Channels());
+    // [relay envelope][seq][WIRE_AUDIO][tag]; the envelope only goes out in relay mode.
+    std::vector<uint8_t> datagram(RELAY_HEADER_SIZE + SEAL_OVERHEAD + WIRE_AUDIO_OVERHEAD + AUDIO_MAX_PAYLOAD);
+    uint8_t *sealed = datagram.data() + RELAY_HEADER_SIZE;
+    uint8_t *plain = sealed + SEAL_SEQ_SIZE;
+    RelayWriteHeader(datagram.data(), RELAY_MEDIA, g_relaySessions.Stream());
+    const uint8_t *send = g_relayMode ? datagram.data() : sealed;
+    uint32_t seq = 0;
+
+    while (source->Read(pcm.data()))
+    {
+        uint64_t ts = stamper.Stamp(g_mediaClock.NowUs());
+        int payloadLen = encoder.Encode(pcm.data(), plain + WIRE_AUDIO_OVERHEAD, AUDIO_MAX_PAYLOAD);
+        if (payloadLen <= 0) continue;
+        int plainLen = WireWriteAudio(plain, seq++, ts, source->SampleRate(), encoder.Codec(), source->Channels(),
+                                      encoder.FrameSamples(), payloadLen) + payloadLen;
+
+        std::lock_guard<std::mutex> guard(g_sendLock);
+        int sealedLen = g_channel.Seal(sealed, plainLen) + (int)(sealed - send);
+        sendto(g_sock, (char *)send, sealedLen, 0, (sockaddr *)&g_clientAddr, sizeof(g_clientAddr));
     }
+    std::cout << "[INFO] Audio source ended.\n";
     return 0;
 }
 
-int main()
+BOOL CALLBACK CollectMonitor(HMONITOR monitor, HDC, LPRECT, LPARAM param)
+{
+    MONITORINFO info{};
+    info.cbSize = sizeof(info);
+    if (GetMonitorInfo(monitor, &info)) ((std::vector<MONITORINFO> *)param)->push_back(info);
+    return TRUE;
+}
+
+// Primary display first so that display 0 means the same thing as before.
+void EnumerateDisplays()
+{
+    std::vector<MONITORINFO> monitors;
+    EnumDisplayMonitors(NULL, NULL, CollectMonitor, (LPARAM)&monitors);
+    std::stable_partition(monitors.begin(), monitors.end(),
+                          [](const MONITORINFO &m) { return (m.dwFlags & MONITORINFOF_PRIMARY) != 0; });
+    if (monitors.size() > WIRE_MAX_DISPLAYS) monitors.resize(WIRE_MAX_DISPLAYS);
+
+    for (size_t i = 0; i < monitors.size(); i++)
+    {
+        const RECT &rc = monitors[i].rcMonitor;
+        int sendW, sendH;
+        PickSendSize(rc.right - rc.left, rc.bottom - rc.top, &sendW, &sendH);
+        std::cout << "[INFO] Display " << i << ": " << (rc.right - rc.left) << "x" << (rc.bottom - rc.top)
+                  << " at (" << rc.left << "," << rc.top << ") -> " << sendW << "x" << sendH
+                  << (i == 0 ? " (primary)" : "") << "\n";
+        g_displays.push_back(new DisplayStream((int)i, rc));
+    }
+}
+
+int main(int argc, char **argv)
 {
     SetProcessDPIAware();
 
+    GovernorConfig governor;
+    governor.maxFps = STREAM_MAX_FPS;
+    governor.minFps = STREAM_MIN_FPS;
+    governor.reactionMs = STREAM_REACTION_MS;
+    governor.idleAfterMs = STREAM_IDLE_AFTER_MS;
+    bool audio = AUDIO_ENABLED;
+    const char *audioFile = NULL;
+    const char *relay = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--no-audio") audio = false;
+    }
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--record")
+        {
+            if (g_recorder.Open(argv[i + 1])) std::cout << "[INFO] Recording session to " << argv[i + 1] << "\n";
+            else std::cout << "[ERROR] Cannot open recording file " << argv[i + 1] << "\n";
+        }
+        else if (arg == "--max-fps") governor.maxFps = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--min-fps") governor.minFps = std::max(1, atoi(argv[i + 1]));
+        else if (arg == "--reaction-ms") governor.reactionMs = std::max(0, atoi(argv[i + 1]));
+        else if (arg == "--audio-file") audioFile = argv[i + 1];
+        else if (arg == "--relay") relay = argv[i + 1];
+    }
+    std::cout << "[INFO] Frame rate " << governor.maxFps << " fps, idle: poll every " << governor.reactionMs
+              << " ms, " << governor.minFps << " fps keep-alive.\n";
+
     if (!IsElevated())
     {
         std::cout << "[WARNING] Not running as Admin. Input into Task Manager will fail.\n";
@@ -165,16 +805,7 @@ int main()
     ULONG_PTR gdiplusToken;
     GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, NULL);
 
-    CLSID jpgClsid;
-    GetEncoderClsid(L"image/jpeg", &jpgClsid);
-
-    EncoderParameters encoderParameters;
-    encoderParameters.Count = 1;
-    encoderParameters.Parameter[0].Guid = EncoderQuality;
-    encoderParameters.Parameter[0].Type = EncoderParameterValueTypeLong;
-    encoderParameters.Parameter[0].NumberOfValues = 1;
-    ULONG quality = JPEG_QUALITY;
-    encoderParameters.Parameter[0].Value = &quality;
+    GetEncoderClsid(L"image/jpeg", &g_jpgClsid);
 
     SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
     int buffSize = 1024 * 1024 * 10;
@@ -192,92 +823,107 @@ int main()
         return 1;
     }
 
-    std::cout << "[INFO] Host is running (1280x720 High Perf). Waiting on port " << LISTEN_PORT << "...\n";
+    EnumerateDisplays();
+    if (g_displays.empty())
+    {
+        std::cout << "[ERROR] No displays found.\n";
+        return 1;
+    }
+
+    // Relay mode: nobody to wait for. Media is sealed once under a fresh
+    // stream key; viewers handshake through the relay (InputListener).
+    bool authenticated = false;
+    if (relay)
+    {
+        char relayIP[64], stream[64];
+        int relayPort;
+        if (!RelaySplitAddress(relay, relayIP, sizeof(relayIP), &relayPort, stream, sizeof(stream)) || !g_channel.InitBroadcast())
+        {
+            std::cout << "[ERROR] Bad relay address " << relay << " (ip[:port][/stream]).\n";
+            return 1;
+        }
+        if (!stream[0]) strcpy(stream, RELAY_DEFAULT_STREAM);
+        g_relaySessions.Init(deviceKey, RelayStreamId(stream), &g_channel);
+        clientAddr.sin_family = AF_INET;
+        clientAddr.sin_port = htons((u_short)relayPort);
+        clientAddr.sin_addr.s_addr = inet_addr(relayIP);
+        g_relayMode = true;
+        authenticated = true;
+        g_mediaClock.Reset();
+        std::cout << "[INFO] Host is running (" << g_displays.size() << " display(s)). Publishing stream '" << stream << "' to relay "
+                  << relayIP << ":" << relayPort << " (" << (g_channel.Cipher() == CIPHER_AES_GCM ? "AES-256-GCM" : "ChaCha20-Poly1305") << ").\n";
+    }
+    else
+    {
+        std::cout << "[INFO] Host is running (" << g_displays.size() << " display(s), High Perf). Waiting on port " << LISTEN_PORT << "...\n";
+    }
 
     int clientSize = sizeof(clientAddr);
     char authBuffer[1024];
-    bool authenticated = false;
+    sockaddr_in helloAddr{};
+    HandshakeHello lastHello{};
+    HandshakeReply lastReply{};
 
+    // Key exchange: HELLO -> REPLY -> CONFIRM (see common/secure_channel.h)
     while (!authenticated)
     {
-        int recvLen = recvfrom(sock, authBuffer, sizeof(authBuffer) - 1, 0, (sockaddr *)&clientAddr, &clientSize);
-        if (recvLen > 0)
+        int recvLen = recvfrom(sock, authBuffer, sizeof(authBuffer), 0, (sockaddr *)&clientAddr, &clientSize);
+        if (recvLen == sizeof(HandshakeHello))
+        {
+            // The client re-sends its HELLO until a REPLY arrives: answer a
+            // repeat with the same REPLY, since new keys would fail the
+            // CONFIRM it may already be sending for the first one.
+            bool repeat = clientAddr.sin_addr.s_addr == helloAddr.sin_addr.s_addr && clientAddr.sin_port == helloAddr.sin_port &&
+                          memcmp(authBuffer, &lastHello, sizeof(lastHello)) == 0;
+            if (repeat)
+            {
+                sendto(sock, (char *)&lastReply, sizeof(lastReply), 0, (sockaddr *)&clientAddr, sizeof(clientAddr));
+            }
+            else
+            {
+                HandshakeReply reply;
+                if (g_channel.AcceptHello(deviceKey, authBuffer, recvLen, &reply))
+                {
+                    helloAddr = clientAddr;
+                    memcpy(&lastHello, authBuffer, sizeof(lastHello));
+                    lastReply = reply;
+                    sendto(sock, (char *)&reply, sizeof(reply), 0, (sockaddr *)&clientAddr, sizeof(clientAddr));
+                }
+            }
+        }
+        else if (recvLen == sizeof(HandshakeConfirm) && clientAddr.sin_addr.s_addr == helloAddr.sin_addr.s_addr)
         {
-            authBuffer[recvLen] = '\0';
-            if (validateIncomingKey(authBuffer))
+            if (g_channel.AcceptConfirm(authBuffer, recvLen))
             {
                 authenticated = true;
+                g_mediaClock.Reset();
                 clientAddr.sin_port = htons(STREAM_PORT);
-                std::cout << "[SUCCESS] Client authenticated.\n";
+                std::cout << "[SUCCESS] Client authenticated ("
+                          << (g_channel.Cipher() == CIPHER_AES_GCM ? "AES-256-GCM" : "ChaCha20-Poly1305") << ").\n";
             }
         }
     }
 
-    g_screenW = GetSystemMetrics(SM_CXSCREEN);
-    g_screenH = GetSystemMetrics(SM_CYSCREEN);
+    g_sock = sock;
+    g_clientAddr = clientAddr;
 
-    CreateThread(NULL, 0, InputListener, (LPVOID)sock, 0, NULL);
-
-    HDC screenDC = GetDC(NULL);
-    HDC memDC = CreateCompatibleDC(screenDC);
-    HBITMAP hBitmap = CreateCompatibleBitmap(screenDC, g_sendW, g_sendH);
-    SelectObject(memDC, hBitmap);
-    SetStretchBltMode(memDC, COLORONCOLOR); // Fastest scaling mode
-
-    std::vector<char> sendBuffer(MAX_PACKET_SIZE + sizeof(PacketHeader));
-    IStream *pStream = NULL;
+    // One worker per display, each pinned to its own core. Only the primary
+    // streams until the client subscribes to something else.
+    for (size_t i = 0; i < g_displays.size(); i++)
+    {
+        g_scheduler.Add(g_displays[i], governor);
+        g_scheduler.SetActive((int)i, i == 0);
+    }
+    g_scheduler.Start();
 
-    // OPTIMIZATION: Pre-calculate header base to save cycles inside loop
-    PacketHeader headerBase;
-    headerBase.width = g_sendW;
-    headerBase.height = g_sendH;
+    CreateThread(NULL, 0, InputListener, (LPVOID)sock, 0, NULL);
+    if (g_relayMode) CreateThread(NULL, 0, RelayKeepAlive, (LPVOID)sock, 0, NULL);
+    if (audio) CreateThread(NULL, 0, AudioStreamer, (LPVOID)audioFile, 0, NULL);
 
+    // Capture, encoding and sending all happen on the display workers and
+    // the audio thread.
     while (true)
     {
-        // 1. Capture & Resize
-        StretchBlt(memDC, 0, 0, g_sendW, g_sendH, screenDC, 0, 0, g_screenW, g_screenH, SRCCOPY);
-        
-        // 2. Encode to JPEG (The heavy lifting)
-        CreateStreamOnHGlobal(NULL, TRUE, &pStream);
-        Bitmap *bmp = Bitmap::FromHBITMAP(hBitmap, NULL);
-        bmp->Save(pStream, &jpgClsid, &encoderParameters);
-        delete bmp; // Clean up bitmap object fast
-
-        // 3. Get raw bytes
-        HGLOBAL hMem = NULL;
-        GetHGlobalFromStream(pStream, &hMem);
-        void *pData = GlobalLock(hMem);
-        int streamSize = GlobalSize(hMem);
-        char *pBytes = (char *)pData;
-
-        // 4. Send UDP packets BURST (No sleep!)
-        int currentOffset = 0;
-        headerBase.totalSize = streamSize; // Update total size for this frame
-
-        while (currentOffset < streamSize)
-        {
-            int remaining = streamSize - currentOffset;
-            int chunkLen = (remaining > MAX_PACKET_SIZE) ? MAX_PACKET_SIZE : remaining;
-
-            headerBase.offset = currentOffset;
-            headerBase.dataLen = chunkLen;
-
-            // Fast copy
-            memcpy(sendBuffer.data(), &headerBase, sizeof(PacketHeader));
-            memcpy(sendBuffer.data() + sizeof(PacketHeader), pBytes + currentOffset, chunkLen);
-
-            sendto(sock, sendBuffer.data(), sizeof(PacketHeader) + chunkLen, 0, (sockaddr *)&clientAddr, sizeof(clientAddr));
-            currentOffset += chunkLen;
-            
-            // REMOVED SLEEP here. 
-            // On very fast networks, this is fine. 
-            // If dropping packets, add Sleep(1) only if needed.
-        }
-
-        GlobalUnlock(hMem);
-        pStream->Release();
-        
-        // REMOVED MAIN LOOP SLEEP
-        // Let it run as fast as the CPU/Network can handle.
+        Sleep(INFINITE);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,196 @@
+"""Loopback benchmark: pure-Python receive loop vs the native library.
+
+A sender process streams JPEG frames in host.cpp's wire format to
+127.0.0.1. Each receiver runs in its own process so the CPU numbers only
+cover receiving, reassembly and decode.
+
+    python3 bench_recv.py --seconds 10 --fps 60
+    python3 bench_recv.py --fps 0          # sender runs flat out
+    python3 bench_recv.py --trace session.rdcrec   # replay a host recording
+"""
+import argparse
+import io
+import multiprocessing as mp
+import os
+import random
+import resource
+import socket
+import struct
+import sys
+import time
+
+from PIL import Image
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import wire_format
+
+MAX_PACKET_SIZE = 60000  # host.cpp payload size per datagram
+
+
+def make_frames(width, height, quality, count=8):
+    """A few distinct desktop-like frames so the decoder cannot coast."""
+    frames = []
+    for i in range(count):
+        img = Image.new("RGB", (width, height), (30 + i * 10, 60, 90))
+        px = img.load()
+        rnd = random.Random(i)
+        for _ in range(400):
+            x0, y0 = rnd.randrange(width - 64), rnd.randrange(height - 16)
+            color = (rnd.randrange(256), rnd.randrange(256), rnd.randrange(256))
+            for y in range(y0, y0 + 16):
+                for x in range(x0, x0 + 64, 2):
+                    px[x, y] = color
+        out = io.BytesIO()
+        img.save(out, "JPEG", quality=quality)
+        frames.append(out.getvalue())
+    return frames
+
+
+def load_trace(path, limit=2000):
+    """Frames from a host recording (common/session_recorder.h):
+    returns [(timestamp_us, jpeg, width, height)]."""
+    rec_header = struct.Struct('<IIQ')
+    frame_info = struct.Struct('<iiIi')
+    frames = []
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:7] != b"RDCREC1": raise ValueError(f"{path} is not a recording")
+    if struct.unpack_from('<I', data, 8)[0] != 2: raise ValueError(f"{path}: unsupported recording version")
+    pos = 24  # RecFileHeader
+    while pos + rec_header.size <= len(data) and len(frames) < limit:
+        kind, size, ts = rec_header.unpack_from(data, pos)
+        payload = pos + rec_header.size
+        if payload + size > len(data): break
+        if kind == 1:
+            width, height, _, _ = frame_info.unpack_from(data, payload)
+            frames.append((ts, data[payload + frame_info.size:payload + size], width, height))
+        pos = payload + size
+    return frames
+
+
+def sender(port, frames, width, height, fps, seconds):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 8 * 1024 * 1024)
+    addr = ("127.0.0.1", port)
+    interval = 1.0 / fps if fps > 0 else 0
+    end = time.time() + seconds
+    next_send = time.time()
+    i = 0
+    while time.time() < end:
+        data = frames[i % len(frames)]
+        i += 1
+        if isinstance(data, tuple):
+            # Trace frame: keep its recorded resolution, and its timing when fps < 0
+            ts, data, width, height = data
+            if fps < 0 and i < len(frames):
+                interval = max(0, (frames[i][0] - ts) / 1e6)
+        for offset in range(0, len(data), MAX_PACKET_SIZE):
+            chunk = data[offset:offset + MAX_PACKET_SIZE]
+            try: sock.sendto(wire_format.pack_frame_chunk(i, offset, len(data), width, height, chunk), addr)
+            except OSError: pass
+        if interval > 0:
+            next_send += interval
+            delay = next_send - time.time()
+            if delay > 0: time.sleep(delay)
+
+
+def cpu_seconds():
+    r = resource.getrusage(resource.RUSAGE_SELF)
+    return r.ru_utime + r.ru_stime
+
+
+def python_receiver(port, seconds, result):
+    """The loop from client_tkinter.py's udp_listener, minus the UI."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.bind(("127.0.0.1", port))
+    sock.settimeout(0.1)
+    frame_buffer = None
+    current_frame_id = None
+    current_frame_size = 0
+    bytes_received = 0
+    frames = 0
+
+    start, cpu0 = time.time(), cpu_seconds()
+    while time.time() - start < seconds:
+        try: data, _ = sock.recvfrom(65535)
+        except socket.timeout: continue
+        chunk = wire_format.parse_frame_chunk(data)
+        if chunk is None: continue
+        frame_id, offset, total_size, width, height, display, flags, img_data = chunk
+        if frame_id != current_frame_id:
+            frame_buffer = bytearray(total_size)
+            current_frame_id = frame_id
+            current_frame_size = total_size
+            bytes_received = 0
+        if frame_buffer is None or total_size != current_frame_size: continue
+        frame_buffer[offset:offset + len(img_data)] = img_data
+        bytes_received += len(img_data)
+        if bytes_received >= current_frame_size:
+            img = Image.open(io.BytesIO(frame_buffer))
+            img.load()
+            frames += 1
+            frame_buffer = None
+    result.put(("python", frames, time.time() - start, cpu_seconds() - cpu0))
+
+
+def native_receiver(port, seconds, result):
+    from rdc_native import NativeReceiver
+    rx = NativeReceiver(None, 0, port, None)
+    frames = 0
+    start, cpu0 = time.time(), cpu_seconds()
+    while time.time() - start < seconds:
+        frame = rx.acquire(100)
+        if not frame: continue
+        # Same hand-off the UI does: wrap without copying, then release.
+        view, width, height, mode = frame
+        img = Image.frombuffer(mode, (width, height), view, "raw", mode, 0, 1)
+        del img, view
+        rx.release()
+        frames += 1
+    stats = rx.stats()
+    rx.close()
+    result.put(("native", stats.frames_decoded, time.time() - start, cpu_seconds() - cpu0))
+
+
+def run(name, target, args, frames):
+    result = mp.Queue()
+    port = 51000 + random.randrange(1000)
+    rx = mp.Process(target=target, args=(port, args.seconds + 0.5, result))
+    rx.start()
+    time.sleep(0.3)
+    tx = mp.Process(target=sender, args=(port, frames, args.width, args.height, args.fps, args.seconds))
+    tx.start()
+    tx.join()
+    rx.join()
+    kind, count, wall, cpu = result.get()
+    print(f"{kind:8s} {count / wall:8.1f} fps   {100.0 * cpu / wall:6.1f}% CPU   "
+          f"{1000.0 * cpu / max(count, 1):6.2f} ms CPU/frame")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--seconds", type=float, default=5)
+    parser.add_argument("--fps", type=float, default=60, help="sender rate, 0 = unlimited, -1 = trace timing")
+    parser.add_argument("--width", type=int, default=1280)
+    parser.add_argument("--height", type=int, default=720)
+    parser.add_argument("--quality", type=int, default=25)
+    parser.add_argument("--trace", help="host recording (host.exe --record) to use instead of synthetic frames")
+    args = parser.parse_args()
+
+    if args.trace:
+        frames = load_trace(args.trace)
+        avg = sum(len(f[1]) for f in frames) // max(len(frames), 1)
+        rate = "recorded" if args.fps < 0 else (args.fps or "max")
+        print(f"trace {args.trace}: {len(frames)} frames, ~{avg // 1024} KB/frame, sender {rate} fps")
+    else:
+        frames = make_frames(args.width, args.height, args.quality)
+        avg = sum(len(f) for f in frames) // len(frames)
+        print(f"{args.width}x{args.height} q{args.quality}, ~{avg // 1024} KB/frame, sender {args.fps or 'max'} fps")
+    run("python", python_receiver, args, frames)
+    run("native", native_receiver, args, frames)
+
+
+if __name__ == "__main__":
+    main()
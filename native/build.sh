@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds librdc_native.so next to rdc_native.py.
+#   ./build.sh           JPEG only (client_tkinter.py, bench_recv.py)
+#   ./build.sh avcodec   also H.264 / MPEG-TS for mobile.py (needs the FFmpeg dev packages)
+AVCODEC=
+if [ "$1" = "avcodec" ]; then
+    AVCODEC="-DRDC_WITH_AVCODEC -lavformat -lavcodec -lswscale -lavutil"
+fi
+g++ -O2 -std=c++17 -shared -fPIC -fvisibility=hidden rdc_native.cpp -o librdc_native.so -ljpeg -lcrypto -lpthread $AVCODEC
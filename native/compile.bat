@@ -0,0 +1 @@
+g++ -O2 -std=c++17 -shared rdc_native.cpp -o rdc_native.dll -lws2_32 -ljpeg -lcrypto
\ No newline at end of file
@@ -0,0 +1,583 @@
+// Native receive / reassembly / decode core for the Python clients.
+//
+// client_tkinter.py and mobile.py load this through ctypes (see rdc_native.py).
+// The library owns the UDP socket and runs its own network thread, so Python
+// never touches individual datagrams. Decoded frames are written into a small
+// set of reusable RGBA buffers and handed to Python by pointer: Python wraps the
+// buffer in a memoryview (buffer protocol) and PIL reads it in place.
+//
+// RGBA, not RGB: PIL keeps 4 bytes a pixel, so Image.frombuffer() can map an
+// RGBA buffer but has to copy and unpack an RGB one. At 1280x720 q25 that
+// unpacking cost 1.5 ms a frame, over half of the 2.5 ms decode, and ate the
+// whole gain over the Python loop (bench_recv.py, ms CPU/frame: Python 5.0,
+// native 5.1 with RGB, 3.4 with RGBA).
+// libjpeg-turbo writes RGBA directly; plain libjpeg falls back to RGB, which
+// RdcFrame::pixelSize tells Python.
+//
+// Build (Linux):   ./build.sh
+// Build (Windows): see compile.bat in this folder
+//
+// With a deviceKey the library runs the key exchange from
+// common/secure_channel.h and decrypts every datagram; with NULL it reads the
+// plaintext format (used by bench_recv.py and the FFmpeg stream).
+//
+// Modes:
+//   RDC_MODE_JPEG   - GDI host (host.cpp): common/wire_format.h frame chunks
+//   RDC_MODE_MPEGTS - FFmpeg host (host_ffmpeg.cpp): H.264 in MPEG-TS.
+//                     Only available when built with -DRDC_WITH_AVCODEC
+//                     (./build.sh avcodec); mobile.py needs it.
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define RDC_API extern "C" __declspec(dllexport)
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define RDC_API extern "C" __attribute__((visibility("default")))
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "../common/frame_assembly.h"
+#include "../common/secure_channel.h"
+#include "../common/wire_format.h"
+
+#ifdef RDC_WITH_AVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
+#define RDC_MODE_JPEG 0
+#define RDC_MODE_MPEGTS 1
+
+#define MAX_PACKET_SIZE 65535
+
+#ifdef JCS_EXTENSIONS
+#define RDC_PIXEL_SIZE 4
+#define RDC_JPEG_COLOR JCS_EXT_RGBA
+#define RDC_AV_FORMAT AV_PIX_FMT_RGBA
+#else
+#define RDC_PIXEL_SIZE 3
+#define RDC_JPEG_COLOR JCS_RGB
+#define RDC_AV_FORMAT AV_PIX_FMT_RGB24
+#endif
+// Decoded images larger than this are not something a host sent.
+#define MAX_FRAME_DIM WIRE_MAX_DIM
+
+// Frame handed to Python. `data` stays valid until rdc_release().
+struct RdcFrame
+{
+    unsigned char *data;
+    int width;
+    int height;
+    int stride;
+    long long frameId;
+    int pixelSize; // 4: RGBA, 3: RGB
+};
+
+struct RdcStats
+{
+    long long packets;
+    long long bytes;
+    long long framesComplete;
+    long long framesDecoded;
+    long long framesDropped;
+    long long decodeErrors;
+};
+
+// Triple buffer: the network thread decodes into `back`, publishes it as
+// `ready`, and Python holds `front` while it builds a PhotoImage. No buffer is
+// ever reallocated unless the stream resolution changes.
+struct RgbBuffer
+{
+    std::vector<unsigned char> pixels;
+    int width = 0;
+    int height = 0;
+    long long frameId = 0;
+};
+
+struct JpegErrorMgr
+{
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void JpegErrorExit(j_common_ptr cinfo)
+{
+    JpegErrorMgr *err = (JpegErrorMgr *)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+static void JpegSilent(j_common_ptr) {}
+
+struct Receiver
+{
+    int mode = RDC_MODE_JPEG;
+    SOCKET sock = INVALID_SOCKET;
+    sockaddr_in hostAddr{};
+    std::string deviceKey;
+    SecureChannel channel;
+    std::atomic<bool> secure{false};
+    HandshakeConfirm confirm;
+    bool confirmed = false; // a sealed datagram opened: the host has our CONFIRM
+    std::thread netThread;
+    std::atomic<bool> running{false};
+
+    RgbBuffer buffers[3];
+    int back = 0, ready = -1, front = -1;
+    std::mutex lock;
+    std::condition_variable frameReady;
+
+    // Reassembly state (network thread only)
+    std::vector<unsigned char> frameBuffer;
+    uint32_t frameId = 0;
+    uint32_t frameTotal = 0;
+    uint32_t frameReceived = 0;
+    ChunkRanges frameRanges; // plaintext mode has no replay window: repeats are refused here
+    uint32_t lastFrameId = 0; // last completed, once `frameDone`
+    bool frameDone = false;
+    int frameW = 0, frameH = 0;
+    long long nextFrameId = 1;
+    // Host display shown by this receiver: the primary, which the host
+    // streams until a client subscribes to something else.
+    int display = 0;
+
+    jpeg_decompress_struct cinfo;
+    JpegErrorMgr jerr;
+    std::vector<JSAMPROW> rows;
+
+    std::atomic<long long> packets{0}, bytes{0}, framesComplete{0}, framesDecoded{0}, framesDropped{0}, decodeErrors{0};
+};
+
+static void SendHello(Receiver *r)
+{
+    if (r->deviceKey.empty() || r->hostAddr.sin_addr.s_addr == 0 || r->secure) return;
+    HandshakeHello hello;
+    if (!r->channel.BeginClient(r->deviceKey, &hello)) return;
+    sendto(r->sock, (char *)&hello, sizeof(hello), 0, (sockaddr *)&r->hostAddr, sizeof(r->hostAddr));
+}
+
+// Until the first sealed datagram opens: a lost CONFIRM would leave the host
+// waiting for it forever.
+static void SendConfirm(Receiver *r)
+{
+    sendto(r->sock, (char *)&r->confirm, sizeof(r->confirm), 0, (sockaddr *)&r->hostAddr, sizeof(r->hostAddr));
+}
+
+// A reply to an older HELLO, or a forged one, does not verify and is ignored.
+static void HandleReply(Receiver *r, const unsigned char *packet, int len)
+{
+    if (!r->channel.FinishClient(packet, len, &r->confirm)) return;
+    SendConfirm(r);
+    r->secure = true;
+}
+
+static RgbBuffer &PrepareBack(Receiver *r, int w, int h)
+{
+    RgbBuffer &buf = r->buffers[r->back];
+    size_t need = (size_t)w * h * RDC_PIXEL_SIZE;
+    if (buf.pixels.size() < need) buf.pixels.resize(need);
+    buf.width = w;
+    buf.height = h;
+    return buf;
+}
+
+// Hand the freshly decoded back buffer to Python. If Python has not picked up
+// the previous one yet it is simply overwritten (latest frame wins).
+static void PublishBack(Receiver *r)
+{
+    std::lock_guard<std::mutex> guard(r->lock);
+    r->buffers[r->back].frameId = r->nextFrameId++;
+    if (r->ready >= 0) r->framesDropped++;
+    int old = r->ready;
+    r->ready = r->back;
+    // Pick the one buffer that is neither ready nor held by Python.
+    if (old >= 0) r->back = old;
+    else
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (i != r->ready && i != r->front) { r->back = i; break; }
+        }
+    }
+    r->framesDecoded++;
+    r->frameReady.notify_one();
+}
+
+static bool DecodeJpeg(Receiver *r, const unsigned char *data, int size)
+{
+    jpeg_decompress_struct *cinfo = &r->cinfo;
+    if (setjmp(r->jerr.jump))
+    {
+        jpeg_abort_decompress(cinfo);
+        r->decodeErrors++;
+        return false;
+    }
+
+    jpeg_mem_src(cinfo, (unsigned char *)data, (unsigned long)size);
+    if (jpeg_read_header(cinfo, TRUE) != JPEG_HEADER_OK)
+    {
+        jpeg_abort_decompress(cinfo);
+        r->decodeErrors++;
+        return false;
+    }
+
+    // OPTIMIZATION: Same trade-offs as the GDI client: speed over smoothness.
+    cinfo->out_color_space = RDC_JPEG_COLOR;
+    cinfo->dct_method = JDCT_IFAST;
+    cinfo->do_fancy_upsampling = FALSE;
+    cinfo->do_block_smoothing = FALSE;
+
+    jpeg_start_decompress(cinfo);
+    int w = cinfo->output_width;
+    int h = cinfo->output_height;
+    if (w <= 0 || h <= 0 || w > MAX_FRAME_DIM || h > MAX_FRAME_DIM)
+    {
+        jpeg_abort_decompress(cinfo);
+        r->decodeErrors++;
+        return false;
+    }
+
+    RgbBuffer &buf = PrepareBack(r, w, h);
+    if ((int)r->rows.size() < h) r->rows.resize(h);
+    for (int y = 0; y < h; y++) r->rows[y] = buf.pixels.data() + (size_t)y * w * RDC_PIXEL_SIZE;
+
+    while (cinfo->output_scanline < cinfo->output_height)
+    {
+        jpeg_read_scanlines(cinfo, r->rows.data() + cinfo->output_scanline, cinfo->output_height - cinfo->output_scanline);
+    }
+    jpeg_finish_decompress(cinfo);
+
+    PublishBack(r);
+    return true;
+}
+
+// Same tearing rules as client_tkinter.py: a new frame id starts a frame and
+// it is only decoded once every byte of it arrived. WireParse() has already
+// bounded every field, so the buffer can be sized from it.
+static void HandleJpegPacket(Receiver *r, const unsigned char *packet, int len)
+{
+    WireFrameChunk chunk;
+    if (!WireParse(packet, len, &chunk) || chunk.Display() != r->display) return;
+    // Up to the last frame completed: a late or repeated chunk
+    if (r->frameDone && (int32_t)(chunk.FrameId() - r->lastFrameId) <= 0) return;
+
+    if (chunk.FrameId() != r->frameId || r->frameTotal == 0)
+    {
+        // Chunks of an older frame arriving late
+        if (r->frameTotal != 0 && (int32_t)(chunk.FrameId() - r->frameId) < 0) return;
+        r->frameId = chunk.FrameId();
+        r->frameTotal = chunk.TotalSize();
+        r->frameReceived = 0;
+        r->frameRanges.Clear();
+        if (r->frameBuffer.size() < r->frameTotal) r->frameBuffer.resize(r->frameTotal);
+        r->frameW = chunk.Width();
+        r->frameH = chunk.Height();
+    }
+
+    if (chunk.TotalSize() != r->frameTotal || !r->frameRanges.Add(chunk.Offset(), chunk.payloadLen)) return;
+
+    memcpy(r->frameBuffer.data() + chunk.Offset(), chunk.Payload(), chunk.payloadLen);
+    r->frameReceived += chunk.payloadLen;
+
+    if (r->frameReceived >= r->frameTotal)
+    {
+        r->framesComplete++;
+        r->lastFrameId = r->frameId;
+        r->frameDone = true;
+        DecodeJpeg(r, r->frameBuffer.data(), r->frameTotal);
+        r->frameTotal = 0;
+        r->frameReceived = 0;
+    }
+}
+
+static void JpegLoop(Receiver *r)
+{
+    std::vector<unsigned char> packet(MAX_PACKET_SIZE);
+    sockaddr_in senderAddr;
+    socklen_t senderSize = sizeof(senderAddr);
+    bool encrypted = !r->deviceKey.empty();
+    auto lastHandshake = std::chrono::steady_clock::now();
+
+    while (r->running)
+    {
+        int len = recvfrom(r->sock, (char *)packet.data(), MAX_PACKET_SIZE, 0, (sockaddr *)&senderAddr, &senderSize);
+        if (len > 0)
+        {
+            r->packets++;
+            r->bytes += len;
+            if (!encrypted)
+            {
+                HandleJpegPacket(r, packet.data(), len);
+            }
+            else if (!r->secure)
+            {
+                if (len == sizeof(HandshakeReply)) HandleReply(r, packet.data(), len);
+            }
+            else
+            {
+                int plainLen = r->channel.Open(packet.data(), len);
+                if (plainLen <= 0) continue;
+                r->confirmed = true;
+                HandleJpegPacket(r, packet.data() + SEAL_SEQ_SIZE, plainLen);
+            }
+            continue;
+        }
+
+        // Timeout: keep re-announcing ourselves until the host answers, and
+        // confirming until it streams.
+        auto now = std::chrono::steady_clock::now();
+        if (!r->secure && now - lastHandshake > std::chrono::seconds(1))
+        {
+            SendHello(r);
+            lastHandshake = now;
+        }
+        else if (r->secure && !r->confirmed && now - lastHandshake > std::chrono::milliseconds(HANDSHAKE_CONFIRM_RESEND_MS))
+        {
+            SendConfirm(r);
+            lastHandshake = now;
+        }
+    }
+}
+
+#ifdef RDC_WITH_AVCODEC
+// libavformat pulls MPEG-TS bytes straight from our socket, so there is no
+// separate UDP reader inside FFmpeg and no BGR->RGB pass like OpenCV does.
+static int ReadSocket(void *opaque, uint8_t *buf, int bufSize)
+{
+    Receiver *r = (Receiver *)opaque;
+    while (r->running)
+    {
+        int len = recv(r->sock, (char *)buf, bufSize, 0);
+        if (len > 0)
+        {
+            r->packets++;
+            r->bytes += len;
+            return len;
+        }
+    }
+    return AVERROR_EOF;
+}
+
+static void MpegTsLoop(Receiver *r)
+{
+    const int ioSize = 1316 * 8;
+    unsigned char *ioBuffer = (unsigned char *)av_malloc(ioSize);
+    AVIOContext *io = avio_alloc_context(ioBuffer, ioSize, 0, r, ReadSocket, NULL, NULL);
+    AVFormatContext *fmt = avformat_alloc_context();
+    fmt->pb = io;
+    fmt->flags |= AVFMT_FLAG_NOBUFFER;
+    fmt->probesize = 32 * 1024;
+    fmt->max_analyze_duration = 0;
+
+    AVCodecContext *ctx = NULL;
+    SwsContext *sws = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int videoIndex = -1;
+
+    const AVInputFormat *ts = av_find_input_format("mpegts");
+    if (avformat_open_input(&fmt, NULL, ts, NULL) < 0) goto done;
+    if (avformat_find_stream_info(fmt, NULL) < 0) goto done;
+
+    videoIndex = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (videoIndex < 0) goto done;
+
+    {
+        const AVCodec *codec = avcodec_find_decoder(fmt->streams[videoIndex]->codecpar->codec_id);
+        ctx = avcodec_alloc_context3(codec);
+        avcodec_parameters_to_context(ctx, fmt->streams[videoIndex]->codecpar);
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        ctx->thread_type = FF_THREAD_SLICE;
+        if (avcodec_open2(ctx, codec, NULL) < 0) goto done;
+    }
+
+    while (r->running && av_read_frame(fmt, pkt) >= 0)
+    {
+        if (pkt->stream_index == videoIndex && avcodec_send_packet(ctx, pkt) >= 0)
+        {
+            while (avcodec_receive_frame(ctx, frame) >= 0)
+            {
+                r->framesComplete++;
+                int w = frame->width, h = frame->height;
+                sws = sws_getCachedContext(sws, w, h, (AVPixelFormat)frame->format, w, h, RDC_AV_FORMAT, SWS_POINT, NULL, NULL, NULL);
+                RgbBuffer &buf = PrepareBack(r, w, h);
+                uint8_t *dst[1] = {buf.pixels.data()};
+                int dstStride[1] = {w * RDC_PIXEL_SIZE};
+                sws_scale(sws, frame->data, frame->linesize, 0, h, dst, dstStride);
+                PublishBack(r);
+            }
+        }
+        av_packet_unref(pkt);
+    }
+
+done:
+    sws_freeContext(sws);
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&ctx);
+    avformat_close_input(&fmt);
+    if (io) av_freep(&io->buffer);
+    avio_context_free(&io);
+}
+#endif
+
+RDC_API void *rdc_open(const char *hostIp, int hostPort, int listenPort, const char *deviceKey, int mode)
+{
+#ifndef RDC_WITH_AVCODEC
+    if (mode == RDC_MODE_MPEGTS) return NULL;
+#endif
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+    Receiver *r = new Receiver();
+    r->mode = mode;
+    r->deviceKey = deviceKey ? deviceKey : "";
+
+    r->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int buffSize = 1024 * 1024 * 32;
+    setsockopt(r->sock, SOL_SOCKET, SO_RCVBUF, (char *)&buffSize, sizeof(buffSize));
+
+    // Short timeout so the thread notices rdc_close() and can resend the key.
+#ifdef _WIN32
+    DWORD timeout = 100;
+#else
+    timeval timeout{0, 100 * 1000};
+#endif
+    setsockopt(r->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+
+    sockaddr_in localAddr{};
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_port = htons(listenPort);
+    localAddr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(r->sock, (sockaddr *)&localAddr, sizeof(localAddr)) != 0)
+    {
+        closesocket(r->sock);
+        delete r;
+        return NULL;
+    }
+
+    if (hostIp && *hostIp)
+    {
+        r->hostAddr.sin_family = AF_INET;
+        r->hostAddr.sin_port = htons(hostPort);
+        r->hostAddr.sin_addr.s_addr = inet_addr(hostIp);
+    }
+
+    r->cinfo.err = jpeg_std_error(&r->jerr.pub);
+    r->jerr.pub.error_exit = JpegErrorExit;
+    r->jerr.pub.output_message = JpegSilent;
+    jpeg_create_decompress(&r->cinfo);
+
+    SendHello(r);
+
+    r->running = true;
+#ifdef RDC_WITH_AVCODEC
+    if (mode == RDC_MODE_MPEGTS) r->netThread = std::thread(MpegTsLoop, r);
+    else
+#endif
+        r->netThread = std::thread(JpegLoop, r);
+    return r;
+}
+
+// Waits up to timeoutMs for a new frame. Returns 1 and fills `out` when one is
+// available; the pixels stay untouched until rdc_release() is called.
+RDC_API int rdc_acquire(void *handle, int timeoutMs, RdcFrame *out)
+{
+    Receiver *r = (Receiver *)handle;
+    std::unique_lock<std::mutex> guard(r->lock);
+    if (r->ready < 0 && timeoutMs > 0)
+    {
+        r->frameReady.wait_for(guard, std::chrono::milliseconds(timeoutMs), [r] { return r->ready >= 0; });
+    }
+    if (r->ready < 0) return 0;
+
+    // Give back whatever Python was still holding, then take the newest frame.
+    r->front = r->ready;
+    r->ready = -1;
+
+    RgbBuffer &buf = r->buffers[r->front];
+    out->data = buf.pixels.data();
+    out->width = buf.width;
+    out->height = buf.height;
+    out->stride = buf.width * RDC_PIXEL_SIZE;
+    out->frameId = buf.frameId;
+    out->pixelSize = RDC_PIXEL_SIZE;
+    return 1;
+}
+
+RDC_API void rdc_release(void *handle)
+{
+    Receiver *r = (Receiver *)handle;
+    std::lock_guard<std::mutex> guard(r->lock);
+    r->front = -1;
+}
+
+RDC_API void rdc_send_input(void *handle, int type, int x, int y, int key)
+{
+    Receiver *r = (Receiver *)handle;
+    if (r->hostAddr.sin_addr.s_addr == 0) return;
+    unsigned char sealed[SEAL_OVERHEAD + WIRE_HEADER_SIZE + WIRE_INPUT_BODY];
+    unsigned char *plain = sealed + SEAL_SEQ_SIZE;
+    int plainLen = WireWriteInput(plain, type, r->display, std::max(0, x), std::max(0, y), key);
+    if (r->deviceKey.empty())
+    {
+        sendto(r->sock, (char *)plain, plainLen, 0, (sockaddr *)&r->hostAddr, sizeof(r->hostAddr));
+        return;
+    }
+
+    // Only the Python UI thread seals, so this does not race the network thread.
+    if (!r->secure) return;
+    int sealedLen = r->channel.Seal(sealed, plainLen);
+    sendto(r->sock, (char *)sealed, sealedLen, 0, (sockaddr *)&r->hostAddr, sizeof(r->hostAddr));
+}
+
+RDC_API void rdc_get_stats(void *handle, RdcStats *out)
+{
+    Receiver *r = (Receiver *)handle;
+    out->packets = r->packets;
+    out->bytes = r->bytes;
+    out->framesComplete = r->framesComplete;
+    out->framesDecoded = r->framesDecoded;
+    out->framesDropped = r->framesDropped;
+    out->decodeErrors = r->decodeErrors;
+}
+
+RDC_API void rdc_close(void *handle)
+{
+    Receiver *r = (Receiver *)handle;
+    if (!r) return;
+    r->running = false;
+    if (r->netThread.joinable()) r->netThread.join();
+    closesocket(r->sock);
+    jpeg_destroy_decompress(&r->cinfo);
+    delete r;
+}
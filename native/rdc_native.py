@@ -0,0 +1,88 @@
+import ctypes
+import os
+import sys
+
+# Must match rdc_native.cpp
+MODE_JPEG = 0
+MODE_MPEGTS = 1
+
+
+class RdcFrame(ctypes.Structure):
+    _fields_ = [("data", ctypes.POINTER(ctypes.c_ubyte)),
+                ("width", ctypes.c_int),
+                ("height", ctypes.c_int),
+                ("stride", ctypes.c_int),
+                ("frame_id", ctypes.c_longlong),
+                ("pixel_size", ctypes.c_int)]
+
+
+class RdcStats(ctypes.Structure):
+    _fields_ = [("packets", ctypes.c_longlong),
+                ("bytes", ctypes.c_longlong),
+                ("frames_complete", ctypes.c_longlong),
+                ("frames_decoded", ctypes.c_longlong),
+                ("frames_dropped", ctypes.c_longlong),
+                ("decode_errors", ctypes.c_longlong)]
+
+
+def _load():
+    here = os.path.dirname(os.path.abspath(__file__))
+    name = "rdc_native.dll" if sys.platform == "win32" else "librdc_native.so"
+    lib = ctypes.CDLL(os.path.join(here, name))
+    lib.rdc_open.restype = ctypes.c_void_p
+    lib.rdc_open.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_int, ctypes.c_char_p, ctypes.c_int]
+    lib.rdc_acquire.restype = ctypes.c_int
+    lib.rdc_acquire.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(RdcFrame)]
+    lib.rdc_release.argtypes = [ctypes.c_void_p]
+    lib.rdc_send_input.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.rdc_get_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(RdcStats)]
+    lib.rdc_close.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+# Raises OSError on import when the library has not been built, so callers can
+# fall back to the pure-Python loop.
+_lib = _load()
+
+
+class NativeReceiver:
+    """Owns the UDP socket and a background decode thread inside the library.
+
+    acquire() returns a memoryview over the library's pixel buffer (no copy).
+    It stays valid until release() or the next acquire().
+    """
+
+    def __init__(self, host_ip, host_port, listen_port, device_key, mode=MODE_JPEG):
+        key = device_key.encode() if device_key else None
+        ip = host_ip.encode() if host_ip else None
+        self._handle = _lib.rdc_open(ip, host_port, listen_port, key, mode)
+        if not self._handle:
+            raise OSError(f"rdc_open failed (port {listen_port} busy or mode {mode} not built in)")
+        self._frame = RdcFrame()
+
+    def acquire(self, timeout_ms=0):
+        """Returns (memoryview, width, height, mode) or None when no new frame
+        arrived. mode is the PIL mode of the buffer: "RGBA" (PIL maps it in
+        place) or "RGB" with a library built against plain libjpeg."""
+        if not _lib.rdc_acquire(self._handle, timeout_ms, ctypes.byref(self._frame)):
+            return None
+        f = self._frame
+        size = f.stride * f.height
+        buf = (ctypes.c_ubyte * size).from_address(ctypes.addressof(f.data.contents))
+        return memoryview(buf), f.width, f.height, "RGBA" if f.pixel_size == 4 else "RGB"
+
+    def release(self):
+        _lib.rdc_release(self._handle)
+
+    def send_input(self, type_id, x, y, key):
+        _lib.rdc_send_input(self._handle, type_id, x, y, key)
+
+    def stats(self):
+        s = RdcStats()
+        _lib.rdc_get_stats(self._handle, ctypes.byref(s))
+        return s
+
+    def close(self):
+        if self._handle:
+            _lib.rdc_close(self._handle)
+            self._handle = None
@@ -0,0 +1,83 @@
+// Relay daemon for hosts behind NAT (common/relay_protocol.h). Linux.
+//
+//   ./relay [--port 50007] [--workers N] [--senders N] [--queue-kb 1024] [--no-cache]
+//
+// Hosts: host.exe --relay <relay ip[:port]> --stream <name>
+// Viewers: client.exe, host address "<relay ip[:port]>/<name>"
+//
+// Forwards sealed datagrams without unsealing them, keeps each stream's
+// latest keyframes for viewers that join mid-stream, and bounds every
+// viewer's queue (--queue-kb) so a slow viewer never holds up the host or
+// the other viewers. Build: bench/build.sh.
+
+#include "../common/relay_server.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define RELAY_STATS_SECONDS 10
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void OnSignal(int)
+{
+    g_stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    RelayConfig config;
+    config.workers = (int)std::min(4u, cores);
+    config.senders = (int)std::min(4u, cores);
+    config.log = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--no-cache") config.cache = false;
+        else if (i + 1 < argc && arg == "--port") config.port = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--workers") config.workers = std::max(1, atoi(argv[++i]));
+        else if (i + 1 < argc && arg == "--senders") config.senders = std::max(1, atoi(argv[++i]));
+        else if (i + 1 < argc && arg == "--queue-kb") config.queueBytes = (size_t)std::max(64, atoi(argv[++i])) * 1024;
+        else
+        {
+            fprintf(stderr, "usage: %s [--port N] [--workers N] [--senders N] [--queue-kb N] [--no-cache]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    RelayServer relay;
+    if (!relay.Start(config))
+    {
+        std::cout << "[ERROR] Relay bind failed on port " << config.port << ".\n";
+        return 1;
+    }
+    std::cout << "[INFO] Relay on port " << relay.Port() << ": " << config.workers << " receive worker(s), " << config.senders
+              << " sender(s), " << config.queueBytes / 1024 << " KB per viewer, keyframe cache "
+              << (config.cache ? "on" : "off") << ".\n";
+
+    RelayCounters last;
+    for (int tick = 1; !g_stop; tick++)
+    {
+        sleep(1);
+        relay.Sweep();
+        if (tick % RELAY_STATS_SECONDS) continue;
+
+        RelayCounters c = relay.Counters();
+        double in = (c.bytesIn - last.bytesIn) * 8.0 / 1e6 / RELAY_STATS_SECONDS;
+        double out = (c.bytesOut - last.bytesOut) * 8.0 / 1e6 / RELAY_STATS_SECONDS;
+        std::cout << "[INFO] " << c.streams << " stream(s), " << c.viewers << " viewer(s): in " << in << " Mbit/s, out " << out
+                  << " Mbit/s, " << (c.dropped - last.dropped) << " dropped for slow viewers, " << (c.rejected - last.rejected)
+                  << " rejected, " << (c.cookies - last.cookies) << " cookie(s) sent.\n";
+        last = c;
+    }
+    relay.Stop();
+    std::cout << "[INFO] Relay stopped.\n";
+    return 0;
+}
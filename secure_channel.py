@@ -0,0 +1,88 @@
+"""Python side of common/secure_channel.h (requires: pip install cryptography).
+
+Only the client half is implemented: client_tkinter.py's pure-Python loop uses
+it when the native library is not built.
+"""
+import hmac
+import hashlib
+import os
+import struct
+
+from cryptography.hazmat.primitives import hashes, serialization
+from cryptography.hazmat.primitives.asymmetric.x25519 import X25519PrivateKey, X25519PublicKey
+from cryptography.hazmat.primitives.ciphers.aead import AESGCM, ChaCha20Poly1305
+from cryptography.hazmat.primitives.kdf.hkdf import HKDF
+
+# Must match common/secure_channel.h
+HANDSHAKE_MAGIC = 0x31434452
+HS_HELLO, HS_REPLY, HS_CONFIRM = 1, 2, 3
+CIPHER_AES_GCM, CIPHER_CHACHA20_POLY1305 = 1, 2
+SEAL_SEQ_SIZE = 8
+SEAL_TAG_SIZE = 16
+SEAL_OVERHEAD = SEAL_SEQ_SIZE + SEAL_TAG_SIZE
+
+HELLO = struct.Struct('<IBB32s16s')
+REPLY = struct.Struct('<IBB32s16s32s')
+REPLY_SIGNED = struct.Struct('<IBB32s16s')  # reply without its mac
+CONFIRM = struct.Struct('<IB32s')
+
+
+class SecureChannel:
+    def __init__(self, device_key):
+        self.psk = device_key.encode()
+        self.ready = False
+        self._private = X25519PrivateKey.generate()
+        pub = self._private.public_key().public_bytes(serialization.Encoding.Raw, serialization.PublicFormat.Raw)
+        self.hello = HELLO.pack(HANDSHAKE_MAGIC, HS_HELLO, CIPHER_AES_GCM, pub, os.urandom(16))
+        self._send_seq = 0
+        self._recv_highest = 0
+        self._recv_window = 0
+
+    def _mac(self, label, reply_signed):
+        return hmac.new(self.psk, label + self.hello + reply_signed, hashlib.sha256).digest()
+
+    def finish(self, data):
+        """Handles the host's REPLY. Returns the CONFIRM datagram or None."""
+        if len(data) != REPLY.size: return None
+        magic, kind, cipher, host_pub, nonce, mac = REPLY.unpack(data)
+        if magic != HANDSHAKE_MAGIC or kind != HS_REPLY: return None
+        if cipher not in (CIPHER_AES_GCM, CIPHER_CHACHA20_POLY1305): return None
+
+        signed = data[:REPLY_SIGNED.size]
+        if not hmac.compare_digest(self._mac(b"host", signed), mac): return None
+
+        shared = self._private.exchange(X25519PublicKey.from_public_bytes(host_pub))
+        okm = HKDF(algorithm=hashes.SHA256(), length=72, salt=self.psk, info=self.hello + signed).derive(shared)
+        aead = AESGCM if cipher == CIPHER_AES_GCM else ChaCha20Poly1305
+        # okm = host->client key | client->host key | host salt | client salt
+        self._recv = aead(okm[0:32])
+        self._send = aead(okm[32:64])
+        self._recv_salt = okm[64:68]
+        self._send_salt = okm[68:72]
+        self.ready = True
+        return CONFIRM.pack(HANDSHAKE_MAGIC, HS_CONFIRM, self._mac(b"client", signed))
+
+    def seal(self, plaintext):
+        seq = struct.pack('<Q', self._send_seq)
+        self._send_seq += 1
+        return seq + self._send.encrypt(self._send_salt + seq, plaintext, seq)
+
+    def open(self, datagram):
+        """Returns the plaintext, or None for forged/replayed/stray datagrams."""
+        if not self.ready or len(datagram) < SEAL_OVERHEAD: return None
+        seq_bytes = datagram[:SEAL_SEQ_SIZE]
+        seq = struct.unpack('<Q', seq_bytes)[0]
+        if self._recv_window and seq <= self._recv_highest:
+            age = self._recv_highest - seq
+            if age >= 64 or self._recv_window & (1 << age): return None
+        try:
+            plain = self._recv.decrypt(self._recv_salt + seq_bytes, datagram[SEAL_SEQ_SIZE:], seq_bytes)
+        except Exception:
+            return None
+        if self._recv_window and seq <= self._recv_highest:
+            self._recv_window |= 1 << (self._recv_highest - seq)
+        else:
+            shift = 64 if not self._recv_window else seq - self._recv_highest
+            self._recv_window = 1 if shift >= 64 else ((self._recv_window << shift) | 1) & ((1 << 64) - 1)
+            self._recv_highest = seq
+        return plain
@@ -0,0 +1 @@
+g++ -O2 -std=c++17 rdc_player.cpp -o rdc_player.exe -lws2_32
\ No newline at end of file
@@ -0,0 +1,172 @@
+// Player for host recordings (host.exe --record <file>).
+//
+//   rdc_player info   <file>                       summary + index stats
+//   rdc_player seek   <file> <seconds> [out.jpg]   jump to a time, dump that frame
+//   rdc_player replay <file> <ip> [port] [speed] [start seconds]
+//
+// replay re-sends the recorded frames as plaintext wire-format frame chunks,
+// with the recorded timing, so a recording can drive native/bench_recv.py
+// style receivers or a client built for benchmarking.
+//
+// Build (Linux):   g++ -O2 -std=c++17 rdc_player.cpp -o rdc_player -lpthread
+// Build (Windows): g++ -O2 -std=c++17 rdc_player.cpp -o rdc_player.exe -lws2_32
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+typedef int SOCKET;
+#endif
+
+#include "../common/session_recorder.h"
+#include "../common/wire_format.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#define STREAM_PORT 50006
+#define MAX_PACKET_SIZE 60000
+
+typedef std::chrono::steady_clock Clock;
+
+static int Info(SessionReader &reader)
+{
+    uint64_t frames = 0, inputs = 0, bytes = 0, lastUs = 0;
+    RecordView rec;
+    for (uint64_t off = reader.First(); reader.At(off, &rec); off = reader.Next(rec))
+    {
+        if (rec.type == REC_FRAME) { frames++; bytes += rec.size; }
+        else if (rec.type == REC_INPUT) inputs++;
+        lastUs = std::max(lastUs, rec.timestampUs);
+    }
+    double seconds = lastUs / 1e6;
+    std::cout << "[INFO] Duration: " << seconds << " s\n";
+    std::cout << "[INFO] Frames: " << frames << " (" << (seconds > 0 ? frames / seconds : 0) << " fps avg, "
+              << (frames ? bytes / frames / 1024 : 0) << " KB avg)\n";
+    std::cout << "[INFO] Input events: " << inputs << "\n";
+    std::cout << "[INFO] Index entries: " << reader.IndexEntries() << "\n";
+    return 0;
+}
+
+static int Seek(SessionReader &reader, double seconds, const char *outPath)
+{
+    uint64_t target = (uint64_t)(seconds * 1e6);
+    auto start = Clock::now();
+    uint64_t offset = reader.Seek(target);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    RecordView rec;
+    if (!reader.At(offset, &rec) || rec.type != REC_FRAME)
+    {
+        std::cout << "[ERROR] No frame at or before " << seconds << " s.\n";
+        return 1;
+    }
+    FrameInfo info;
+    memcpy(&info, rec.payload, sizeof(info));
+    std::cout << "[SEEK] " << seconds << " s -> frame at " << rec.timestampUs / 1e6 << " s ("
+              << info.width << "x" << info.height << ", " << rec.size - sizeof(info) << " bytes) in " << us << " us\n";
+
+    if (outPath)
+    {
+        FILE *out = fopen(outPath, "wb");
+        if (!out) return 1;
+        fwrite(rec.payload + sizeof(info), 1, rec.size - sizeof(info), out);
+        fclose(out);
+        std::cout << "[SEEK] Wrote " << outPath << "\n";
+    }
+    return 0;
+}
+
+static int Replay(SessionReader &reader, const char *ip, int port, double speed, double startSeconds)
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int buffSize = 1024 * 1024 * 10;
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char *)&buffSize, sizeof(buffSize));
+
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(port);
+    dest.sin_addr.s_addr = inet_addr(ip);
+
+    std::vector<uint8_t> sendBuffer(WIRE_FRAME_OVERHEAD + MAX_PACKET_SIZE);
+    uint64_t firstOffset = reader.Seek((uint64_t)(startSeconds * 1e6));
+    RecordView rec;
+    if (!reader.At(firstOffset, &rec)) return 1;
+
+    uint64_t baseUs = rec.timestampUs;
+    auto wallStart = Clock::now();
+    uint64_t frames = 0;
+
+    for (uint64_t off = firstOffset; reader.At(off, &rec); off = reader.Next(rec))
+    {
+        if (rec.type != REC_FRAME || rec.size < sizeof(FrameInfo)) continue;
+
+        // Keep the recorded pacing (scaled by speed; 0 = as fast as possible).
+        if (speed > 0 && rec.timestampUs > baseUs)
+        {
+            auto due = wallStart + std::chrono::microseconds((uint64_t)((rec.timestampUs - baseUs) / speed));
+            std::this_thread::sleep_until(due);
+        }
+
+        FrameInfo info;
+        memcpy(&info, rec.payload, sizeof(info));
+        const char *bytes = (const char *)rec.payload + sizeof(info);
+        int total = (int)(rec.size - sizeof(info));
+
+        for (int offset = 0; offset < total; offset += MAX_PACKET_SIZE)
+        {
+            int chunkLen = std::min(MAX_PACKET_SIZE, total - offset);
+            int headerLen = WireWriteFrameChunk(sendBuffer.data(), (uint32_t)frames, rec.timestampUs - baseUs, offset, total, info.width, info.height,
+                                                info.display, info.keyframe ? WIRE_FLAG_KEYFRAME : 0, chunkLen);
+            memcpy(sendBuffer.data() + headerLen, bytes + offset, chunkLen);
+            sendto(sock, (char *)sendBuffer.data(), headerLen + chunkLen, 0, (sockaddr *)&dest, sizeof(dest));
+        }
+        frames++;
+    }
+
+    double wall = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    std::cout << "[REPLAY] Sent " << frames << " frames in " << wall << " s (" << (wall > 0 ? frames / wall : 0) << " fps)\n";
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: rdc_player info|seek|replay <file> ...\n";
+        return 1;
+    }
+
+    std::string cmd = argv[1];
+    SessionReader reader;
+    if (!reader.Open(argv[2]))
+    {
+        std::cout << "[ERROR] Not a recording: " << argv[2] << "\n";
+        return 1;
+    }
+
+    if (cmd == "info") return Info(reader);
+    if (cmd == "seek" && argc >= 4) return Seek(reader, atof(argv[3]), argc >= 5 ? argv[4] : NULL);
+    if (cmd == "replay" && argc >= 4)
+    {
+        int port = argc >= 5 ? atoi(argv[4]) : STREAM_PORT;
+        double speed = argc >= 6 ? atof(argv[5]) : 1.0;
+        double start = argc >= 7 ? atof(argv[6]) : 0.0;
+        return Replay(reader, argv[3], port, speed, start);
+    }
+
+    std::cout << "[ERROR] Unknown command.\n";
+    return 1;
+}
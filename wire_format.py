@@ -0,0 +1,67 @@
+"""Python side of common/wire_format.h.
+
+Used by client_tkinter.py, ffmpeg/mobile.py and native/bench_recv.py. Parsers
+return None for anything malformed, before any buffer is sized from it;
+payloads come back as memoryview slices of the datagram (no copy).
+"""
+import struct
+
+# Must match common/wire_format.h
+WIRE_MAGIC = 0x4452
+WIRE_VERSION = 2
+WIRE_FRAME, WIRE_INPUT, WIRE_SUBSCRIBE, WIRE_AUDIO = 1, 2, 3, 4
+WIRE_MAX_FRAME_BYTES = 32 * 1024 * 1024
+WIRE_MAX_DIM = 8192
+WIRE_MAX_DISPLAYS = 8
+WIRE_ALL_DISPLAYS = 0xFF
+WIRE_FLAG_KEYFRAME = 1
+
+HEADER = struct.Struct('<HBBHH')
+FRAME = struct.Struct('<HBBHHIIIHHBBHQ')     # header + fixed frame body
+INPUT = struct.Struct('<HBBHHBBHiii')
+SUBSCRIBE = struct.Struct('<HBBHHBBHHHHH')
+FRAME_OVERHEAD = FRAME.size
+
+_FRAME_BODY = FRAME.size - HEADER.size
+_INPUT_BODY = INPUT.size - HEADER.size
+_SUBSCRIBE_BODY = SUBSCRIBE.size - HEADER.size
+
+
+def parse_frame_chunk(data):
+    """(frame_id, offset, total_size, width, height, display, flags, payload) or None.
+
+    WIRE_AUDIO messages come back as None too: the Python clients have no
+    audio output, and they draw frames as they arrive, so the capture
+    timestamp is not needed either.
+    """
+    n = len(data)
+    if n <= FRAME_OVERHEAD or n > HEADER.size + 65535: return None
+    (magic, version, kind, body_len, _, frame_id, offset, total, width, height,
+     display, flags, _, _) = FRAME.unpack_from(data)
+    payload_len = n - FRAME_OVERHEAD
+    if magic != WIRE_MAGIC or version != WIRE_VERSION or kind != WIRE_FRAME or body_len != n - HEADER.size:
+        return None
+    if not (0 < total <= WIRE_MAX_FRAME_BYTES and offset < total and payload_len <= total - offset
+            and 0 < width <= WIRE_MAX_DIM and 0 < height <= WIRE_MAX_DIM and display < WIRE_MAX_DISPLAYS):
+        return None
+    return frame_id, offset, total, width, height, display, flags, memoryview(data)[FRAME_OVERHEAD:]
+
+
+def pack_frame_chunk(frame_id, offset, total_size, width, height, payload, display=0, flags=WIRE_FLAG_KEYFRAME,
+                     timestamp_us=0):
+    return FRAME.pack(WIRE_MAGIC, WIRE_VERSION, WIRE_FRAME, _FRAME_BODY + len(payload), 0,
+                      frame_id, offset, total_size, width, height, display, flags, 0, timestamp_us) + payload
+
+
+def pack_input(kind, x, y, key, display=0):
+    # The host rejects coordinates outside the stream, so clamp here.
+    x = min(max(int(x), 0), WIRE_MAX_DIM - 1)
+    y = min(max(int(y), 0), WIRE_MAX_DIM - 1)
+    return INPUT.pack(WIRE_MAGIC, WIRE_VERSION, WIRE_INPUT, _INPUT_BODY, 0, kind, display, 0, x, y, key)
+
+
+def pack_subscribe(display=0, region=None):
+    """display=None subscribes to every display; region=(x, y, w, h) crops one."""
+    x, y, w, h = region or (0, 0, 0, 0)
+    return SUBSCRIBE.pack(WIRE_MAGIC, WIRE_VERSION, WIRE_SUBSCRIBE, _SUBSCRIBE_BODY, 0,
+                          WIRE_ALL_DISPLAYS if display is None else display, 0, x, y, w, h, 0)